@@ -0,0 +1,69 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// this lives in its own translation unit so nothing gets to inline the replacements below and see malloc paired with
+// operator delete (or new with free)
+
+static std::atomic<uint64_t> allocations{0};
+static thread_local uint64_t threadAllocations = 0;
+
+uint64_t heapAllocationCount() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t threadHeapAllocationCount() {
+    return threadAllocations;
+}
+
+static void countAllocation() {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    threadAllocations++;
+}
+
+// the array and nothrow forms all end up in this one
+void* operator new(std::size_t size) {
+    countAllocation();
+    if (void* memory = std::malloc(size != 0 ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+// and the over-aligned ones (alignas bigger than malloc guarantees) in this one
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    countAllocation();
+    size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+    void* memory = _aligned_malloc(size != 0 ? size : 1, align);
+#else
+    // aligned_alloc wants the size to be a multiple of the alignment
+    void* memory = std::aligned_alloc(align, (size + align - 1) / align * align + (size == 0 ? align : 0));
+#endif
+    if (memory != nullptr) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept {
+    operator delete(memory, alignment);
+}
@@ -0,0 +1,17 @@
+#ifndef VULKAN_TUTORIAL_ALLOCATION_COUNTER_H
+#define VULKAN_TUTORIAL_ALLOCATION_COUNTER_H
+
+#include <cstdint>
+
+// allocation_counter.cpp replaces the global operator new (plain and aligned, and so every form built on them) so
+// every C++ new the process makes gets counted. malloc and friends aren't: code of our own that calls them directly
+// isn't counted, and neither is what the loader, GLFW or the driver allocate. the render loop reads these to check that
+// a warmed up frame doesn't allocate
+
+// every thread's allocations since startup
+uint64_t heapAllocationCount();
+
+// just the calling thread's
+uint64_t threadHeapAllocationCount();
+
+#endif //VULKAN_TUTORIAL_ALLOCATION_COUNTER_H
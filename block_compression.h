@@ -0,0 +1,557 @@
+#ifndef VULKAN_TUTORIAL_BLOCK_COMPRESSION_H
+#define VULKAN_TUTORIAL_BLOCK_COMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#include "simd.h"
+#include "texture_streaming.h"
+#include "thread_pool.h"
+
+// a CPU encoder for the two block compressed formats worth having: BC1 (8 bytes per 4x4 block, color only) and BC7
+// (16 bytes per block, color and alpha at close to RGBA8 quality). BC7 only uses mode 6, a single pair of RGBA
+// endpoints with 16 shades between them. that's the one mode that can do any block, the other seven trade endpoint
+// precision for partitions and only win on blocks with more than one distinct color ramp in them. every block is
+// encoded on its own, so whole levels spread over a thread pool without any coordination
+
+enum class BcQuality {
+    // one endpoint fit straight off the principal axis
+    Fast,
+    // plus a couple of least squares refinements of the endpoints
+    Normal,
+    // plus more refinements, BC1's 3 color mode and trying every BC7 p-bit combination
+    High,
+};
+
+// one block of pixels, a channel per array so the distance math can run simd::WIDTH pixels at a time
+struct BcBlock {
+    alignas(32) float channels[4][16];
+};
+
+// pulls a 4x4 block out of an RGBA8 image. blocks hanging off the edge repeat the last row/column
+inline void loadBcBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, BcBlock& block) {
+    for (uint32_t y = 0; y < 4; y++) {
+        uint32_t sy = std::min(blockY * 4 + y, height - 1);
+        for (uint32_t x = 0; x < 4; x++) {
+            uint32_t sx = std::min(blockX * 4 + x, width - 1);
+            const uint8_t* pixel = rgba + (size_t(sy) * width + sx) * 4;
+            for (int c = 0; c < 4; c++) {
+                block.channels[c][y * 4 + x] = pixel[c];
+            }
+        }
+    }
+}
+
+// squared distance from every pixel of the block to one color, over the first channelCount channels
+inline void bcDistances(const BcBlock& block, const float color[4], int channelCount, float out[16]) {
+    for (int i = 0; i < 16; i += simd::WIDTH) {
+        simd::Float sum = simd::splat(0.0f);
+        for (int c = 0; c < channelCount; c++) {
+            simd::Float d = simd::load(&block.channels[c][i]) - simd::splat(color[c]);
+            sum = simd::mulAdd(d, d, sum);
+        }
+        simd::store(&out[i], sum);
+    }
+}
+
+// picks the closest palette entry for every pixel and returns the total squared error
+inline float bcChooseIndices(const BcBlock& block, const float (*palette)[4], int paletteSize, int channelCount, uint8_t indices[16]) {
+    float best[16];
+    bcDistances(block, palette[0], channelCount, best);
+    std::fill(indices, indices + 16, 0);
+    for (int entry = 1; entry < paletteSize; entry++) {
+        float distances[16];
+        bcDistances(block, palette[entry], channelCount, distances);
+        for (int i = 0; i < 16; i++) {
+            if (distances[i] < best[i]) {
+                best[i] = distances[i];
+                indices[i] = static_cast<uint8_t>(entry);
+            }
+        }
+    }
+    float error = 0.0f;
+    for (float distance : best) {
+        error += distance;
+    }
+    return error;
+}
+
+// the line through the block's colors that loses the least when every pixel is moved onto it, as the two points
+// where the pixels' projections end up furthest apart
+inline void bcFitLine(const BcBlock& block, int channelCount, float endpoint0[4], float endpoint1[4]) {
+    float mean[4] = {};
+    for (int c = 0; c < channelCount; c++) {
+        for (int i = 0; i < 16; i++) {
+            mean[c] += block.channels[c][i];
+        }
+        mean[c] /= 16.0f;
+    }
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; i++) {
+        for (int a = 0; a < channelCount; a++) {
+            for (int b = a; b < channelCount; b++) {
+                covariance[a][b] += (block.channels[a][i] - mean[a]) * (block.channels[b][i] - mean[b]);
+            }
+        }
+    }
+    for (int a = 0; a < channelCount; a++) {
+        for (int b = 0; b < a; b++) {
+            covariance[a][b] = covariance[b][a];
+        }
+    }
+
+    // power iteration, starting from the channel with the most variance
+    float axis[4] = {};
+    int start = 0;
+    for (int c = 1; c < channelCount; c++) {
+        if (covariance[c][c] > covariance[start][start]) {
+            start = c;
+        }
+    }
+    axis[start] = 1.0f;
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {};
+        float length = 0.0f;
+        for (int a = 0; a < channelCount; a++) {
+            for (int b = 0; b < channelCount; b++) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+        // a flat block, any axis will do
+        if (length < 1e-12f) {
+            break;
+        }
+        length = 1.0f / std::sqrt(length);
+        for (int c = 0; c < channelCount; c++) {
+            axis[c] = next[c] * length;
+        }
+    }
+
+    float minT = 0.0f, maxT = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for (int c = 0; c < channelCount; c++) {
+            t += (block.channels[c][i] - mean[c]) * axis[c];
+        }
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    for (int c = 0; c < channelCount; c++) {
+        endpoint0[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+        endpoint1[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+    }
+}
+
+// the endpoints that best reproduce the block for fixed indices, where pixel i is
+// endpoint0 * (1 - weights[indices[i]]) + endpoint1 * weights[indices[i]]. pixels whose index has a negative weight
+// aren't on the line and get left out. false if the indices don't pin the endpoints down
+inline bool bcLeastSquares(const BcBlock& block, int channelCount, const uint8_t indices[16], const float* weights,
+                           float endpoint0[4], float endpoint1[4]) {
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for (int i = 0; i < 16; i++) {
+        float b = weights[indices[i]];
+        if (b < 0.0f) {
+            continue;
+        }
+        float a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < channelCount; c++) {
+            ax[c] += a * block.channels[c][i];
+            bx[c] += b * block.channels[c][i];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f) {
+        return false;
+    }
+    float inverse = 1.0f / determinant;
+    for (int c = 0; c < channelCount; c++) {
+        endpoint0[c] = std::clamp((ax[c] * bb - bx[c] * ab) * inverse, 0.0f, 255.0f);
+        endpoint1[c] = std::clamp((bx[c] * aa - ax[c] * ab) * inverse, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+inline int bcRefinements(BcQuality quality) {
+    switch (quality) {
+        case BcQuality::Fast:
+            return 0;
+        case BcQuality::Normal:
+            return 2;
+        case BcQuality::High:
+            return 6;
+    }
+    return 0;
+}
+
+// ---- BC1 ----
+
+inline uint16_t packRgb565(const float color[3]) {
+    auto quantize = [](float value, int maximum) {
+        return static_cast<uint16_t>(std::clamp(static_cast<int>(value * maximum / 255.0f + 0.5f), 0, maximum));
+    };
+    return static_cast<uint16_t>(quantize(color[0], 31) << 11 | quantize(color[1], 63) << 5 | quantize(color[2], 31));
+}
+
+inline void unpackRgb565(uint16_t packed, float color[4]) {
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = float(r << 3 | r >> 2);
+    color[1] = float(g << 2 | g >> 4);
+    color[2] = float(b << 3 | b >> 2);
+    color[3] = 255.0f;
+}
+
+// the colors a BC1 block can pick from. with color0 > color1 there are two shades in between, otherwise one and black
+inline void bc1Palette(uint16_t color0, uint16_t color1, float palette[4][4]) {
+    unpackRgb565(color0, palette[0]);
+    unpackRgb565(color1, palette[1]);
+    if (color0 > color1) {
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = std::floor((2.0f * palette[0][c] + palette[1][c]) / 3.0f);
+            palette[3][c] = std::floor((palette[0][c] + 2.0f * palette[1][c]) / 3.0f);
+        }
+        palette[2][3] = palette[3][3] = 255.0f;
+        return;
+    }
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = std::floor((palette[0][c] + palette[1][c]) / 2.0f);
+        palette[3][c] = 0.0f;
+    }
+    palette[2][3] = palette[3][3] = 255.0f;
+}
+
+struct Bc1Candidate {
+    uint16_t color0, color1;
+    uint8_t indices[16];
+    float error;
+};
+
+// quantizes a pair of endpoints into the requested mode (4 colors or 3 plus black) and picks indices for it
+inline Bc1Candidate bc1Evaluate(const BcBlock& block, const float endpoint0[4], const float endpoint1[4], bool threeColor) {
+    Bc1Candidate candidate{};
+    candidate.color0 = packRgb565(endpoint0);
+    candidate.color1 = packRgb565(endpoint1);
+    // the order of the two colors is what selects the mode
+    if ((candidate.color0 < candidate.color1) != threeColor && candidate.color0 != candidate.color1) {
+        std::swap(candidate.color0, candidate.color1);
+    }
+    float palette[4][4];
+    bc1Palette(candidate.color0, candidate.color1, palette);
+    candidate.error = bcChooseIndices(block, palette, 4, 3, candidate.indices);
+    return candidate;
+}
+
+inline void encodeBc1Block(const BcBlock& block, BcQuality quality, uint8_t out[8]) {
+    // how far along from endpoint 0 to endpoint 1 each index is, in either mode. index 3 of the 3 color mode is
+    // black, which isn't on the line at all
+    static const float FOUR_COLOR_WEIGHTS[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+    static const float THREE_COLOR_WEIGHTS[4] = {0.0f, 1.0f, 0.5f, -1.0f};
+
+    float endpoint0[4], endpoint1[4];
+    bcFitLine(block, 3, endpoint0, endpoint1);
+    if (quality == BcQuality::Fast) {
+        // pull the ends in a little, the extremes are usually outliers and the shades in between matter more
+        for (int c = 0; c < 3; c++) {
+            float inset = (endpoint0[c] - endpoint1[c]) / 16.0f;
+            endpoint0[c] -= inset;
+            endpoint1[c] += inset;
+        }
+    }
+
+    Bc1Candidate best = bc1Evaluate(block, endpoint0, endpoint1, false);
+    int modes = quality == BcQuality::High ? 2 : 1;
+    for (int mode = 0; mode < modes; mode++) {
+        bool threeColor = mode == 1;
+        const float* weights = threeColor ? THREE_COLOR_WEIGHTS : FOUR_COLOR_WEIGHTS;
+        Bc1Candidate current = threeColor ? bc1Evaluate(block, endpoint0, endpoint1, true) : best;
+        for (int iteration = 0; iteration < bcRefinements(quality); iteration++) {
+            // the fit follows the stored order of the endpoints, which bc1Evaluate() may have swapped
+            float refined0[4], refined1[4];
+            if (!bcLeastSquares(block, 3, current.indices, weights, refined0, refined1)) {
+                break;
+            }
+            Bc1Candidate next = bc1Evaluate(block, refined0, refined1, threeColor);
+            if (next.error >= current.error) {
+                break;
+            }
+            current = next;
+        }
+        if (current.error < best.error) {
+            best = current;
+        }
+    }
+
+    uint32_t indexBits = 0;
+    for (int i = 0; i < 16; i++) {
+        indexBits |= uint32_t(best.indices[i]) << (i * 2);
+    }
+    out[0] = uint8_t(best.color0);
+    out[1] = uint8_t(best.color0 >> 8);
+    out[2] = uint8_t(best.color1);
+    out[3] = uint8_t(best.color1 >> 8);
+    memcpy(out + 4, &indexBits, 4);
+}
+
+inline void decodeBc1Block(const uint8_t in[8], uint8_t pixels[16][4]) {
+    uint16_t color0 = uint16_t(in[0] | in[1] << 8);
+    uint16_t color1 = uint16_t(in[2] | in[3] << 8);
+    float palette[4][4];
+    bc1Palette(color0, color1, palette);
+    uint32_t indexBits;
+    memcpy(&indexBits, in + 4, 4);
+    for (int i = 0; i < 16; i++) {
+        const float* color = palette[(indexBits >> (i * 2)) & 3];
+        for (int c = 0; c < 4; c++) {
+            pixels[i][c] = static_cast<uint8_t>(color[c]);
+        }
+    }
+}
+
+// ---- BC7 mode 6 ----
+
+constexpr int BC7_WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct Bc7Candidate {
+    // 7 bit endpoint channels plus the p-bit each endpoint shares over its channels
+    uint8_t endpoints[2][4];
+    uint8_t pbits[2];
+    uint8_t indices[16];
+    float error;
+};
+
+inline void bc7Palette(const Bc7Candidate& candidate, float palette[16][4]) {
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) {
+            int e0 = candidate.endpoints[0][c] << 1 | candidate.pbits[0];
+            int e1 = candidate.endpoints[1][c] << 1 | candidate.pbits[1];
+            palette[i][c] = float(((64 - BC7_WEIGHTS4[i]) * e0 + BC7_WEIGHTS4[i] * e1 + 32) >> 6);
+        }
+    }
+}
+
+// quantizes one endpoint to 7 bits per channel under a given p-bit, and returns the squared error that costs
+inline float bc7QuantizeEndpoint(const float endpoint[4], int pbit, uint8_t out[4]) {
+    float error = 0.0f;
+    for (int c = 0; c < 4; c++) {
+        int q = std::clamp(static_cast<int>((endpoint[c] - pbit) / 2.0f + 0.5f), 0, 127);
+        out[c] = static_cast<uint8_t>(q);
+        float d = float(q << 1 | pbit) - endpoint[c];
+        error += d * d;
+    }
+    return error;
+}
+
+inline Bc7Candidate bc7Evaluate(const BcBlock& block, const float endpoint0[4], const float endpoint1[4], BcQuality quality) {
+    Bc7Candidate best{};
+    best.error = INFINITY;
+    if (quality == BcQuality::High) {
+        // every p-bit combination, judged on the whole block
+        for (int pbits = 0; pbits < 4; pbits++) {
+            Bc7Candidate candidate{};
+            candidate.pbits[0] = pbits & 1;
+            candidate.pbits[1] = pbits >> 1;
+            bc7QuantizeEndpoint(endpoint0, candidate.pbits[0], candidate.endpoints[0]);
+            bc7QuantizeEndpoint(endpoint1, candidate.pbits[1], candidate.endpoints[1]);
+            float palette[16][4];
+            bc7Palette(candidate, palette);
+            candidate.error = bcChooseIndices(block, palette, 16, 4, candidate.indices);
+            if (candidate.error < best.error) {
+                best = candidate;
+            }
+        }
+        return best;
+    }
+    // the p-bit that quantizes each endpoint best on its own
+    for (int e = 0; e < 2; e++) {
+        const float* endpoint = e == 0 ? endpoint0 : endpoint1;
+        uint8_t zero[4], one[4];
+        bool useOne = bc7QuantizeEndpoint(endpoint, 1, one) < bc7QuantizeEndpoint(endpoint, 0, zero);
+        best.pbits[e] = useOne ? 1 : 0;
+        memcpy(best.endpoints[e], useOne ? one : zero, 4);
+    }
+    float palette[16][4];
+    bc7Palette(best, palette);
+    best.error = bcChooseIndices(block, palette, 16, 4, best.indices);
+    return best;
+}
+
+inline void encodeBc7Block(const BcBlock& block, BcQuality quality, uint8_t out[16]) {
+    static const float WEIGHTS[16] = {0.0f / 64, 4.0f / 64, 9.0f / 64, 13.0f / 64, 17.0f / 64, 21.0f / 64, 26.0f / 64, 30.0f / 64,
+                                      34.0f / 64, 38.0f / 64, 43.0f / 64, 47.0f / 64, 51.0f / 64, 55.0f / 64, 60.0f / 64, 64.0f / 64};
+
+    float endpoint0[4], endpoint1[4];
+    bcFitLine(block, 4, endpoint0, endpoint1);
+    Bc7Candidate best = bc7Evaluate(block, endpoint0, endpoint1, quality);
+    for (int iteration = 0; iteration < bcRefinements(quality) && best.error > 0.0f; iteration++) {
+        if (!bcLeastSquares(block, 4, best.indices, WEIGHTS, endpoint0, endpoint1)) {
+            break;
+        }
+        Bc7Candidate next = bc7Evaluate(block, endpoint0, endpoint1, quality);
+        if (next.error >= best.error) {
+            break;
+        }
+        best = next;
+    }
+
+    // the first pixel's index only gets 3 bits, its top bit is implied to be 0. flipping the endpoints flips every
+    // index, which makes that true
+    if (best.indices[0] >= 8) {
+        std::swap(best.endpoints[0], best.endpoints[1]);
+        std::swap(best.pbits[0], best.pbits[1]);
+        for (uint8_t& index : best.indices) {
+            index = static_cast<uint8_t>(15 - index);
+        }
+    }
+
+    // 128 bits, least significant first: mode (7 bits, 1 << 6), R0 R1 G0 G1 B0 B1 A0 A1 (7 bits each), P0 P1,
+    // then the indices
+    uint64_t bits[2] = {};
+    int position = 0;
+    auto write = [&](uint64_t value, int count) {
+        for (int i = 0; i < count; i++, position++) {
+            bits[position / 64] |= ((value >> i) & 1) << (position % 64);
+        }
+    };
+    write(1 << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        write(best.endpoints[0][c], 7);
+        write(best.endpoints[1][c], 7);
+    }
+    write(best.pbits[0], 1);
+    write(best.pbits[1], 1);
+    write(best.indices[0], 3);
+    for (int i = 1; i < 16; i++) {
+        write(best.indices[i], 4);
+    }
+    memcpy(out, bits, 16);
+}
+
+// reads back mode 6 blocks, which is all encodeBc7Block() writes. anything else comes out magenta
+inline void decodeBc7Block(const uint8_t in[16], uint8_t pixels[16][4]) {
+    uint64_t bits[2];
+    memcpy(bits, in, 16);
+    int position = 0;
+    auto read = [&](int count) {
+        uint32_t value = 0;
+        for (int i = 0; i < count; i++, position++) {
+            value |= uint32_t((bits[position / 64] >> (position % 64)) & 1) << i;
+        }
+        return value;
+    };
+    if (read(7) != (1 << 6)) {
+        for (int i = 0; i < 16; i++) {
+            pixels[i][0] = 255, pixels[i][1] = 0, pixels[i][2] = 255, pixels[i][3] = 255;
+        }
+        return;
+    }
+    Bc7Candidate block{};
+    for (int c = 0; c < 4; c++) {
+        block.endpoints[0][c] = static_cast<uint8_t>(read(7));
+        block.endpoints[1][c] = static_cast<uint8_t>(read(7));
+    }
+    block.pbits[0] = static_cast<uint8_t>(read(1));
+    block.pbits[1] = static_cast<uint8_t>(read(1));
+    float palette[16][4];
+    bc7Palette(block, palette);
+    for (int i = 0; i < 16; i++) {
+        const float* color = palette[read(i == 0 ? 3 : 4)];
+        for (int c = 0; c < 4; c++) {
+            pixels[i][c] = static_cast<uint8_t>(color[c]);
+        }
+    }
+}
+
+// ---- whole images ----
+
+// encodes one RGBA8 mip level. rows of blocks are handed out to the pool in batches when there is one
+inline std::vector<uint8_t> compressLevel(const uint8_t* rgba, uint32_t width, uint32_t height, TextureFormat format,
+                                          BcQuality quality, ThreadPool* pool = nullptr) {
+    if (format != TextureFormat::Bc1 && format != TextureFormat::Bc7) {
+        throw std::runtime_error("compressLevel only encodes BC1 and BC7");
+    }
+    uint32_t blocksX = (width + 3) / 4;
+    uint32_t blocksY = (height + 3) / 4;
+    size_t blockBytes = format == TextureFormat::Bc1 ? 8 : 16;
+    std::vector<uint8_t> out(size_t(blocksX) * blocksY * blockBytes);
+
+    auto encodeRows = [&, rgba, width, height](uint32_t firstRow, uint32_t lastRow) {
+        BcBlock block;
+        for (uint32_t by = firstRow; by < lastRow; by++) {
+            for (uint32_t bx = 0; bx < blocksX; bx++) {
+                loadBcBlock(rgba, width, height, bx, by, block);
+                uint8_t* dst = out.data() + (size_t(by) * blocksX + bx) * blockBytes;
+                if (format == TextureFormat::Bc1) {
+                    encodeBc1Block(block, quality, dst);
+                } else {
+                    encodeBc7Block(block, quality, dst);
+                }
+            }
+        }
+    };
+
+    // enough rows per job to make the job overhead disappear on small levels
+    const uint32_t ROWS_PER_JOB = std::max(1u, 4096 / blocksX);
+    if (pool == nullptr || blocksY <= ROWS_PER_JOB) {
+        encodeRows(0, blocksY);
+        return out;
+    }
+    std::vector<std::future<void>> jobs;
+    for (uint32_t row = ROWS_PER_JOB; row < blocksY; row += ROWS_PER_JOB) {
+        uint32_t last = std::min(blocksY, row + ROWS_PER_JOB);
+        jobs.push_back(pool->submit([&encodeRows, row, last] { encodeRows(row, last); }));
+    }
+    // the calling thread does the first batch instead of just waiting
+    encodeRows(0, ROWS_PER_JOB);
+    for (auto& job : jobs) {
+        job.get();
+    }
+    return out;
+}
+
+// turns an RGBA8 mip chain into a block compressed one. never pass a pool from inside one of its own jobs, waiting
+// on jobs queued behind yourself deadlocks
+inline TextureSource compressTexture(const TextureSource& source, TextureFormat format, BcQuality quality, ThreadPool* pool = nullptr) {
+    if (source.format() != TextureFormat::Rgba8) {
+        throw std::runtime_error("only RGBA8 textures can be compressed");
+    }
+    std::vector<std::vector<uint8_t>> levels;
+    for (uint32_t level = 0; level < source.levelCount(); level++) {
+        levels.push_back(compressLevel(source.level(level).data, source.width(level), source.height(level), format, quality, pool));
+    }
+    return TextureSource::fromLevels(format, source.width(), source.height(), levels);
+}
+
+// back to RGBA8, for checking what the encoder did
+inline std::vector<uint8_t> decompressLevel(const uint8_t* blocks, uint32_t width, uint32_t height, TextureFormat format) {
+    uint32_t blocksX = (width + 3) / 4;
+    size_t blockBytes = format == TextureFormat::Bc1 ? 8 : 16;
+    std::vector<uint8_t> rgba(size_t(width) * height * 4);
+    for (uint32_t by = 0; by < (height + 3) / 4; by++) {
+        for (uint32_t bx = 0; bx < blocksX; bx++) {
+            uint8_t pixels[16][4];
+            const uint8_t* block = blocks + (size_t(by) * blocksX + bx) * blockBytes;
+            if (format == TextureFormat::Bc1) {
+                decodeBc1Block(block, pixels);
+            } else {
+                decodeBc7Block(block, pixels);
+            }
+            for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++) {
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++) {
+                    memcpy(&rgba[((size_t(by) * 4 + y) * width + bx * 4 + x) * 4], pixels[y * 4 + x], 4);
+                }
+            }
+        }
+    }
+    return rgba;
+}
+
+#endif //VULKAN_TUTORIAL_BLOCK_COMPRESSION_H
@@ -0,0 +1,635 @@
+#ifndef VULKAN_TUTORIAL_COMMAND_STREAM_H
+#define VULKAN_TUTORIAL_COMMAND_STREAM_H
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.h"
+#include "texture_streaming.h"
+
+// a recorded frame: the draws of the main pass plus everything they touch (pipeline state with the shader code, vertex
+// and index buffer contents, texture mip chains), so frame_replay can rebuild it all on another machine and run it
+// without a window. it's written as a .vkcs file:
+//
+//   header: magic "VKCS", version, then the render target setup (extent, color/depth format, samples)
+//   blobs: raw bytes (SPIR-V, buffer and texture contents), each stored once no matter how many things use it
+//   pipelines, buffers, images: fixed fields that refer to blobs by index
+//   commands: an opcode followed by its arguments, all 32 bit words
+//
+// everything is little endian, as it comes out of memory
+
+const char COMMAND_STREAM_MAGIC[4] = {'V', 'K', 'C', 'S'};
+const uint32_t COMMAND_STREAM_VERSION = 2;
+// push constants a stream may use: the least every device has, and more than the app's DrawData needs
+const uint32_t COMMAND_STREAM_MAX_PUSH_CONSTANTS = 128;
+
+enum class StreamOp : uint32_t {
+    // pipeline id
+    BindPipeline,
+    // buffer id, offset (low word, high word)
+    BindVertexBuffer,
+    // buffer id, offset (low word, high word), VkIndexType
+    BindIndexBuffer,
+    // image id, bound as set 0 (a combined image sampler at binding 0)
+    BindTexture,
+    // x, y, width, height, minDepth, maxDepth, as float bits
+    SetViewport,
+    // x, y, width, height
+    SetScissor,
+    // vertexCount, instanceCount, firstVertex, firstInstance
+    Draw,
+    // indexCount, instanceCount, firstIndex, vertexOffset, firstInstance
+    DrawIndexed,
+    // offset, size, blob id holding the bytes, for the vertex stage
+    PushConstants,
+    Count,
+};
+
+inline uint32_t streamOpArgCount(StreamOp op) {
+    switch (op) {
+        case StreamOp::BindPipeline:
+        case StreamOp::BindTexture:
+            return 1;
+        case StreamOp::BindVertexBuffer:
+        case StreamOp::PushConstants:
+            return 3;
+        case StreamOp::BindIndexBuffer:
+        case StreamOp::SetScissor:
+        case StreamOp::Draw:
+            return 4;
+        case StreamOp::DrawIndexed:
+            return 5;
+        case StreamOp::SetViewport:
+            return 6;
+        case StreamOp::Count:
+            break;
+    }
+    throw std::runtime_error("unknown command stream op");
+}
+
+inline const char* streamOpName(StreamOp op) {
+    switch (op) {
+        case StreamOp::BindPipeline:
+            return "BindPipeline";
+        case StreamOp::BindVertexBuffer:
+            return "BindVertexBuffer";
+        case StreamOp::BindIndexBuffer:
+            return "BindIndexBuffer";
+        case StreamOp::BindTexture:
+            return "BindTexture";
+        case StreamOp::SetViewport:
+            return "SetViewport";
+        case StreamOp::SetScissor:
+            return "SetScissor";
+        case StreamOp::Draw:
+            return "Draw";
+        case StreamOp::DrawIndexed:
+            return "DrawIndexed";
+        case StreamOp::PushConstants:
+            return "PushConstants";
+        case StreamOp::Count:
+            break;
+    }
+    return "?";
+}
+
+struct StreamCommand {
+    StreamOp op;
+    uint32_t args[6];
+};
+
+struct StreamVertexAttribute {
+    uint32_t location;
+    VkFormat format;
+    uint32_t offset;
+};
+
+// a graphics pipeline as plain values. it always has one vertex binding, viewport and scissor are dynamic, and the
+// layout is the app's: set 0 holds a combined image sampler for the fragment shader, set 1 a storage buffer for the
+// vertex shader, and push constants are vertex stage only
+struct StreamPipeline {
+    uint32_t vertShader = 0;
+    uint32_t fragShader = 0;
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+    VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+    uint32_t blendEnable = 0;
+    uint32_t colorWrite = 1;
+    uint32_t depthTest = 0;
+    uint32_t depthWrite = 0;
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+    uint32_t vertexStride = 0;
+    std::vector<StreamVertexAttribute> attributes;
+    // specialization constant i is word i, for both stages
+    std::vector<uint32_t> specialization;
+};
+
+struct StreamBuffer {
+    uint32_t blob = 0;
+};
+
+// a sampled 2D image, its levels back to back in the blob
+struct StreamImage {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint64_t> levelSizes;
+    uint32_t blob = 0;
+};
+
+struct CommandStream {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    uint32_t samples = 1;
+    std::vector<std::vector<uint8_t>> blobs;
+    std::vector<StreamPipeline> pipelines;
+    std::vector<StreamBuffer> buffers;
+    std::vector<StreamImage> images;
+    std::vector<StreamCommand> commands;
+};
+
+// builds a CommandStream while a frame is being recorded. objects are keyed by their Vulkan handle and only described
+// (and have their contents copied) the first time a command uses them. render thread only
+class CommandStreamRecorder {
+public:
+    CommandStream stream;
+
+    // turns any Vulkan handle (a pointer or a uint64_t, depending on the platform) into a map key
+    template<typename Handle>
+    static uint64_t handleKey(Handle handle) {
+        return (uint64_t) handle;
+    }
+
+    // id of the pipeline with this handle, calling describe() for its StreamPipeline if it's new
+    template<typename Describe>
+    uint32_t pipelineId(uint64_t handle, Describe&& describe) {
+        return objectId(pipelineIds, stream.pipelines, handle, describe);
+    }
+
+    // buffer contents can be filled in later, usually once the frame has run
+    template<typename Describe>
+    uint32_t bufferId(uint64_t handle, Describe&& describe) {
+        return objectId(bufferIds, stream.buffers, handle, describe);
+    }
+
+    template<typename Describe>
+    uint32_t imageId(uint64_t handle, Describe&& describe) {
+        return objectId(imageIds, stream.images, handle, describe);
+    }
+
+    // stores the bytes unless an identical blob is already there (the same shader in several pipelines, say)
+    uint32_t addBlob(const void* data, size_t size) {
+        uint64_t hash = 14695981039346656037ULL;
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        auto range = blobsByHash.equal_range(hash);
+        for (auto it = range.first; it != range.second; it++) {
+            const std::vector<uint8_t>& blob = stream.blobs[it->second];
+            if (blob.size() == size && (size == 0 || memcmp(blob.data(), data, size) == 0)) {
+                return it->second;
+            }
+        }
+        uint32_t id = static_cast<uint32_t>(stream.blobs.size());
+        stream.blobs.emplace_back(bytes, bytes + size);
+        blobsByHash.emplace(hash, id);
+        return id;
+    }
+
+    void command(StreamOp op, std::initializer_list<uint32_t> args) {
+        if (args.size() != streamOpArgCount(op)) {
+            throw std::runtime_error("wrong argument count for command stream op");
+        }
+        StreamCommand command{op, {}};
+        std::copy(args.begin(), args.end(), command.args);
+        stream.commands.push_back(command);
+    }
+
+    static uint32_t floatBits(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+private:
+    template<typename T, typename Describe>
+    uint32_t objectId(std::unordered_map<uint64_t, uint32_t>& ids, std::vector<T>& objects, uint64_t handle, Describe& describe) {
+        auto it = ids.find(handle);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        uint32_t id = static_cast<uint32_t>(objects.size());
+        objects.push_back(describe());
+        ids.emplace(handle, id);
+        return id;
+    }
+
+    std::unordered_map<uint64_t, uint32_t> pipelineIds;
+    std::unordered_map<uint64_t, uint32_t> bufferIds;
+    std::unordered_map<uint64_t, uint32_t> imageIds;
+    std::unordered_multimap<uint64_t, uint32_t> blobsByHash;
+};
+
+inline float streamFloat(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// appends 32/64 bit words and byte runs, the writing half of the file format
+class StreamWriter {
+public:
+    std::vector<uint8_t> bytes;
+
+    void u32(uint32_t value) {
+        append(&value, sizeof(value));
+    }
+
+    void u64(uint64_t value) {
+        append(&value, sizeof(value));
+    }
+
+    void append(const void* data, size_t size) {
+        const auto* begin = static_cast<const uint8_t*>(data);
+        bytes.insert(bytes.end(), begin, begin + size);
+    }
+};
+
+// reads the same back out of a mapped file, throwing on anything that runs past the end
+class StreamReader {
+public:
+    explicit StreamReader(ByteView data) : data(data) {}
+
+    uint32_t u32() {
+        uint32_t value;
+        read(&value, sizeof(value));
+        return value;
+    }
+
+    uint64_t u64() {
+        uint64_t value;
+        read(&value, sizeof(value));
+        return value;
+    }
+
+    // a count of things that each take at least minBytes, checked against what's left so a corrupt file can't make
+    // us allocate gigabytes
+    uint32_t count(size_t minBytes) {
+        uint32_t n = u32();
+        if (uint64_t(n) * minBytes > data.size - offset) {
+            throw std::runtime_error("command stream is truncated");
+        }
+        return n;
+    }
+
+    void read(void* out, size_t size) {
+        if (size > data.size - offset) {
+            throw std::runtime_error("command stream is truncated");
+        }
+        memcpy(out, data.data + offset, size);
+        offset += size;
+    }
+
+private:
+    ByteView data;
+    size_t offset = 0;
+};
+
+inline void writeCommandStream(const std::string& path, const CommandStream& stream) {
+    StreamWriter out;
+    out.append(COMMAND_STREAM_MAGIC, sizeof(COMMAND_STREAM_MAGIC));
+    out.u32(COMMAND_STREAM_VERSION);
+    out.u32(stream.width);
+    out.u32(stream.height);
+    out.u32(static_cast<uint32_t>(stream.colorFormat));
+    out.u32(static_cast<uint32_t>(stream.depthFormat));
+    out.u32(stream.samples);
+
+    out.u32(static_cast<uint32_t>(stream.blobs.size()));
+    for (const auto& blob : stream.blobs) {
+        out.u64(blob.size());
+        out.append(blob.data(), blob.size());
+    }
+
+    out.u32(static_cast<uint32_t>(stream.pipelines.size()));
+    for (const StreamPipeline& pipeline : stream.pipelines) {
+        out.u32(pipeline.vertShader);
+        out.u32(pipeline.fragShader);
+        out.u32(static_cast<uint32_t>(pipeline.topology));
+        out.u32(pipeline.cullMode);
+        out.u32(static_cast<uint32_t>(pipeline.frontFace));
+        out.u32(pipeline.blendEnable);
+        out.u32(pipeline.colorWrite);
+        out.u32(pipeline.depthTest);
+        out.u32(pipeline.depthWrite);
+        out.u32(static_cast<uint32_t>(pipeline.depthCompareOp));
+        out.u32(pipeline.vertexStride);
+        out.u32(static_cast<uint32_t>(pipeline.attributes.size()));
+        for (const StreamVertexAttribute& attribute : pipeline.attributes) {
+            out.u32(attribute.location);
+            out.u32(static_cast<uint32_t>(attribute.format));
+            out.u32(attribute.offset);
+        }
+        out.u32(static_cast<uint32_t>(pipeline.specialization.size()));
+        for (uint32_t word : pipeline.specialization) {
+            out.u32(word);
+        }
+    }
+
+    out.u32(static_cast<uint32_t>(stream.buffers.size()));
+    for (const StreamBuffer& buffer : stream.buffers) {
+        out.u32(buffer.blob);
+    }
+
+    out.u32(static_cast<uint32_t>(stream.images.size()));
+    for (const StreamImage& image : stream.images) {
+        out.u32(static_cast<uint32_t>(image.format));
+        out.u32(image.width);
+        out.u32(image.height);
+        out.u32(static_cast<uint32_t>(image.levelSizes.size()));
+        for (uint64_t size : image.levelSizes) {
+            out.u64(size);
+        }
+        out.u32(image.blob);
+    }
+
+    out.u32(static_cast<uint32_t>(stream.commands.size()));
+    for (const StreamCommand& command : stream.commands) {
+        out.u32(static_cast<uint32_t>(command.op));
+        out.append(command.args, sizeof(uint32_t) * streamOpArgCount(command.op));
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("failed to open " + path + " for writing");
+    }
+    bool ok = fwrite(out.bytes.data(), 1, out.bytes.size(), file) == out.bytes.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        throw std::runtime_error("failed to write " + path);
+    }
+}
+
+// the texture formats the app records images in, nullopt for anything else
+inline std::optional<TextureFormat> streamTextureFormat(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            return TextureFormat::Rgba8;
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            return TextureFormat::Bc1;
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return TextureFormat::Bc7;
+        default:
+            return std::nullopt;
+    }
+}
+
+// checks everything a replay would otherwise trust: the render target setup, that every image's levels are exactly
+// the size its format and extent say (the replay creates the image from those and copies the levels in), and, playing
+// the commands through on the CPU, that every push stays inside the push constant range and that every draw only
+// reads vertices and indices its bound buffers actually have
+inline void validateCommandStream(const CommandStream& stream) {
+    if (stream.width == 0 || stream.height == 0) {
+        throw std::runtime_error("command stream has an empty render target");
+    }
+    if (stream.samples == 0 || stream.samples > VK_SAMPLE_COUNT_64_BIT || (stream.samples & (stream.samples - 1)) != 0) {
+        throw std::runtime_error("command stream has a sample count that isn't a power of two up to 64");
+    }
+
+    for (const StreamImage& image : stream.images) {
+        std::optional<TextureFormat> format = streamTextureFormat(image.format);
+        if (!format) {
+            throw std::runtime_error("command stream image has a format the app never records");
+        }
+        // far past what any GPU can sample, and small enough that level sizes can't overflow
+        if (image.width == 0 || image.height == 0 || image.width > 65536 || image.height > 65536) {
+            throw std::runtime_error("command stream image has an impossible size");
+        }
+        // levels run from the image's size down, and there can't be more than it takes to get to 1x1
+        uint32_t fullLevelCount = 1;
+        while ((std::max(image.width, image.height) >> fullLevelCount) != 0) {
+            fullLevelCount++;
+        }
+        if (image.levelSizes.size() > fullLevelCount) {
+            throw std::runtime_error("command stream image has more mip levels than its size allows");
+        }
+        for (uint32_t level = 0; level < image.levelSizes.size(); level++) {
+            if (image.levelSizes[level] != textureLevelBytes(*format, mipExtent(image.width, level), mipExtent(image.height, level))) {
+                throw std::runtime_error("command stream image level doesn't match its format and size");
+            }
+        }
+    }
+
+    const StreamPipeline* pipeline = nullptr;
+    const std::vector<uint8_t>* vertexBuffer = nullptr;
+    uint64_t vertexOffset = 0;
+    const std::vector<uint8_t>* indexBuffer = nullptr;
+    uint64_t indexOffset = 0;
+    uint32_t indexSize = 0;
+    // whether vertices first to first + count are in the buffer. divided rather than multiplied out, a stride read
+    // from the file could overflow even 64 bits
+    auto checkVertices = [&](uint64_t first, uint64_t count) {
+        if (pipeline == nullptr || vertexBuffer == nullptr) {
+            throw std::runtime_error("command stream draws without a pipeline and vertex buffer bound");
+        }
+        uint64_t stride = pipeline->vertexStride;
+        if (count > 0 && stride > 0 && first + count > (vertexBuffer->size() - vertexOffset) / stride) {
+            throw std::runtime_error("command stream draw reads past the end of its vertex buffer");
+        }
+    };
+
+    for (const StreamCommand& command : stream.commands) {
+        const uint32_t* args = command.args;
+        switch (command.op) {
+            case StreamOp::BindPipeline:
+                pipeline = &stream.pipelines[args[0]];
+                break;
+            case StreamOp::BindVertexBuffer:
+                vertexBuffer = &stream.blobs[stream.buffers[args[0]].blob];
+                vertexOffset = args[1] | (uint64_t(args[2]) << 32);
+                if (vertexOffset > vertexBuffer->size()) {
+                    throw std::runtime_error("command stream binds a vertex buffer past its end");
+                }
+                break;
+            case StreamOp::BindIndexBuffer:
+                indexBuffer = &stream.blobs[stream.buffers[args[0]].blob];
+                indexOffset = args[1] | (uint64_t(args[2]) << 32);
+                if (args[3] != VK_INDEX_TYPE_UINT16 && args[3] != VK_INDEX_TYPE_UINT32) {
+                    throw std::runtime_error("command stream binds an index buffer of an unknown index type");
+                }
+                indexSize = args[3] == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+                if (indexOffset > indexBuffer->size() || indexOffset % indexSize != 0) {
+                    throw std::runtime_error("command stream binds an index buffer past its end");
+                }
+                break;
+            case StreamOp::Draw:
+                checkVertices(args[2], args[0]);
+                break;
+            case StreamOp::DrawIndexed: {
+                if (indexBuffer == nullptr) {
+                    throw std::runtime_error("command stream draws indexed without an index buffer bound");
+                }
+                uint64_t firstIndex = args[2];
+                uint64_t indexCount = args[0];
+                if (indexOffset + (firstIndex + indexCount) * indexSize > indexBuffer->size()) {
+                    throw std::runtime_error("command stream draw reads past the end of its index buffer");
+                }
+                if (indexCount == 0) {
+                    checkVertices(0, 0);
+                    break;
+                }
+                // the vertices it reads are the ones its indices name, shifted by vertexOffset
+                uint32_t minIndex = UINT32_MAX;
+                uint32_t maxIndex = 0;
+                const uint8_t* indices = indexBuffer->data() + indexOffset + firstIndex * indexSize;
+                for (uint64_t i = 0; i < indexCount; i++) {
+                    uint32_t index;
+                    if (indexSize == 2) {
+                        uint16_t index16;
+                        memcpy(&index16, indices + i * 2, sizeof(index16));
+                        index = index16;
+                    } else {
+                        memcpy(&index, indices + i * 4, sizeof(index));
+                    }
+                    minIndex = std::min(minIndex, index);
+                    maxIndex = std::max(maxIndex, index);
+                }
+                int64_t first = int64_t(int32_t(args[3])) + minIndex;
+                if (first < 0) {
+                    throw std::runtime_error("command stream draw reads before the start of its vertex buffer");
+                }
+                checkVertices(uint64_t(first), uint64_t(maxIndex - minIndex) + 1);
+                break;
+            }
+            case StreamOp::PushConstants:
+                if (args[0] % 4 != 0 || args[1] % 4 != 0 || args[1] == 0 || args[0] > COMMAND_STREAM_MAX_PUSH_CONSTANTS
+                    || args[1] > COMMAND_STREAM_MAX_PUSH_CONSTANTS - args[0]) {
+                    throw std::runtime_error("command stream pushes constants outside the push constant range");
+                }
+                break;
+            case StreamOp::BindTexture:
+            case StreamOp::SetViewport:
+            case StreamOp::SetScissor:
+            case StreamOp::Count:
+                break;
+        }
+    }
+}
+
+inline CommandStream readCommandStream(const std::string& path) {
+    MappedFile file(path);
+    StreamReader in(file.view());
+    char magic[4];
+    in.read(magic, sizeof(magic));
+    if (memcmp(magic, COMMAND_STREAM_MAGIC, sizeof(magic)) != 0 || in.u32() != COMMAND_STREAM_VERSION) {
+        throw std::runtime_error(path + " isn't a recorded frame (or is from another version)");
+    }
+
+    CommandStream stream;
+    stream.width = in.u32();
+    stream.height = in.u32();
+    stream.colorFormat = static_cast<VkFormat>(in.u32());
+    stream.depthFormat = static_cast<VkFormat>(in.u32());
+    stream.samples = in.u32();
+
+    stream.blobs.resize(in.count(sizeof(uint64_t)));
+    for (auto& blob : stream.blobs) {
+        uint64_t size = in.u64();
+        if (size > SIZE_MAX) {
+            throw std::runtime_error("command stream is truncated");
+        }
+        blob.resize(static_cast<size_t>(size));
+        in.read(blob.data(), blob.size());
+    }
+    auto checkBlob = [&](uint32_t blob) {
+        if (blob >= stream.blobs.size()) {
+            throw std::runtime_error("command stream refers to a missing blob");
+        }
+        return blob;
+    };
+
+    stream.pipelines.resize(in.count(13 * sizeof(uint32_t)));
+    for (StreamPipeline& pipeline : stream.pipelines) {
+        pipeline.vertShader = checkBlob(in.u32());
+        pipeline.fragShader = checkBlob(in.u32());
+        pipeline.topology = static_cast<VkPrimitiveTopology>(in.u32());
+        pipeline.cullMode = in.u32();
+        pipeline.frontFace = static_cast<VkFrontFace>(in.u32());
+        pipeline.blendEnable = in.u32();
+        pipeline.colorWrite = in.u32();
+        pipeline.depthTest = in.u32();
+        pipeline.depthWrite = in.u32();
+        pipeline.depthCompareOp = static_cast<VkCompareOp>(in.u32());
+        pipeline.vertexStride = in.u32();
+        pipeline.attributes.resize(in.count(3 * sizeof(uint32_t)));
+        for (StreamVertexAttribute& attribute : pipeline.attributes) {
+            attribute.location = in.u32();
+            attribute.format = static_cast<VkFormat>(in.u32());
+            attribute.offset = in.u32();
+        }
+        pipeline.specialization.resize(in.count(sizeof(uint32_t)));
+        for (uint32_t& word : pipeline.specialization) {
+            word = in.u32();
+        }
+    }
+
+    stream.buffers.resize(in.count(sizeof(uint32_t)));
+    for (StreamBuffer& buffer : stream.buffers) {
+        buffer.blob = checkBlob(in.u32());
+    }
+
+    stream.images.resize(in.count(5 * sizeof(uint32_t)));
+    for (StreamImage& image : stream.images) {
+        image.format = static_cast<VkFormat>(in.u32());
+        image.width = in.u32();
+        image.height = in.u32();
+        image.levelSizes.resize(in.count(sizeof(uint64_t)));
+        uint64_t total = 0;
+        for (uint64_t& size : image.levelSizes) {
+            size = in.u64();
+            total += size;
+        }
+        image.blob = checkBlob(in.u32());
+        if (image.levelSizes.empty() || total != stream.blobs[image.blob].size()) {
+            throw std::runtime_error("command stream image doesn't match its contents");
+        }
+    }
+
+    stream.commands.resize(in.count(sizeof(uint32_t)));
+    for (StreamCommand& command : stream.commands) {
+        uint32_t op = in.u32();
+        if (op >= static_cast<uint32_t>(StreamOp::Count)) {
+            throw std::runtime_error("command stream has an unknown op");
+        }
+        command.op = static_cast<StreamOp>(op);
+        in.read(command.args, sizeof(uint32_t) * streamOpArgCount(command.op));
+        size_t objectCount = command.op == StreamOp::BindPipeline ? stream.pipelines.size()
+                             : command.op == StreamOp::BindVertexBuffer || command.op == StreamOp::BindIndexBuffer ? stream.buffers.size()
+                             : command.op == StreamOp::BindTexture ? stream.images.size() : SIZE_MAX;
+        if (command.args[0] >= objectCount) {
+            throw std::runtime_error("command stream refers to a missing object");
+        }
+        if (command.op == StreamOp::PushConstants && (command.args[2] >= stream.blobs.size() ||
+                                                      stream.blobs[command.args[2]].size() != command.args[1])) {
+            throw std::runtime_error("command stream push constants don't match their contents");
+        }
+    }
+    validateCommandStream(stream);
+    return stream;
+}
+
+#endif //VULKAN_TUTORIAL_COMMAND_STREAM_H
@@ -0,0 +1,118 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "scene.h"
+
+// compares the SoA + SIMD frustum cull against the plain one-struct-per-object loop on a big random scene.
+// usage: cull_bench [object count] [iterations]
+
+using Clock = std::chrono::steady_clock;
+
+// runs the cull once per camera and hands back the median time in milliseconds
+template<typename F>
+static double medianMs(size_t iterations, F&& cull) {
+    std::vector<double> times;
+    for (size_t i = 0; i < iterations; i++) {
+        auto start = Clock::now();
+        cull(i);
+        times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+int main(int argc, char** argv) {
+    size_t objectCount = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    size_t iterations = argc > 2 ? std::stoull(argv[2]) : 100;
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<SceneObject> objects(objectCount);
+    Scene scene;
+    for (SceneObject& object : objects) {
+        object.position = glm::vec3(position(rng), position(rng), position(rng));
+        object.scale = 0.5f + 1.5f * unit(rng);
+        object.boundsCenter = glm::vec3(unit(rng), unit(rng), unit(rng)) * 0.5f;
+        object.boundsRadius = 1.0f;
+        object.color = glm::vec3(unit(rng), unit(rng), unit(rng));
+        scene.add(object.position, object.scale, object.boundsCenter, object.boundsRadius, object.color);
+    }
+
+    // a camera in the middle of the scene, turning around a full circle over the run
+    std::vector<Frustum> frustums;
+    for (size_t i = 0; i < iterations; i++) {
+        float angle = 6.2831853f * float(i) / float(iterations);
+        glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(std::cos(angle), 0.2f, std::sin(angle)), glm::vec3(0.0f, 1.0f, 0.0f));
+        frustums.push_back(Frustum::fromMatrix(projection * view));
+    }
+
+    printf("%zu objects, %zu cameras, SIMD backend: %s (%d wide)\n", objectCount, iterations, simd::backendName(), simd::WIDTH);
+
+    // both sides get their world space bounds up front and only the culls are timed, the bounds updates are timed
+    // on their own
+    auto start = Clock::now();
+    updateObjectBounds(objects);
+    double objectBoundsMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    start = Clock::now();
+    scene.updateBounds();
+    double boundsMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::vector<uint32_t> visible;
+    double scalarMs = medianMs(iterations, [&](size_t i) {
+        cullObjectsScalar(objects, frustums[i], visible);
+    });
+
+    FrustumCuller culler;
+    double simdMs = medianMs(iterations, [&](size_t i) {
+        culler.cull(scene, frustums[i], visible);
+    });
+
+    ThreadPool pool;
+    double parallelMs = medianMs(iterations, [&](size_t i) {
+        culler.cull(scene, frustums[i], visible, &pool);
+    });
+
+    printf("%-28s %9.3f ms\n", "scalar AoS", scalarMs);
+    printf("%-28s %9.3f ms (%.1fx)\n", "SIMD SoA", simdMs, scalarMs / simdMs);
+    printf("%-28s %9.3f ms (%.1fx, %zu threads)\n", "SIMD SoA on the worker pool", parallelMs, scalarMs / parallelMs, pool.size() + 1);
+    printf("%-28s %9.3f ms (once, and again only after transforms change)\n", "AoS bounds update", objectBoundsMs);
+    printf("%-28s %9.3f ms\n", "SoA bounds update", boundsMs);
+
+    // then, untimed, every camera again: all three have to pick exactly the same objects. they do the same float
+    // math in the same order, so there's no rounding to hide behind
+    std::vector<uint32_t> scalarVisible, simdVisible, parallelVisible;
+    size_t visibleTotal = 0;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        cullObjectsScalar(objects, frustums[i], scalarVisible);
+        culler.cull(scene, frustums[i], simdVisible);
+        culler.cull(scene, frustums[i], parallelVisible, &pool);
+        std::sort(scalarVisible.begin(), scalarVisible.end());
+        std::sort(simdVisible.begin(), simdVisible.end());
+        std::sort(parallelVisible.begin(), parallelVisible.end());
+        if (simdVisible != scalarVisible || parallelVisible != scalarVisible) {
+            if (mismatches == 0) {
+                printf("camera %zu: %zu visible (scalar) %zu (SIMD) %zu (parallel)\n", i, scalarVisible.size(),
+                       simdVisible.size(), parallelVisible.size());
+            }
+            mismatches++;
+        }
+        visibleTotal += scalarVisible.size();
+    }
+    printf("average visible: %.0f\n", double(visibleTotal) / iterations);
+    if (mismatches != 0) {
+        printf("visible objects don't match for %zu of %zu cameras!\n", mismatches, iterations);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,125 @@
+#ifndef VULKAN_TUTORIAL_DRAW_DATA_H
+#define VULKAN_TUTORIAL_DRAW_DATA_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// what each draw hands shader.vert (must match the DrawData struct there, std430 rules: a mat4 and a vec4 pack with no
+// padding). 80 bytes, so it fits in the 128 bytes of push constants every GPU has
+struct DrawData {
+    glm::mat4 transform{1.0f};
+    // multiplies the vertex color
+    glm::vec4 color{1.0f};
+};
+
+// how a draw's data reaches the shader
+enum class DrawDataPath : uint32_t {
+    // vkCmdPushConstants right before the draw, nothing to allocate or bind
+    PushConstants,
+    // a slot in this frame's draw data buffer, found by the shader through gl_InstanceIndex (the draw's firstInstance)
+    Buffer,
+};
+
+// hands out where each draw's T goes. small T go in push constants; anything bigger than the device allows is written
+// into a per frame buffer instead, bound once per frame, with each draw pointing at its slot through firstInstance.
+// either way a draw that reuses the previous draw's values gets them for free: nothing is pushed or written again.
+// a frame that fills its buffer pushes the rest of its draws' data when T fits, pointing them one past the end of the
+// buffer, which is how the shader knows to read its push constants. render thread only
+template<typename T>
+class DrawDataBinding {
+    static_assert(std::is_trivially_copyable<T>::value, "draw data is memcpy'd into push constants and buffers");
+
+public:
+    // a draw's slot. changed is false when the data is the same as the last draw's, which then still holds. path is
+    // how this draw's data gets there, which is the binding's path() unless the buffer is full
+    struct Slot {
+        uint32_t instance;
+        bool changed;
+        DrawDataPath path;
+    };
+
+    void init(uint32_t maxPushConstantsSize, bool forceBuffer, uint32_t bufferCapacity) {
+        canPush = sizeof(T) <= maxPushConstantsSize;
+        drawPath = forceBuffer || !canPush ? DrawDataPath::Buffer : DrawDataPath::PushConstants;
+        capacity = bufferCapacity;
+    }
+
+    // slots per frame buffer
+    uint32_t bufferCapacity() const {
+        return capacity;
+    }
+
+    void setBufferCapacity(uint32_t bufferCapacity) {
+        capacity = bufferCapacity;
+    }
+
+    DrawDataPath path() const {
+        return drawPath;
+    }
+
+    // starts a new command buffer. slots point into this frame's buffer (only used on the Buffer path), which the GPU
+    // must be done with
+    void beginFrame(T* slots) {
+        frameSlots = slots;
+        used = 0;
+        hasLast = false;
+    }
+
+    Slot allocate(const T& data) {
+        if (hasLast && memcmp(&last, &data, sizeof(T)) == 0) {
+            return {lastInstance, false, lastPath};
+        }
+        if (drawPath == DrawDataPath::PushConstants) {
+            return remember(data, 0, DrawDataPath::PushConstants);
+        }
+        // slots already written belong to draws that are already recorded, so a full buffer is never written past.
+        // either way the caller sees takeOverflow() and makes the buffers bigger before the next frame
+        if (used == capacity) {
+            overflowed = true;
+            if (canPush) {
+                return remember(data, capacity, DrawDataPath::PushConstants);
+            }
+            // nowhere to put it: the rest of the frame's draws are drawn with whatever the last draw had
+            return {lastInstance, false, lastPath};
+        }
+        memcpy(&frameSlots[used], &data, sizeof(T));
+        return remember(data, used++, DrawDataPath::Buffer);
+    }
+
+    // slots handed out this frame (how much of the buffer it used)
+    uint32_t slotsUsed() const {
+        return used;
+    }
+
+    // whether a frame ran out of slots since the last call
+    bool takeOverflow() {
+        bool was = overflowed;
+        overflowed = false;
+        return was;
+    }
+
+private:
+    Slot remember(const T& data, uint32_t instance, DrawDataPath path) {
+        last = data;
+        hasLast = true;
+        lastInstance = instance;
+        lastPath = path;
+        return {instance, true, path};
+    }
+
+    DrawDataPath drawPath = DrawDataPath::PushConstants;
+    bool canPush = true;
+    uint32_t capacity = 0;
+    T* frameSlots = nullptr;
+    uint32_t used = 0;
+    T last{};
+    uint32_t lastInstance = 0;
+    DrawDataPath lastPath = DrawDataPath::PushConstants;
+    bool hasLast = false;
+    bool overflowed = false;
+};
+
+#endif //VULKAN_TUTORIAL_DRAW_DATA_H
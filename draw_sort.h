@@ -0,0 +1,202 @@
+#ifndef VULKAN_TUTORIAL_DRAW_SORT_H
+#define VULKAN_TUTORIAL_DRAW_SORT_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+#include "thread_pool.h"
+
+// every draw of the main pass gets a 64 bit key, and the frame's draws are recorded in key order. from the top bit
+// down the key holds:
+//   layer           4 bits   things that must come before others whatever they bind (the depth prepass, overlays)
+//   pipeline       12 bits   pipeline changes cost the most, so draws sharing one end up next to each other
+//   descriptor set 16 bits   then the texture
+//   vertex buffer  12 bits   then the vertex buffer
+//   depth          20 bits   smaller first, so with the 0 (near) to 1 (far) depth callers pass, front to back: early
+//                            depth testing then throws away as much as possible
+// objects are turned into small ids with DrawKeyIds, anything past a field's range shares its last id. that only costs
+// some binds, the recording still binds whatever each draw actually needs
+
+enum class DrawLayer : uint32_t {
+    DepthPrepass,
+    Opaque,
+    // drawn over everything else (the triangle and the particles)
+    Overlay,
+};
+
+namespace DrawKey {
+constexpr uint32_t LAYER_BITS = 4;
+constexpr uint32_t PIPELINE_BITS = 12;
+constexpr uint32_t SET_BITS = 16;
+constexpr uint32_t BUFFER_BITS = 12;
+constexpr uint32_t DEPTH_BITS = 20;
+static_assert(LAYER_BITS + PIPELINE_BITS + SET_BITS + BUFFER_BITS + DEPTH_BITS == 64, "draw keys are 64 bits");
+
+// depth is 0 (near) to 1 (far), anything outside gets clamped
+inline uint64_t make(DrawLayer layer, uint32_t pipeline, uint32_t set, uint32_t vertexBuffer, float depth) {
+    const uint32_t depthMax = (1u << DEPTH_BITS) - 1;
+    uint32_t depthBits = static_cast<uint32_t>(std::clamp(depth, 0.0f, 1.0f) * float(depthMax));
+    uint64_t key = static_cast<uint64_t>(layer);
+    key = (key << PIPELINE_BITS) | pipeline;
+    key = (key << SET_BITS) | set;
+    key = (key << BUFFER_BITS) | vertexBuffer;
+    key = (key << DEPTH_BITS) | depthBits;
+    return key;
+}
+} // namespace DrawKey
+
+// hands out small dense ids for handles, in the order they're first seen. a frame only touches a handful of
+// pipelines, sets and buffers, so a linear search over a vector that keeps its storage beats a hash map. id 0 is
+// always the null handle
+class DrawKeyIds {
+public:
+    explicit DrawKeyIds(uint32_t bits) : maxId((1u << bits) - 1) {}
+
+    template<typename Handle>
+    uint32_t id(Handle handle) {
+        uint64_t key = (uint64_t) handle;
+        if (key == 0) {
+            return 0;
+        }
+        auto it = std::find(handles.begin(), handles.end(), key);
+        size_t index = it - handles.begin();
+        if (it == handles.end()) {
+            handles.push_back(key);
+        }
+        return static_cast<uint32_t>(std::min<size_t>(index + 1, maxId));
+    }
+
+    void clear() {
+        handles.clear();
+    }
+
+private:
+    uint32_t maxId;
+    std::vector<uint64_t> handles;
+};
+
+struct DrawSortEntry {
+    uint64_t key;
+    // into the frame's draw list
+    uint32_t draw;
+};
+
+// a stable LSD radix sort over draw keys, a byte per pass. bytes that are the same in every key (most of them in a
+// typical frame: few layers, few pipelines) are skipped outright. big lists are split into chunks that count and
+// scatter on the worker pool, the calling thread taking the first chunk. all the buffers stay allocated between frames
+class DrawSorter {
+public:
+    // below this the job overhead is more than the sorting
+    static constexpr size_t PARALLEL_THRESHOLD = 16 * 1024;
+    static constexpr size_t MIN_CHUNK_SIZE = 4 * 1024;
+
+    void sort(std::vector<DrawSortEntry>& entries, ThreadPool* pool = nullptr) {
+        size_t count = entries.size();
+        if (count < 2) {
+            return;
+        }
+        size_t chunkCount = 1;
+        if (pool != nullptr && count >= PARALLEL_THRESHOLD) {
+            chunkCount = std::min(pool->size() + 1, count / MIN_CHUNK_SIZE);
+        }
+        chunkSize = (count + chunkCount - 1) / chunkCount;
+        if (chunks.size() < chunkCount) {
+            chunks.resize(chunkCount);
+            pending.resize(chunkCount);
+        }
+        scratch.resize(count);
+
+        // one read up front finds the bytes worth sorting on
+        uint64_t first = entries[0].key;
+        uint64_t differing = 0;
+        for (const DrawSortEntry& entry : entries) {
+            differing |= entry.key ^ first;
+        }
+
+        DrawSortEntry* from = entries.data();
+        DrawSortEntry* to = scratch.data();
+        for (uint32_t shift = 0; shift < 64; shift += 8) {
+            if (((differing >> shift) & 0xff) == 0) {
+                continue;
+            }
+            runChunks(pool, chunkCount, [this, from, count, shift](size_t c) {
+                Histogram& histogram = chunks[c];
+                histogram.fill(0);
+                size_t end = std::min(count, (c + 1) * chunkSize);
+                for (size_t i = c * chunkSize; i < end; i++) {
+                    histogram[(from[i].key >> shift) & 0xff]++;
+                }
+            });
+            // each chunk's slice of each bucket starts after the earlier chunks' slices of it, which keeps it stable
+            size_t offset = 0;
+            for (size_t bucket = 0; bucket < 256; bucket++) {
+                for (size_t c = 0; c < chunkCount; c++) {
+                    size_t bucketCount = chunks[c][bucket];
+                    chunks[c][bucket] = offset;
+                    offset += bucketCount;
+                }
+            }
+            runChunks(pool, chunkCount, [this, from, to, count, shift](size_t c) {
+                Histogram& offsets = chunks[c];
+                size_t end = std::min(count, (c + 1) * chunkSize);
+                for (size_t i = c * chunkSize; i < end; i++) {
+                    to[offsets[(from[i].key >> shift) & 0xff]++] = from[i];
+                }
+            });
+            std::swap(from, to);
+        }
+        if (from != entries.data()) {
+            std::copy_n(from, count, entries.data());
+        }
+    }
+
+private:
+    using Histogram = std::array<size_t, 256>;
+
+    template<typename F>
+    void runChunks(ThreadPool* pool, size_t chunkCount, const F& job) {
+        for (size_t c = 1; c < chunkCount; c++) {
+            pending[c] = pool->submit([&job, c] { job(c); });
+        }
+        job(0);
+        for (size_t c = 1; c < chunkCount; c++) {
+            pending[c].get();
+        }
+    }
+
+    size_t chunkSize = 0;
+    std::vector<Histogram> chunks;
+    std::vector<std::future<void>> pending;
+    std::vector<DrawSortEntry> scratch;
+};
+
+// how many binds a frame's recording actually issued, against one of each per draw that needs it
+struct DrawBindStats {
+    uint64_t draws = 0;
+    uint64_t pipelineBinds = 0;
+    uint64_t setBinds = 0;
+    uint64_t setDraws = 0;
+    uint64_t vertexBufferBinds = 0;
+    uint64_t indexBufferBinds = 0;
+    uint64_t indexedDraws = 0;
+
+    uint64_t bindsSaved() const {
+        return (draws - pipelineBinds) + (setDraws - setBinds) + (draws - vertexBufferBinds) + (indexedDraws - indexBufferBinds);
+    }
+
+    DrawBindStats& operator+=(const DrawBindStats& other) {
+        draws += other.draws;
+        pipelineBinds += other.pipelineBinds;
+        setBinds += other.setBinds;
+        setDraws += other.setDraws;
+        vertexBufferBinds += other.vertexBufferBinds;
+        indexBufferBinds += other.indexBufferBinds;
+        indexedDraws += other.indexedDraws;
+        return *this;
+    }
+};
+
+#endif //VULKAN_TUTORIAL_DRAW_SORT_H
@@ -0,0 +1,201 @@
+#ifndef VULKAN_TUTORIAL_FRAME_ARENA_H
+#define VULKAN_TUTORIAL_FRAME_ARENA_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// a bump allocator for memory that only has to live as long as a frame: allocating is a pointer increment and freeing
+// is resetting the whole arena at once. a frame that runs past the end of the block gets extra blocks from the heap,
+// and the next reset swaps all of them for one block big enough for everything, so the frame after it (and every one
+// like it) fits without touching the heap
+class FrameArena {
+public:
+    explicit FrameArena(size_t blockSize = 64 * 1024) : blockSize(blockSize), block(new uint8_t[blockSize]) {}
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t size, size_t alignment) {
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.get());
+        uintptr_t aligned = (base + used + alignment - 1) & ~uintptr_t(alignment - 1);
+        if (aligned + size > base + blockSize) {
+            return allocateOverflow(size, alignment);
+        }
+        used = aligned + size - base;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    // everything allocated since the last reset is gone
+    void reset() {
+        if (!overflow.empty()) {
+            blockSize = std::max(blockSize * 2, used + overflowBytes);
+            block.reset(new uint8_t[blockSize]);
+            overflow.clear();
+            overflowBytes = 0;
+        }
+        used = 0;
+    }
+
+    // bytes handed out since the last reset, counting alignment padding
+    size_t bytesUsed() const {
+        return used + overflowBytes;
+    }
+
+    size_t capacity() const {
+        return blockSize;
+    }
+
+    // how many times the block ran out and the heap had to step in, ever. once this stops going up the arena has
+    // grown to fit the frames it's used for
+    uint64_t overflowCount() const {
+        return overflows;
+    }
+
+private:
+    void* allocateOverflow(size_t size, size_t alignment) {
+        overflows++;
+        overflow.emplace_back(new uint8_t[size + alignment]);
+        overflowBytes += size + alignment;
+        uintptr_t base = reinterpret_cast<uintptr_t>(overflow.back().get());
+        return reinterpret_cast<void*>((base + alignment - 1) & ~uintptr_t(alignment - 1));
+    }
+
+    size_t blockSize;
+    std::unique_ptr<uint8_t[]> block;
+    size_t used = 0;
+    std::vector<std::unique_ptr<uint8_t[]>> overflow;
+    size_t overflowBytes = 0;
+    uint64_t overflows = 0;
+};
+
+// lets standard containers live in a FrameArena. deallocate does nothing, the memory comes back when the arena is reset,
+// so containers that grow a lot waste what they grew out of: reserve() what's known up front
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) {}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return arena == other.arena;
+    }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const {
+        return arena != other.arena;
+    }
+
+private:
+    template<typename U>
+    friend class ArenaAllocator;
+
+    FrameArena* arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// one arena per frame in flight for the render thread, and one per frame in flight for every worker thread that asks.
+// beginFrame() is called once the frame's fence has signalled, and drops everything allocated for that frame the
+// last time round, on every thread. worker jobs may only use the arena of a frame that's still being worked on by the
+// render thread, and have to be done before the render thread moves past it (the frame's jobs all are: it waits for
+// them before submitting)
+class FrameArenas {
+public:
+    FrameArenas(size_t frameCount, size_t blockSize) : blockSize(blockSize), id(nextId++) {
+        for (size_t i = 0; i < frameCount; i++) {
+            arenas.push_back(std::make_unique<FrameArena>(blockSize));
+        }
+    }
+
+    void beginFrame(size_t frame) {
+        current = frame;
+        arenas[frame]->reset();
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& thread : threads) {
+            (*thread)[frame]->reset();
+        }
+    }
+
+    size_t currentFrame() const {
+        return current;
+    }
+
+    // the render thread's arena for the frame being worked on
+    FrameArena& arena() {
+        return *arenas[current];
+    }
+
+    template<typename T>
+    ArenaAllocator<T> allocator() {
+        return ArenaAllocator<T>(arena());
+    }
+
+    // the calling thread's own arena for the given frame, set up the first time the thread asks
+    FrameArena& threadArena(size_t frame) {
+        thread_local uint64_t cachedId = 0;
+        thread_local ThreadArenas* cached = nullptr;
+        if (cachedId != id) {
+            auto created = std::make_unique<ThreadArenas>();
+            for (size_t i = 0; i < arenas.size(); i++) {
+                created->push_back(std::make_unique<FrameArena>(blockSize));
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.push_back(std::move(created));
+            cached = threads.back().get();
+            cachedId = id;
+        }
+        return *(*cached)[frame];
+    }
+
+    // what the render thread used of its arena since the frame began
+    size_t bytesUsed() const {
+        return arenas[current]->bytesUsed();
+    }
+
+    // overflows of all the arenas together, render thread and workers
+    uint64_t overflowCount() {
+        uint64_t count = 0;
+        for (auto& arena : arenas) {
+            count += arena->overflowCount();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& thread : threads) {
+            for (auto& arena : *thread) {
+                count += arena->overflowCount();
+            }
+        }
+        return count;
+    }
+
+private:
+    using ThreadArenas = std::vector<std::unique_ptr<FrameArena>>;
+
+    // ids rather than addresses tell the thread_local caches apart, a new FrameArenas may reuse a dead one's address
+    static inline std::atomic<uint64_t> nextId{1};
+
+    size_t blockSize;
+    uint64_t id;
+    size_t current = 0;
+    std::vector<std::unique_ptr<FrameArena>> arenas;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadArenas>> threads;
+};
+
+#endif //VULKAN_TUTORIAL_FRAME_ARENA_H
@@ -0,0 +1,226 @@
+#ifndef VULKAN_TUTORIAL_FRAME_CAPTURE_H
+#define VULKAN_TUTORIAL_FRAME_CAPTURE_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FRAME_CAPTURE_USE_PWRITE 1
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <mutex>
+#endif
+
+// writers for frames read back from the GPU. everything in here runs on capture worker threads, never on the render
+// thread, and both writers can be called from several threads at once
+
+// the regular zlib/PNG CRC-32. slicing by 4 bytes at a time is a good deal faster than the classic byte loop, which
+// matters when every 4K frame is 33 MB
+inline uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t size) {
+    static const auto tables = [] {
+        std::array<std::array<uint32_t, 256>, 4> t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int slice = 1; slice < 4; slice++) {
+                t[slice][i] = (t[slice - 1][i] >> 8) ^ t[0][t[slice - 1][i] & 0xFF];
+            }
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    while (size >= 4) {
+        crc ^= uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24;
+        crc = tables[3][crc & 0xFF] ^ tables[2][(crc >> 8) & 0xFF] ^ tables[1][(crc >> 16) & 0xFF] ^ tables[0][crc >> 24];
+        data += 4;
+        size -= 4;
+    }
+    while (size-- > 0) {
+        crc = tables[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// writes 8 bit RGBA pixels (or BGRA, which is what most swapchains use) as a PNG. the image data is stored with
+// uncompressed deflate blocks: the files are bigger, but encoding is basically a memcpy plus checksums, which is what
+// lets us keep up with the render loop
+inline void writePng(const std::string& path, uint32_t width, uint32_t height, const uint8_t* pixels, bool bgra) {
+    auto put32 = [](std::vector<uint8_t>& out, uint32_t value) {
+        out.push_back(uint8_t(value >> 24));
+        out.push_back(uint8_t(value >> 16));
+        out.push_back(uint8_t(value >> 8));
+        out.push_back(uint8_t(value));
+    };
+
+    // every scanline starts with its filter type (0, none)
+    size_t rowSize = size_t(width) * 4;
+    size_t rawSize = (rowSize + 1) * height;
+    const size_t MAX_BLOCK = 65535;
+    size_t blockCount = (rawSize + MAX_BLOCK - 1) / MAX_BLOCK;
+
+    std::vector<uint8_t> idat;
+    idat.reserve(4 + 2 + rawSize + blockCount * 5 + 4);
+    put32(idat, 0);  // length, patched below
+    idat.insert(idat.end(), {'I', 'D', 'A', 'T'});
+    // zlib header: deflate, 32K window, no preset dictionary, "fastest" level
+    idat.push_back(0x78);
+    idat.push_back(0x01);
+
+    // the bytes a decoder will see after inflating, produced one scanline at a time
+    std::vector<uint8_t> row(rowSize + 1);
+    size_t rowOffset = row.size();
+    uint32_t rowIndex = 0;
+    uint32_t adlerA = 1, adlerB = 0;
+    auto nextRawBytes = [&](uint8_t* out, size_t count) {
+        while (count > 0) {
+            if (rowOffset == row.size()) {
+                const uint8_t* src = pixels + size_t(rowIndex++) * rowSize;
+                row[0] = 0;
+                if (bgra) {
+                    for (size_t x = 0; x < rowSize; x += 4) {
+                        row[1 + x] = src[x + 2];
+                        row[2 + x] = src[x + 1];
+                        row[3 + x] = src[x];
+                        row[4 + x] = src[x + 3];
+                    }
+                } else {
+                    memcpy(row.data() + 1, src, rowSize);
+                }
+                rowOffset = 0;
+            }
+            size_t n = std::min(count, row.size() - rowOffset);
+            memcpy(out, row.data() + rowOffset, n);
+            // adler32, deferring the modulo as long as the sums can't overflow
+            for (size_t i = 0; i < n; i += 5552) {
+                size_t end = std::min(n, i + 5552);
+                for (size_t j = i; j < end; j++) {
+                    adlerA += out[j];
+                    adlerB += adlerA;
+                }
+                adlerA %= 65521;
+                adlerB %= 65521;
+            }
+            out += n;
+            count -= n;
+            rowOffset += n;
+        }
+    };
+
+    for (size_t remaining = rawSize; remaining > 0;) {
+        size_t blockSize = std::min(remaining, MAX_BLOCK);
+        remaining -= blockSize;
+        idat.push_back(remaining == 0 ? 1 : 0);  // BFINAL, BTYPE = stored
+        idat.push_back(uint8_t(blockSize));
+        idat.push_back(uint8_t(blockSize >> 8));
+        idat.push_back(uint8_t(~blockSize));
+        idat.push_back(uint8_t(~blockSize >> 8));
+        size_t offset = idat.size();
+        idat.resize(offset + blockSize);
+        nextRawBytes(idat.data() + offset, blockSize);
+    }
+    put32(idat, (adlerB << 16) | adlerA);
+
+    uint32_t idatLength = static_cast<uint32_t>(idat.size() - 8);
+    idat[0] = uint8_t(idatLength >> 24);
+    idat[1] = uint8_t(idatLength >> 16);
+    idat[2] = uint8_t(idatLength >> 8);
+    idat[3] = uint8_t(idatLength);
+    put32(idat, crc32Update(0, idat.data() + 4, idat.size() - 4));
+
+    std::vector<uint8_t> header = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    put32(header, 13);
+    size_t ihdrStart = header.size();
+    header.insert(header.end(), {'I', 'H', 'D', 'R'});
+    put32(header, width);
+    put32(header, height);
+    // 8 bits per channel, color type 6 (RGBA), default compression/filter, no interlacing
+    header.insert(header.end(), {8, 6, 0, 0, 0});
+    put32(header, crc32Update(0, header.data() + ihdrStart, header.size() - ihdrStart));
+
+    const uint8_t iend[] = {0, 0, 0, 0, 'I', 'E', 'N', 'D', 0xAE, 0x42, 0x60, 0x82};
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("failed to open " + path + " for writing");
+    }
+    bool ok = fwrite(header.data(), 1, header.size(), file) == header.size()
+            && fwrite(idat.data(), 1, idat.size(), file) == idat.size()
+            && fwrite(iend, 1, sizeof(iend), file) == sizeof(iend);
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        throw std::runtime_error("failed to write " + path);
+    }
+}
+
+// appends fixed size frames to one headerless file (what ffmpeg calls rawvideo). frame N always lands at offset
+// N * frameSize, so workers can finish frames in any order without coordinating with each other
+class RawVideoWriter {
+public:
+    RawVideoWriter(const std::string& path, size_t frameSize) : frameSize(frameSize) {
+#ifdef FRAME_CAPTURE_USE_PWRITE
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("failed to open " + path + " for writing");
+        }
+#else
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open " + path + " for writing");
+        }
+#endif
+    }
+
+    ~RawVideoWriter() {
+#ifdef FRAME_CAPTURE_USE_PWRITE
+        close(fd);
+#endif
+    }
+
+    RawVideoWriter(const RawVideoWriter&) = delete;
+    RawVideoWriter& operator=(const RawVideoWriter&) = delete;
+
+    void writeFrame(uint64_t frameIndex, const uint8_t* pixels) {
+#ifdef FRAME_CAPTURE_USE_PWRITE
+        size_t written = 0;
+        while (written < frameSize) {
+            ssize_t n = pwrite(fd, pixels + written, frameSize - written, static_cast<off_t>(frameIndex * frameSize + written));
+            if (n <= 0) {
+                throw std::runtime_error("failed to write captured frame");
+            }
+            written += static_cast<size_t>(n);
+        }
+#else
+        std::lock_guard<std::mutex> lock(mutex);
+        file.seekp(static_cast<std::streamoff>(frameIndex * frameSize));
+        file.write(reinterpret_cast<const char*>(pixels), static_cast<std::streamsize>(frameSize));
+        if (!file) {
+            throw std::runtime_error("failed to write captured frame");
+        }
+#endif
+    }
+
+private:
+    size_t frameSize;
+#ifdef FRAME_CAPTURE_USE_PWRITE
+    int fd = -1;
+#else
+    std::ofstream file;
+    std::mutex mutex;
+#endif
+};
+
+#endif //VULKAN_TUTORIAL_FRAME_CAPTURE_H
@@ -0,0 +1,933 @@
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "command_stream.h"
+
+// runs a frame recorded with --record-frame without a window: rebuilds its pipelines, buffers and textures, then
+// replays its commands as fast as the GPU takes them, with a timestamp after every command.
+// usage: frame_replay <frame.vkcs> [--iterations n] [--gpu index] [--top n]
+//
+// the per command times are the gaps between consecutive timestamps, i.e. how much later each command finished than
+// the one before it. GPUs overlap neighbouring draws, so they're a guide to where the time goes rather than exact costs,
+// and writing the timestamps can itself slow the frame down a little. the untimed replay at the end has none of them
+
+using Clock = std::chrono::steady_clock;
+
+static void usage() {
+    printf("usage: frame_replay <frame.vkcs> [--iterations n] [--gpu index] [--top n]\n");
+}
+
+static void check(VkResult res, const char* what) {
+    if (res != VK_SUCCESS) {
+        printf("Failed to %s (VkResult: %d)\n", what, res);
+        throw std::runtime_error(std::string("failed to ") + what);
+    }
+}
+
+static bool isBlockCompressed(VkFormat format) {
+    return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+class FrameReplay {
+public:
+    FrameReplay(CommandStream stream, int gpuIndex) : stream(std::move(stream)) {
+        createDevice(gpuIndex);
+        createRenderTargets();
+        createPipelines();
+        uploadResources();
+        createCommandBuffers();
+    }
+
+    ~FrameReplay() {
+        vkDeviceWaitIdle(device);
+        vkDestroyQueryPool(device, queryPool, nullptr);
+        vkDestroyFence(device, fence, nullptr);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        for (VkPipeline pipeline : pipelines) {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        }
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, drawDataSetLayout, nullptr);
+        vkDestroyBuffer(device, drawDataBuffer.buffer, nullptr);
+        vkFreeMemory(device, drawDataBuffer.memory, nullptr);
+        vkDestroySampler(device, sampler, nullptr);
+        for (Image& image : images) {
+            destroyImage(image);
+        }
+        for (Buffer& buffer : buffers) {
+            vkDestroyBuffer(device, buffer.buffer, nullptr);
+            vkFreeMemory(device, buffer.memory, nullptr);
+        }
+        vkDestroyFramebuffer(device, framebuffer, nullptr);
+        destroyImage(colorTarget);
+        destroyImage(depthTarget);
+        destroyImage(resolveTarget);
+        vkDestroyRenderPass(device, renderPass, nullptr);
+        vkDestroyDevice(device, nullptr);
+        vkDestroyInstance(instance, nullptr);
+    }
+
+    const char* deviceName() const {
+        return properties.deviceName;
+    }
+
+    // one run of the timed command buffer, adding how long each command took (in ms) onto commandMs. returns the
+    // whole frame's GPU time
+    double runTimed(std::vector<double>& commandMs) {
+        submitAndWait(timedCommandBuffer);
+        std::vector<uint64_t> timestamps(stream.commands.size() + 1);
+        check(vkGetQueryPoolResults(device, queryPool, 0, static_cast<uint32_t>(timestamps.size()),
+                                    sizeof(uint64_t) * timestamps.size(), timestamps.data(), sizeof(uint64_t),
+                                    VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT), "read the timestamps");
+        // only the low timestampValidBits bits count, and they may wrap between two timestamps
+        uint64_t mask = timestampBits >= 64 ? ~0ull : (1ull << timestampBits) - 1;
+        double msPerTick = double(properties.limits.timestampPeriod) / 1e6;
+        for (size_t i = 0; i < stream.commands.size(); i++) {
+            commandMs[i] += double((timestamps[i + 1] - timestamps[i]) & mask) * msPerTick;
+        }
+        return double((timestamps.back() - timestamps.front()) & mask) * msPerTick;
+    }
+
+    // the same frame without timestamps, submitted back to back. returns wall clock ms per frame
+    double runUntimed(int iterations) {
+        auto start = Clock::now();
+        for (int i = 0; i < iterations; i++) {
+            submitAndWait(untimedCommandBuffer);
+        }
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+    }
+
+private:
+    struct Buffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+    };
+    struct Image {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    };
+
+    CommandStream stream;
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties{};
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue queue = VK_NULL_HANDLE;
+    uint32_t queueFamily = 0;
+    uint32_t timestampBits = 0;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    Image colorTarget;
+    Image depthTarget;
+    Image resolveTarget;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    // set 1. replays push every draw's data, but shader.vert declares the buffer anyway so something has to be bound
+    VkDescriptorSetLayout drawDataSetLayout = VK_NULL_HANDLE;
+    Buffer drawDataBuffer;
+    VkDescriptorSet drawDataSet = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    std::vector<VkPipeline> pipelines;
+    std::vector<Buffer> buffers;
+    std::vector<Image> images;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer timedCommandBuffer = VK_NULL_HANDLE;
+    VkCommandBuffer untimedCommandBuffer = VK_NULL_HANDLE;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+
+    // no surface and no swapchain, so no instance or device extensions either
+    void createDevice(int gpuIndex) {
+        VkApplicationInfo appInfo{};
+        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        appInfo.pApplicationName = "frame_replay";
+        appInfo.apiVersion = VK_API_VERSION_1_1;
+        VkInstanceCreateInfo instanceInfo{};
+        instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        instanceInfo.pApplicationInfo = &appInfo;
+        check(vkCreateInstance(&instanceInfo, nullptr, &instance), "create an instance");
+
+        uint32_t deviceCount = 0;
+        vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+        std::vector<VkPhysicalDevice> devices(deviceCount);
+        vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+        if (gpuIndex >= static_cast<int>(deviceCount)) {
+            throw std::runtime_error("there's no GPU " + std::to_string(gpuIndex));
+        }
+
+        bool needsBc = std::any_of(stream.images.begin(), stream.images.end(),
+                                   [](const StreamImage& image) { return isBlockCompressed(image.format); });
+        for (int i = 0; i < static_cast<int>(deviceCount) && physicalDevice == VK_NULL_HANDLE; i++) {
+            if (gpuIndex >= 0 && i != gpuIndex) {
+                continue;
+            }
+            VkPhysicalDeviceFeatures features;
+            vkGetPhysicalDeviceFeatures(devices[i], &features);
+            if (needsBc && features.textureCompressionBC != VK_TRUE) {
+                continue;
+            }
+            uint32_t familyCount = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &familyCount, nullptr);
+            std::vector<VkQueueFamilyProperties> families(familyCount);
+            vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &familyCount, families.data());
+            for (uint32_t family = 0; family < familyCount; family++) {
+                if ((families[family].queueFlags & VK_QUEUE_GRAPHICS_BIT) && families[family].timestampValidBits > 0) {
+                    physicalDevice = devices[i];
+                    queueFamily = family;
+                    timestampBits = families[family].timestampValidBits;
+                    break;
+                }
+            }
+        }
+        if (physicalDevice == VK_NULL_HANDLE) {
+            throw std::runtime_error(needsBc ? "no GPU with graphics timestamps and BC textures" : "no GPU with graphics timestamps");
+        }
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        float priority = 1.0f;
+        VkDeviceQueueCreateInfo queueInfo{};
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.queueFamilyIndex = queueFamily;
+        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = &priority;
+        VkPhysicalDeviceFeatures enabledFeatures{};
+        enabledFeatures.textureCompressionBC = needsBc ? VK_TRUE : VK_FALSE;
+        VkDeviceCreateInfo deviceInfo{};
+        deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        deviceInfo.queueCreateInfoCount = 1;
+        deviceInfo.pQueueCreateInfos = &queueInfo;
+        deviceInfo.pEnabledFeatures = &enabledFeatures;
+        check(vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device), "create the device");
+        vkGetDeviceQueue(device, queueFamily, 0, &queue);
+    }
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags flags) {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & flags) == flags) {
+                return i;
+            }
+        }
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    VkDeviceMemory allocate(VkMemoryRequirements requirements, VkMemoryPropertyFlags flags) {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = requirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, flags);
+        VkDeviceMemory memory;
+        check(vkAllocateMemory(device, &allocInfo, nullptr, &memory), "allocate memory");
+        return memory;
+    }
+
+    Buffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags flags) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        // zero sized buffers aren't allowed, and an empty draw buffer is perfectly possible
+        bufferInfo.size = std::max<VkDeviceSize>(size, 4);
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        Buffer buffer;
+        check(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer.buffer), "create a buffer");
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(device, buffer.buffer, &requirements);
+        buffer.memory = allocate(requirements, flags);
+        vkBindBufferMemory(device, buffer.buffer, buffer.memory, 0);
+        return buffer;
+    }
+
+    Image createImage(VkFormat format, uint32_t width, uint32_t height, uint32_t levels, VkSampleCountFlagBits sampleCount,
+                      VkImageUsageFlags usage, VkImageAspectFlags aspect) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = {width, height, 1};
+        imageInfo.mipLevels = levels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = sampleCount;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        Image image;
+        check(vkCreateImage(device, &imageInfo, nullptr, &image.image), "create an image");
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(device, image.image, &requirements);
+        image.memory = allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        vkBindImageMemory(device, image.image, image.memory, 0);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange = {aspect, 0, levels, 0, 1};
+        check(vkCreateImageView(device, &viewInfo, nullptr, &image.view), "create an image view");
+        return image;
+    }
+
+    void destroyImage(Image& image) {
+        vkDestroyImageView(device, image.view, nullptr);
+        vkDestroyImage(device, image.image, nullptr);
+        vkFreeMemory(device, image.memory, nullptr);
+    }
+
+    // the same attachments the app renders into, minus the swapchain: with MSAA the color target resolves into a
+    // single sampled image at the end of the pass
+    void createRenderTargets() {
+        samples = static_cast<VkSampleCountFlagBits>(stream.samples);
+        if ((properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts & samples) == 0) {
+            throw std::runtime_error("this GPU can't render with " + std::to_string(stream.samples) + " samples");
+        }
+        if (stream.depthFormat == VK_FORMAT_UNDEFINED) {
+            throw std::runtime_error("the recorded frame has no depth format");
+        }
+        bool msaa = samples != VK_SAMPLE_COUNT_1_BIT;
+
+        std::vector<VkAttachmentDescription> attachments;
+        VkAttachmentDescription color{};
+        color.format = stream.colorFormat;
+        color.samples = samples;
+        color.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        color.storeOp = msaa ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+        color.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        color.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        color.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        color.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachments.push_back(color);
+        VkAttachmentDescription depth = color;
+        depth.format = stream.depthFormat;
+        depth.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depth.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        attachments.push_back(depth);
+        if (msaa) {
+            VkAttachmentDescription resolve = color;
+            resolve.samples = VK_SAMPLE_COUNT_1_BIT;
+            resolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            resolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            attachments.push_back(resolve);
+        }
+
+        VkAttachmentReference colorRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        VkAttachmentReference depthRef{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+        VkAttachmentReference resolveRef{2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorRef;
+        subpass.pDepthStencilAttachment = &depthRef;
+        subpass.pResolveAttachments = msaa ? &resolveRef : nullptr;
+
+        // replays run back to back, so the next one mustn't clear the attachments before the last one is done
+        VkSubpassDependency dependency{};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &dependency;
+        check(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass), "create the render pass");
+
+        colorTarget = createImage(stream.colorFormat, stream.width, stream.height, 1, samples,
+                                  VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+        depthTarget = createImage(stream.depthFormat, stream.width, stream.height, 1, samples,
+                                  VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+        std::vector<VkImageView> views = {colorTarget.view, depthTarget.view};
+        if (msaa) {
+            resolveTarget = createImage(stream.colorFormat, stream.width, stream.height, 1, VK_SAMPLE_COUNT_1_BIT,
+                                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+            views.push_back(resolveTarget.view);
+        }
+
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+        framebufferInfo.pAttachments = views.data();
+        framebufferInfo.width = stream.width;
+        framebufferInfo.height = stream.height;
+        framebufferInfo.layers = 1;
+        check(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer), "create the framebuffer");
+    }
+
+    VkShaderModule createShaderModule(const std::vector<uint8_t>& code) {
+        // the blob's vector storage comes from operator new, which is aligned enough for SPIR-V words
+        VkShaderModuleCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = code.size();
+        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+        VkShaderModule module;
+        check(vkCreateShaderModule(device, &createInfo, nullptr, &module), "create a shader module");
+        return module;
+    }
+
+    void createPipelines() {
+        VkDescriptorSetLayoutBinding textureBinding{};
+        textureBinding.binding = 0;
+        textureBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        textureBinding.descriptorCount = 1;
+        textureBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+        setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        setLayoutInfo.bindingCount = 1;
+        setLayoutInfo.pBindings = &textureBinding;
+        check(vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &setLayout), "create the descriptor set layout");
+
+        VkDescriptorSetLayoutBinding drawDataBinding{};
+        drawDataBinding.binding = 0;
+        drawDataBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        drawDataBinding.descriptorCount = 1;
+        drawDataBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        setLayoutInfo.pBindings = &drawDataBinding;
+        check(vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &drawDataSetLayout), "create the draw data set layout");
+
+        // the range covers everything the frame pushes, the app's own layout may have been bigger but that's compatible
+        uint32_t pushConstantSize = 4;
+        for (const StreamCommand& command : stream.commands) {
+            if (command.op == StreamOp::PushConstants) {
+                pushConstantSize = std::max(pushConstantSize, command.args[0] + command.args[1]);
+            }
+        }
+        if (pushConstantSize > properties.limits.maxPushConstantsSize) {
+            throw std::runtime_error("the frame pushes more constants than this device has room for");
+        }
+        VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_VERTEX_BIT, 0, pushConstantSize};
+
+        std::array<VkDescriptorSetLayout, 2> setLayouts = {setLayout, drawDataSetLayout};
+        VkPipelineLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        layoutInfo.pSetLayouts = setLayouts.data();
+        layoutInfo.pushConstantRangeCount = 1;
+        layoutInfo.pPushConstantRanges = &pushConstantRange;
+        check(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout), "create the pipeline layout");
+
+        for (const StreamPipeline& desc : stream.pipelines) {
+            VkShaderModule vertexShader = createShaderModule(stream.blobs[desc.vertShader]);
+            VkShaderModule fragmentShader = createShaderModule(stream.blobs[desc.fragShader]);
+
+            std::vector<VkSpecializationMapEntry> specializationEntries(desc.specialization.size());
+            for (uint32_t i = 0; i < specializationEntries.size(); i++) {
+                specializationEntries[i] = {i, static_cast<uint32_t>(i * sizeof(uint32_t)), sizeof(uint32_t)};
+            }
+            VkSpecializationInfo specializationInfo{};
+            specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+            specializationInfo.pMapEntries = specializationEntries.data();
+            specializationInfo.dataSize = sizeof(uint32_t) * desc.specialization.size();
+            specializationInfo.pData = desc.specialization.data();
+
+            VkPipelineShaderStageCreateInfo stages[2]{};
+            stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+            stages[0].module = vertexShader;
+            stages[0].pName = "main";
+            stages[0].pSpecializationInfo = &specializationInfo;
+            stages[1] = stages[0];
+            stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+            stages[1].module = fragmentShader;
+
+            VkVertexInputBindingDescription binding{0, desc.vertexStride, VK_VERTEX_INPUT_RATE_VERTEX};
+            std::vector<VkVertexInputAttributeDescription> attributes;
+            for (const StreamVertexAttribute& attribute : desc.attributes) {
+                attributes.push_back({attribute.location, 0, attribute.format, attribute.offset});
+            }
+            VkPipelineVertexInputStateCreateInfo vertexInput{};
+            vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+            vertexInput.vertexBindingDescriptionCount = 1;
+            vertexInput.pVertexBindingDescriptions = &binding;
+            vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+            vertexInput.pVertexAttributeDescriptions = attributes.data();
+
+            VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+            inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+            inputAssembly.topology = desc.topology;
+
+            VkPipelineViewportStateCreateInfo viewportState{};
+            viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+            viewportState.viewportCount = 1;
+            viewportState.scissorCount = 1;
+
+            VkPipelineRasterizationStateCreateInfo rasterizer{};
+            rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+            rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+            rasterizer.lineWidth = 1.0f;
+            rasterizer.cullMode = desc.cullMode;
+            rasterizer.frontFace = desc.frontFace;
+
+            VkPipelineMultisampleStateCreateInfo multisampling{};
+            multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+            multisampling.rasterizationSamples = samples;
+
+            VkPipelineDepthStencilStateCreateInfo depthStencil{};
+            depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+            depthStencil.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+            depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+            depthStencil.depthCompareOp = desc.depthCompareOp;
+
+            VkPipelineColorBlendAttachmentState blendAttachment{};
+            blendAttachment.colorWriteMask = desc.colorWrite ? VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT : 0;
+            blendAttachment.blendEnable = desc.blendEnable ? VK_TRUE : VK_FALSE;
+            blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+            blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+            blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+            VkPipelineColorBlendStateCreateInfo colorBlending{};
+            colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+            colorBlending.attachmentCount = 1;
+            colorBlending.pAttachments = &blendAttachment;
+
+            VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+            VkPipelineDynamicStateCreateInfo dynamicState{};
+            dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+            dynamicState.dynamicStateCount = 2;
+            dynamicState.pDynamicStates = dynamicStates;
+
+            VkGraphicsPipelineCreateInfo pipelineInfo{};
+            pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+            pipelineInfo.stageCount = 2;
+            pipelineInfo.pStages = stages;
+            pipelineInfo.pVertexInputState = &vertexInput;
+            pipelineInfo.pInputAssemblyState = &inputAssembly;
+            pipelineInfo.pViewportState = &viewportState;
+            pipelineInfo.pRasterizationState = &rasterizer;
+            pipelineInfo.pMultisampleState = &multisampling;
+            pipelineInfo.pDepthStencilState = &depthStencil;
+            pipelineInfo.pColorBlendState = &colorBlending;
+            pipelineInfo.pDynamicState = &dynamicState;
+            pipelineInfo.layout = pipelineLayout;
+            pipelineInfo.renderPass = renderPass;
+
+            VkPipeline pipeline;
+            VkResult res = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+            vkDestroyShaderModule(device, vertexShader, nullptr);
+            vkDestroyShaderModule(device, fragmentShader, nullptr);
+            check(res, "create a graphics pipeline");
+            pipelines.push_back(pipeline);
+        }
+    }
+
+    VkCommandBuffer allocateCommandBuffer() {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        check(vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer), "allocate a command buffer");
+        return commandBuffer;
+    }
+
+    void submitAndWait(VkCommandBuffer commandBuffer) {
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        check(vkQueueSubmit(queue, 1, &submitInfo, fence), "submit");
+        vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+        vkResetFences(device, 1, &fence);
+    }
+
+    // every buffer and texture goes through one staging buffer and one submit
+    void uploadResources() {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = queueFamily;
+        check(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool), "create the command pool");
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        check(vkCreateFence(device, &fenceInfo, nullptr, &fence), "create a fence");
+
+        // offsets stay 16 byte aligned, which covers both BC block sizes and every texel size
+        auto align = [](VkDeviceSize offset) { return (offset + 15) & ~VkDeviceSize(15); };
+        VkDeviceSize stagingSize = 0;
+        for (const StreamBuffer& buffer : stream.buffers) {
+            stagingSize = align(stagingSize + stream.blobs[buffer.blob].size());
+        }
+        for (const StreamImage& image : stream.images) {
+            for (uint64_t size : image.levelSizes) {
+                stagingSize = align(stagingSize + size);
+            }
+        }
+        Buffer staging = createBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        uint8_t* mapped = nullptr;
+        if (stagingSize > 0) {
+            check(vkMapMemory(device, staging.memory, 0, stagingSize, 0, reinterpret_cast<void**>(&mapped)), "map the staging buffer");
+        }
+
+        VkCommandBuffer commandBuffer = allocateCommandBuffer();
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        VkDeviceSize offset = 0;
+        for (const StreamBuffer& source : stream.buffers) {
+            const std::vector<uint8_t>& contents = stream.blobs[source.blob];
+            Buffer buffer = createBuffer(contents.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            if (!contents.empty()) {
+                memcpy(mapped + offset, contents.data(), contents.size());
+                VkBufferCopy copy{offset, 0, contents.size()};
+                vkCmdCopyBuffer(commandBuffer, staging.buffer, buffer.buffer, 1, &copy);
+            }
+            buffers.push_back(buffer);
+            offset = align(offset + contents.size());
+        }
+
+        std::vector<VkDescriptorPoolSize> poolSizes = {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, std::max<uint32_t>(1, stream.images.size())},
+                                                       {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1}};
+        VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+        descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolInfo.maxSets = static_cast<uint32_t>(stream.images.size()) + 1;
+        descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        descriptorPoolInfo.pPoolSizes = poolSizes.data();
+        check(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool), "create the descriptor pool");
+
+        // never read (the pipelines were recorded with drawDataInBuffer off), so its contents don't matter
+        drawDataBuffer = createBuffer(256, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VkDescriptorSetAllocateInfo drawDataSetInfo{};
+        drawDataSetInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        drawDataSetInfo.descriptorPool = descriptorPool;
+        drawDataSetInfo.descriptorSetCount = 1;
+        drawDataSetInfo.pSetLayouts = &drawDataSetLayout;
+        check(vkAllocateDescriptorSets(device, &drawDataSetInfo, &drawDataSet), "allocate the draw data descriptor set");
+        VkDescriptorBufferInfo drawDataInfo{drawDataBuffer.buffer, 0, VK_WHOLE_SIZE};
+        VkWriteDescriptorSet drawDataWrite{};
+        drawDataWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        drawDataWrite.dstSet = drawDataSet;
+        drawDataWrite.dstBinding = 0;
+        drawDataWrite.descriptorCount = 1;
+        drawDataWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        drawDataWrite.pBufferInfo = &drawDataInfo;
+        vkUpdateDescriptorSets(device, 1, &drawDataWrite, 0, nullptr);
+
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        check(vkCreateSampler(device, &samplerInfo, nullptr, &sampler), "create the sampler");
+
+        for (const StreamImage& source : stream.images) {
+            // readCommandStream checked the levels against the format and size, what's left is whether this GPU can
+            // have such an image
+            VkFormatProperties formatProperties;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, source.format, &formatProperties);
+            if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+                throw std::runtime_error("this GPU can't sample the recorded frame's texture format " + std::to_string(source.format));
+            }
+            if (std::max(source.width, source.height) > properties.limits.maxImageDimension2D) {
+                throw std::runtime_error("a recorded texture is bigger than this GPU's images can be");
+            }
+            uint32_t levelCount = static_cast<uint32_t>(source.levelSizes.size());
+            Image image = createImage(source.format, source.width, source.height, levelCount, VK_SAMPLE_COUNT_1_BIT,
+                                      VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image.image;
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            const uint8_t* contents = stream.blobs[source.blob].data();
+            std::vector<VkBufferImageCopy> copies;
+            for (uint32_t level = 0; level < levelCount; level++) {
+                memcpy(mapped + offset, contents, source.levelSizes[level]);
+                VkBufferImageCopy copy{};
+                copy.bufferOffset = offset;
+                copy.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+                copy.imageExtent = {std::max(1u, source.width >> level), std::max(1u, source.height >> level), 1};
+                copies.push_back(copy);
+                contents += source.levelSizes[level];
+                offset = align(offset + source.levelSizes[level]);
+            }
+            vkCmdCopyBufferToImage(commandBuffer, staging.buffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   static_cast<uint32_t>(copies.size()), copies.data());
+
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            VkDescriptorSetAllocateInfo setInfo{};
+            setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            setInfo.descriptorPool = descriptorPool;
+            setInfo.descriptorSetCount = 1;
+            setInfo.pSetLayouts = &setLayout;
+            check(vkAllocateDescriptorSets(device, &setInfo, &image.descriptorSet), "allocate a descriptor set");
+            VkDescriptorImageInfo descriptorImage{sampler, image.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = image.descriptorSet;
+            write.dstBinding = 0;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            write.pImageInfo = &descriptorImage;
+            vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+            images.push_back(image);
+        }
+
+        // vertex and index reads wait for the buffer copies
+        VkMemoryBarrier bufferBarrier{};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &bufferBarrier, 0, nullptr, 0, nullptr);
+        vkEndCommandBuffer(commandBuffer);
+        submitAndWait(commandBuffer);
+        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+        vkDestroyBuffer(device, staging.buffer, nullptr);
+        vkFreeMemory(device, staging.memory, nullptr);
+    }
+
+    // the frame is recorded twice up front, so replaying it costs nothing but the submit
+    void createCommandBuffers() {
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = static_cast<uint32_t>(stream.commands.size() + 1);
+        check(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool), "create the query pool");
+
+        timedCommandBuffer = allocateCommandBuffer();
+        untimedCommandBuffer = allocateCommandBuffer();
+        recordFrame(timedCommandBuffer, true);
+        recordFrame(untimedCommandBuffer, false);
+    }
+
+    void recordFrame(VkCommandBuffer commandBuffer, bool timed) {
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        check(vkBeginCommandBuffer(commandBuffer, &beginInfo), "begin a command buffer");
+        if (timed) {
+            vkCmdResetQueryPool(commandBuffer, queryPool, 0, static_cast<uint32_t>(stream.commands.size() + 1));
+        }
+
+        VkClearValue clearValues[3]{};
+        clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+        clearValues[1].depthStencil = {1.0f, 0};
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = framebuffer;
+        renderPassInfo.renderArea.extent = {stream.width, stream.height};
+        renderPassInfo.clearValueCount = 3;
+        renderPassInfo.pClearValues = clearValues;
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &drawDataSet, 0, nullptr);
+        if (timed) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+        }
+
+        for (size_t i = 0; i < stream.commands.size(); i++) {
+            const StreamCommand& command = stream.commands[i];
+            const uint32_t* args = command.args;
+            switch (command.op) {
+                case StreamOp::BindPipeline:
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[args[0]]);
+                    break;
+                case StreamOp::BindVertexBuffer: {
+                    VkDeviceSize offset = args[1] | (VkDeviceSize(args[2]) << 32);
+                    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffers[args[0]].buffer, &offset);
+                    break;
+                }
+                case StreamOp::BindIndexBuffer:
+                    vkCmdBindIndexBuffer(commandBuffer, buffers[args[0]].buffer, args[1] | (VkDeviceSize(args[2]) << 32),
+                                         static_cast<VkIndexType>(args[3]));
+                    break;
+                case StreamOp::BindTexture:
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+                                            &images[args[0]].descriptorSet, 0, nullptr);
+                    break;
+                case StreamOp::SetViewport: {
+                    VkViewport viewport{streamFloat(args[0]), streamFloat(args[1]), streamFloat(args[2]), streamFloat(args[3]),
+                                        streamFloat(args[4]), streamFloat(args[5])};
+                    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+                    break;
+                }
+                case StreamOp::SetScissor: {
+                    VkRect2D scissor{{int32_t(args[0]), int32_t(args[1])}, {args[2], args[3]}};
+                    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+                    break;
+                }
+                case StreamOp::Draw:
+                    vkCmdDraw(commandBuffer, args[0], args[1], args[2], args[3]);
+                    break;
+                case StreamOp::DrawIndexed:
+                    vkCmdDrawIndexed(commandBuffer, args[0], args[1], args[2], int32_t(args[3]), args[4]);
+                    break;
+                case StreamOp::PushConstants:
+                    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, args[0], args[1],
+                                       stream.blobs[args[2]].data());
+                    break;
+                case StreamOp::Count:
+                    break;
+            }
+            if (timed) {
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, static_cast<uint32_t>(i + 1));
+            }
+        }
+
+        vkCmdEndRenderPass(commandBuffer);
+        check(vkEndCommandBuffer(commandBuffer), "record the frame");
+    }
+};
+
+// a short description of what a command does, for the report
+static std::string describeCommand(const StreamCommand& command) {
+    const uint32_t* args = command.args;
+    char text[128];
+    switch (command.op) {
+        case StreamOp::BindPipeline:
+            snprintf(text, sizeof(text), "pipeline %u", args[0]);
+            break;
+        case StreamOp::BindVertexBuffer:
+        case StreamOp::BindIndexBuffer:
+            snprintf(text, sizeof(text), "buffer %u", args[0]);
+            break;
+        case StreamOp::BindTexture:
+            snprintf(text, sizeof(text), "image %u", args[0]);
+            break;
+        case StreamOp::Draw:
+            snprintf(text, sizeof(text), "%u vertices x %u", args[0], args[1]);
+            break;
+        case StreamOp::DrawIndexed:
+            snprintf(text, sizeof(text), "%u indices x %u from %u", args[0], args[1], args[2]);
+            break;
+        case StreamOp::PushConstants:
+            snprintf(text, sizeof(text), "%u bytes at %u", args[1], args[0]);
+            break;
+        default:
+            text[0] = '\0';
+            break;
+    }
+    return text;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    std::string path = argv[1];
+    int iterations = 100;
+    int gpuIndex = -1;
+    size_t top = 15;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return EXIT_FAILURE;
+        }
+        std::string value = argv[++i];
+        if (arg == "--iterations") {
+            iterations = std::max(1, std::stoi(value));
+        } else if (arg == "--gpu") {
+            gpuIndex = std::stoi(value);
+        } else if (arg == "--top") {
+            top = std::stoul(value);
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    try {
+        auto start = Clock::now();
+        CommandStream stream = readCommandStream(path);
+        size_t commandCount = stream.commands.size();
+        std::vector<StreamCommand> commands = stream.commands;
+        printf("%s: %ux%u, %u samples, %zu commands, %zu pipelines, %zu buffers, %zu images\n", path.c_str(), stream.width,
+               stream.height, stream.samples, commandCount, stream.pipelines.size(), stream.buffers.size(), stream.images.size());
+
+        FrameReplay replay(std::move(stream), gpuIndex);
+        printf("replaying on %s (set up in %.1f ms)\n", replay.deviceName(),
+               std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+        // the first runs warm up caches and clocks and aren't counted
+        std::vector<double> commandMs(commandCount, 0.0);
+        for (int i = 0; i < 3; i++) {
+            replay.runTimed(commandMs);
+        }
+        std::fill(commandMs.begin(), commandMs.end(), 0.0);
+        std::vector<double> frameMs;
+        for (int i = 0; i < iterations; i++) {
+            frameMs.push_back(replay.runTimed(commandMs));
+        }
+        std::sort(frameMs.begin(), frameMs.end());
+        for (double& ms : commandMs) {
+            ms /= iterations;
+        }
+        printf("GPU time over %d replays: min %.3f ms, median %.3f ms, max %.3f ms\n", iterations, frameMs.front(),
+               frameMs[frameMs.size() / 2], frameMs.back());
+
+        std::vector<double> opMs(static_cast<size_t>(StreamOp::Count), 0.0);
+        std::vector<uint32_t> opCounts(static_cast<size_t>(StreamOp::Count), 0);
+        for (size_t i = 0; i < commandCount; i++) {
+            opMs[static_cast<size_t>(commands[i].op)] += commandMs[i];
+            opCounts[static_cast<size_t>(commands[i].op)]++;
+        }
+        printf("by command type:\n");
+        for (size_t op = 0; op < opMs.size(); op++) {
+            if (opCounts[op] > 0) {
+                printf(" - %-16s %6u x, %8.3f ms\n", streamOpName(static_cast<StreamOp>(op)), opCounts[op], opMs[op]);
+            }
+        }
+
+        std::vector<size_t> order(commandCount);
+        for (size_t i = 0; i < commandCount; i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return commandMs[a] > commandMs[b]; });
+        order.resize(std::min(top, order.size()));
+        printf("slowest commands:\n");
+        for (size_t i : order) {
+            printf(" - #%-5zu %-16s %8.3f ms  %s\n", i, streamOpName(commands[i].op), commandMs[i], describeCommand(commands[i]).c_str());
+        }
+
+        printf("untimed: %.3f ms per frame, submit to fence\n", replay.runUntimed(iterations));
+    } catch (const std::exception& e) {
+        printf("%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -2,9 +2,9 @@
 #include <GLFW/glfw3.h>
 
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <unordered_set>
 #include <algorithm>
@@ -12,10 +12,36 @@
 #include <stdexcept>
 #include <cstdlib>
 #include <cstdint>
+#include <cmath>
+#include <cstring>
 #include <array>
+#include <string>
+#include <chrono>
+#include <future>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <filesystem>
+#include <random>
+
+#include "thread_pool.h"
+#include "shader_hot_reload.h"
+#include "mapped_file.h"
+#include "frame_capture.h"
+#include "meshlet.h"
+#include "scene.h"
+#include "texture_streaming.h"
+#include "block_compression.h"
+#include "resource_stats.h"
+#include "command_stream.h"
+#include "draw_data.h"
+#include "draw_sort.h"
+#include "frame_arena.h"
+#include "allocation_counter.h"
 
 struct Vertex {
-    glm::vec2 pos;
+    // z is the depth, 0 (nearest) to 1, for the draws that test against the depth buffer
+    glm::vec3 pos;
     glm::vec3 color;
 
     // describes how to traverse multiple vertices
@@ -24,6 +50,7 @@ struct Vertex {
         bindingDescription.binding = 0;
         bindingDescription.stride = sizeof(Vertex);
         bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
     }
 
     // describes the contents of a single vertex
@@ -34,7 +61,7 @@ struct Vertex {
         attributeDescriptions[0].binding = 0;
         // notice this is the same location described in the shader code
         attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
         attributeDescriptions[0].offset = offsetof(Vertex, pos);
 
         // color
@@ -47,13 +74,318 @@ struct Vertex {
     }
 };
 
+// one particle of the compute simulation. the same buffer is the compute shader's storage buffer and the vertex buffer
+// for drawing, so the layout must match particles.comp (std430)
+struct Particle {
+    glm::vec2 position;
+    glm::vec2 velocity;
+    glm::vec4 color;
+
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(Particle);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
+    }
+
+    // only position and color are drawn, and they land on the same locations as Vertex's, so shader.vert works for both
+    // (the missing z of the position reads as 0)
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[0].offset = offsetof(Particle, position);
+
+        // the vertex shader only wants rgb, reading 3 of the 4 floats is fine
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(Particle, color);
+
+        return attributeDescriptions;
+    }
+};
+
+// a position plus the spot on the texture it samples, for the streamed texture grid
+struct TexturedVertex {
+    glm::vec2 pos;
+    glm::vec2 uv;
+
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(TexturedVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[0].offset = offsetof(TexturedVertex, pos);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(TexturedVertex, uv);
+
+        return attributeDescriptions;
+    }
+};
+
+// which of the structs above a pipeline reads its vertices as
+enum class VertexLayout : uint32_t {
+    Vertex,
+    Particle,
+    Textured,
+};
+
+// FNV-1a, so pipeline hashes come out the same between runs (std::hash makes no such promise)
+static uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ULL) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// bits of the featureFlags specialization constant (must match shader.frag)
+enum PipelineFeature : uint32_t {
+    PIPELINE_FEATURE_GRAYSCALE = 1 << 0,
+    PIPELINE_FEATURE_INVERT = 1 << 1,
+};
+
+// values baked into the shaders with specialization constants. the driver sees these as real constants at pipeline
+// compile time, so branches on them are compiled away instead of being evaluated per fragment
+struct ShaderSpecialization {
+    uint32_t featureFlags = 0;  // constant_id = 0
+    float alpha = 1.0f;         // constant_id = 1
+    // the same for every pipeline of a run, so buildPipeline fills it in rather than it being part of the variant
+    VkBool32 drawDataInBuffer = VK_FALSE;  // constant_id = 2
+};
+
+// everything about a graphics pipeline that we might want to vary. it's kept as plain values (no Vulkan handles) so it
+// can be hashed and used as a key into the pipeline library, and so it can be handed to another thread to compile
+struct PipelineStateDesc {
+    std::string vertShader = "shaders/shader.vert.spv";
+    std::string fragShader = "shaders/shader.frag.spv";
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+    bool blendEnable = false;
+    // off for depth only passes
+    bool colorWrite = true;
+    // most things are just drawn in order on top of what's already there, and leave the depth buffer alone
+    bool depthTest = false;
+    bool depthWrite = false;
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+    VertexLayout vertexLayout = VertexLayout::Vertex;
+    ShaderSpecialization specialization{};
+
+    uint64_t hash() const {
+        uint64_t h = hashBytes(vertShader.data(), vertShader.size());
+        h = hashBytes(fragShader.data(), fragShader.size(), h);
+        h = hashBytes(&topology, sizeof(topology), h);
+        h = hashBytes(&cullMode, sizeof(cullMode), h);
+        h = hashBytes(&frontFace, sizeof(frontFace), h);
+        h = hashBytes(&blendEnable, sizeof(blendEnable), h);
+        h = hashBytes(&colorWrite, sizeof(colorWrite), h);
+        h = hashBytes(&depthTest, sizeof(depthTest), h);
+        h = hashBytes(&depthWrite, sizeof(depthWrite), h);
+        h = hashBytes(&depthCompareOp, sizeof(depthCompareOp), h);
+        h = hashBytes(&vertexLayout, sizeof(vertexLayout), h);
+        h = hashBytes(&specialization.featureFlags, sizeof(specialization.featureFlags), h);
+        h = hashBytes(&specialization.alpha, sizeof(specialization.alpha), h);
+        return h;
+    }
+};
+
+// how frames are spread over the GPUs of a device group (several physical devices the driver links together)
+enum class DeviceGroupMode {
+    // just one GPU
+    None,
+    // alternate frame rendering: consecutive frames go to consecutive GPUs
+    Alternate,
+    // split frame rendering: every GPU renders its own slice of each frame
+    Split,
+};
+
+// what captured frames get written as
+enum class CaptureFormat {
+    // one PNG per frame
+    Png,
+    // every frame appended to a single raw BGRA/RGBA file, for piping into a video encoder
+    Raw,
+};
+
+// things that can be changed from the command line
+struct AppOptions {
+    // skip printing every extension and device we enumerate on startup
+    bool quiet = false;
+    // forces a specific GPU, either its index in the device list or part of its name
+    std::optional<std::string> gpu;
+    DeviceGroupMode deviceGroupMode = DeviceGroupMode::None;
+    // when set, every presented frame is read back and written into this directory
+    std::optional<std::string> captureDirectory;
+    CaptureFormat captureFormat = CaptureFormat::Png;
+    // how many particles the compute simulation runs, 0 turns it off
+    uint32_t particleCount = 0;
+    // invocations per compute workgroup (clamped to what the GPU supports)
+    uint32_t particleWorkgroupSize = 256;
+    // cycle through every workgroup size and report the throughput of each on exit
+    bool particleBenchmark = false;
+    // cells per side of the height field the clustered LOD demo builds, 0 turns it off
+    uint32_t lodMeshResolution = 0;
+    // how many triangles of that mesh may be drawn per frame
+    uint64_t triangleBudget = 1000000;
+    // objects in the frustum culled scene, 0 turns it off
+    uint32_t sceneObjectCount = 0;
+    // a directory of images (.ppm or .vtex) to stream
+    std::optional<std::string> textureDirectory;
+    // or just make some up, 0 turns it off
+    uint32_t proceduralTextureCount = 0;
+    // how much GPU memory the streamed mip levels may take up
+    uint64_t textureBudgetMiB = 256;
+    // block compress RGBA8 textures as they load (BC1 or BC7), so they take a quarter or less of the memory. .vtex files
+    // that texture_tool already compressed load as they are
+    std::optional<TextureFormat> compressTextures;
+    // render with VK_KHR_dynamic_rendering instead of a render pass and framebuffers, when the GPU has it
+    bool dynamicRendering = false;
+    // time recording and swapchain dependent setup for whichever of the two paths is in use, and report it
+    bool renderBenchmark = false;
+    // samples per pixel, rounded down to what the GPU can do
+    uint32_t msaaSamples = 1;
+    // lay down the LOD mesh's depth before shading it
+    bool depthPrepass = false;
+    // seconds between device memory and resource count log lines, 0 turns them off (warnings near the budget still
+    // get printed)
+    uint32_t memoryReportSeconds = 5;
+    // record a frame's draws (and everything they use) into this file, for frame_replay. F12 records the next frame
+    std::optional<std::string> recordFile;
+    // the frame that gets recorded without pressing anything
+    uint64_t recordFrame = 100;
+    // give draws their DrawData through the per frame buffer even though it fits in push constants
+    bool drawDataBuffer = false;
+    // run this many frames once warmed up, then fail if the render thread touched the heap during any of them
+    uint64_t checkAllocationFrames = 0;
+};
+
+static AppOptions parseOptions(int argc, char** argv) {
+    AppOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        // options with a value take it from the next argument
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        if (arg == "--quiet" || arg == "-q") {
+            options.quiet = true;
+        } else if (arg == "--gpu") {
+            options.gpu = value();
+        } else if (arg == "--device-group") {
+            std::string mode = value();
+            if (mode == "afr") {
+                options.deviceGroupMode = DeviceGroupMode::Alternate;
+            } else if (mode == "sfr") {
+                options.deviceGroupMode = DeviceGroupMode::Split;
+            } else if (mode == "none") {
+                options.deviceGroupMode = DeviceGroupMode::None;
+            } else {
+                throw std::runtime_error("--device-group must be one of afr, sfr, none");
+            }
+        } else if (arg == "--particles") {
+            options.particleCount = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--workgroup-size") {
+            options.particleWorkgroupSize = static_cast<uint32_t>(std::stoul(value()));
+            if (options.particleWorkgroupSize == 0) {
+                throw std::runtime_error("--workgroup-size must be at least 1");
+            }
+        } else if (arg == "--particle-bench") {
+            options.particleBenchmark = true;
+        } else if (arg == "--lod-mesh") {
+            options.lodMeshResolution = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--triangle-budget") {
+            options.triangleBudget = std::stoull(value());
+        } else if (arg == "--scene-objects") {
+            options.sceneObjectCount = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--textures") {
+            options.textureDirectory = value();
+        } else if (arg == "--procedural-textures") {
+            options.proceduralTextureCount = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--texture-budget") {
+            options.textureBudgetMiB = std::stoull(value());
+        } else if (arg == "--compress-textures") {
+            std::string format = value();
+            if (format == "bc1") {
+                options.compressTextures = TextureFormat::Bc1;
+            } else if (format == "bc7") {
+                options.compressTextures = TextureFormat::Bc7;
+            } else {
+                throw std::runtime_error("--compress-textures must be one of bc1, bc7");
+            }
+        } else if (arg == "--dynamic-rendering") {
+            options.dynamicRendering = true;
+        } else if (arg == "--render-bench") {
+            options.renderBenchmark = true;
+        } else if (arg == "--msaa") {
+            options.msaaSamples = static_cast<uint32_t>(std::stoul(value()));
+            if (options.msaaSamples == 0 || (options.msaaSamples & (options.msaaSamples - 1)) != 0) {
+                throw std::runtime_error("--msaa must be a power of two");
+            }
+        } else if (arg == "--depth-prepass") {
+            options.depthPrepass = true;
+        } else if (arg == "--memory-report") {
+            options.memoryReportSeconds = static_cast<uint32_t>(std::stoul(value()));
+        } else if (arg == "--record-frame") {
+            options.recordFile = value();
+        } else if (arg == "--record-at") {
+            options.recordFrame = std::stoull(value());
+        } else if (arg == "--draw-data-buffer") {
+            options.drawDataBuffer = true;
+        } else if (arg == "--check-allocations") {
+            options.checkAllocationFrames = std::stoull(value());
+        } else if (arg == "--capture") {
+            options.captureDirectory = value();
+        } else if (arg == "--capture-format") {
+            std::string format = value();
+            if (format == "png") {
+                options.captureFormat = CaptureFormat::Png;
+            } else if (format == "raw") {
+                options.captureFormat = CaptureFormat::Raw;
+            } else {
+                throw std::runtime_error("--capture-format must be one of png, raw");
+            }
+        } else {
+            throw std::runtime_error("unknown option: " + arg);
+        }
+    }
+    return options;
+}
+
 class HelloTriangleApplication {
 public:
+    explicit HelloTriangleApplication(AppOptions options) : options(std::move(options)) {}
+
     void run() {
-        initWindow();
+        timePhase("initWindow", [this] { initWindow(); });
         initVulkan();
+        printStartupReport();
         mainLoop();
         cleanup();
+        if (options.checkAllocationFrames > 0) {
+            finishAllocationCheck();
+        }
     }
 
 private:
@@ -64,17 +396,96 @@ private:
         std::vector<VkPresentModeKHR> presentModes;
     };
 
+    using Clock = std::chrono::steady_clock;
+
+    AppOptions options;
+    // everything startup related is measured from when the app object is made
+    Clock::time_point launchTime = Clock::now();
+    // how long each startup phase took, in the order they ran
+    std::vector<std::pair<const char*, double>> startupPhases;
+    bool firstFramePresented = false;
+
     GLFWwindow* window;
     VkInstance instance;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
     VkDevice device;
 
+    // only filled in when --device-group found a group with more than one GPU. physicalDevice is always one of these
+    std::vector<VkPhysicalDevice> deviceGroupDevices;
+    DeviceGroupMode deviceGroupMode = DeviceGroupMode::None;
+    VkDeviceGroupPresentModeFlagBitsKHR deviceGroupPresentMode = VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR;
+    VkDeviceGroupPresentCapabilitiesKHR deviceGroupPresentCapabilities{};
+    // which GPUs the frame currently being recorded runs on
+    uint32_t currentDeviceMask = 1;
+    uint32_t currentDeviceIndex = 0;
+
     VkQueue graphicsQueue;
     VkQueue presentQueue;
 
-    VkRenderPass renderPass;
+    // with dynamic rendering there's no render pass (or framebuffers), the attachments are named when recording
+    bool dynamicRenderingEnabled = false;
+    PFN_vkCmdBeginRenderingKHR cmdBeginRendering = nullptr;
+    PFN_vkCmdEndRenderingKHR cmdEndRendering = nullptr;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    // the multisampled color target (only with MSAA, it resolves into the swapchain image) and the depth buffer. they
+    // only hold anything while a frame renders, so they're transient and, where the GPU has it, lazily allocated: a
+    // tiler keeps them in tile memory and never backs them with real memory at all
+    struct RenderTarget {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        bool lazilyAllocated = false;
+    };
+    VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    RenderTarget msaaColorTarget;
+    RenderTarget depthTarget;
     VkPipelineLayout pipelineLayout;
-    VkPipeline graphicsPipeline;
+    // where each draw's DrawData goes. on the buffer path every frame in flight has its own buffer, bound as set 1
+    DrawDataBinding<DrawData> drawData;
+    VkDescriptorSetLayout drawDataSetLayout;
+    VkDescriptorPool drawDataDescriptorPool = VK_NULL_HANDLE;
+    std::vector<VkBuffer> drawDataBuffers;
+    std::vector<VkDeviceMemory> drawDataBuffersMemory;
+    std::vector<DrawData*> drawDataSlots;
+    std::vector<VkDescriptorSet> drawDataSets;
+    VkPipelineCache pipelineCache;
+    // always-ready pipeline we draw with until the variant we actually want has finished compiling
+    VkPipeline fallbackPipeline;
+    // what a compile hands back: the pipeline and, with --record-frame, the SPIR-V it was built from. recordings copy
+    // that code rather than whatever is on disk by then, which a hot reload may have changed
+    struct BuiltPipeline {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        std::vector<uint8_t> vertCode;
+        std::vector<uint8_t> fragCode;
+    };
+    // the fallback compiles on a worker while the swapchain and friends are created
+    std::future<BuiltPipeline> fallbackPipelineFuture;
+    struct PipelineEntry {
+        PipelineStateDesc desc;
+        // VK_NULL_HANDLE until the first compile finishes (or if it failed)
+        VkPipeline pipeline;
+        // of the compile that made pipeline, see BuiltPipeline
+        std::vector<uint8_t> vertCode;
+        std::vector<uint8_t> fragCode;
+    };
+    struct RetiredPipeline {
+        VkPipeline pipeline;
+        uint64_t retiredFrame;
+    };
+    // every pipeline we've asked for, keyed on PipelineStateDesc::hash()
+    std::unordered_map<uint64_t, PipelineEntry> pipelineLibrary;
+    // compiles that are still running on the worker pool
+    std::unordered_map<uint64_t, std::future<BuiltPipeline>> pendingPipelines;
+    // entries whose running compile is out of date (their shaders changed underneath it)
+    std::unordered_set<uint64_t> stalePipelines;
+    std::vector<RetiredPipeline> retiredPipelines;
+    // hot reload state. the watcher is only created when enableShaderHotReload is set
+    std::unique_ptr<ShaderWatcher> shaderWatcher;
+    std::unordered_map<std::string, std::future<void>> pendingShaderCompiles;
+    std::unordered_set<std::string> staleShaderSources;
+    size_t activePipelineVariant = 0;
+    ThreadPool workerPool;
 
     VkCommandPool commandPool;
     std::vector<VkCommandBuffer> commandBuffers;
@@ -84,20 +495,251 @@ private:
     std::vector<VkFence> inFlightFences;
     std::vector<VkFence> imagesInFlight;
     size_t currentFrame = 0;
+    // total frames started, used to tell when deferred destructions are safe
+    uint64_t frameNumber = 0;
 
     VkSurfaceKHR surface;
     VkSwapchainKHR swapChain;
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> swapChainImageViews;
     std::vector<VkFramebuffer> swapChainFramebuffers;
+    VkSurfaceFormatKHR swapChainSurfaceFormat;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
     VkBuffer vertexBuffer;
     VkDeviceMemory vertexBufferMemory;
 
+    // frame capture. each slot is a host visible buffer big enough for one swapchain image, and goes
+    // Free -> Copying (the GPU is writing it) -> Encoding (a capture worker owns it) -> Free
+    enum class ReadbackState { Free, Copying, Encoding };
+    struct ReadbackSlot {
+        VkBuffer buffer;
+        VkDeviceMemory memory;
+        // persistently mapped
+        const uint8_t* pixels;
+        uint64_t submittedFrame;
+        uint64_t captureIndex;
+        std::atomic<ReadbackState> state{ReadbackState::Free};
+    };
+    bool captureEnabled = false;
+    // slots hold atomics, which can't be moved around, hence the extra indirection
+    std::vector<std::unique_ptr<ReadbackSlot>> readbackSlots;
+    bool readbackMemoryCoherent = true;
+    // the slot the frame being recorded copies into, nullptr if this frame is dropped from the capture
+    ReadbackSlot* currentReadback = nullptr;
+    // encoding gets its own workers so it never queues behind (or delays) pipeline compiles
+    std::unique_ptr<ThreadPool> captureWorkers;
+    std::unique_ptr<RawVideoWriter> rawVideoWriter;
+    uint64_t capturedFrames = 0;
+    uint64_t droppedCaptureFrames = 0;
+
+    // compute particle simulation, only set up when --particles is given
+    struct ParticleParams {
+        float deltaTime;
+        float time;
+        uint32_t particleCount;
+    };
+    bool particlesEnabled = false;
+    uint32_t particleWorkgroupSize = 0;
+    VkBuffer particleBuffer;
+    VkDeviceMemory particleBufferMemory;
+    VkDescriptorSetLayout particleDescriptorSetLayout;
+    VkDescriptorPool particleDescriptorPool;
+    VkDescriptorSet particleDescriptorSet;
+    VkPipelineLayout particlePipelineLayout;
+    VkPipeline particlePipeline;
+    // hot reloaded compute pipeline, and the workgroup size it was built for
+    std::future<VkPipeline> pendingParticlePipeline;
+    uint32_t pendingParticleWorkgroupSize = 0;
+    bool particlePipelineStale = false;
+    float simulationTime = 0.0f;
+    Clock::time_point lastSimulationStep;
+    // two timestamps (before and after the dispatch) per frame in flight. VK_NULL_HANDLE if the queue can't do them
+    VkQueryPool particleQueryPool = VK_NULL_HANDLE;
+    double timestampPeriodNs = 1.0;
+    uint64_t timestampMask = ~0ull;
+    // the workgroup size each frame in flight measured, 0 if it didn't write timestamps
+    std::vector<uint32_t> particleQueryWorkgroupSizes;
+    // GPU time spent simulating since the last report
+    double particleGpuSeconds = 0.0;
+    uint64_t particleSteps = 0;
+    Clock::time_point lastParticleReport;
+    // --particle-bench state: every size gets the same number of frames, results are printed on exit
+    std::vector<uint32_t> benchmarkWorkgroupSizes;
+    size_t benchmarkIndex = 0;
+    uint64_t benchmarkFramesLeft = 0;
+    std::vector<std::pair<uint32_t, double>> benchmarkResults;
+
+    // render path benchmark state, only used with --render-bench
+    uint64_t renderBenchmarkFrame = 0;
+    double renderBenchmarkRecordSeconds = 0.0;
+    Clock::time_point renderBenchmarkStart;
+    // set once the timed frames are done, the rebuild timing and the report wait for the start of the next frame
+    bool renderBenchmarkRebuildPending = false;
+    double renderBenchmarkFrameSeconds = 0.0;
+
+    // clustered LOD demo, only when --lod-mesh is given. the hierarchy is built in the background and uploaded once
+    // it's done, every frame then picks which clusters to draw
+    std::future<LodMesh> lodMeshFuture;
+    LodMesh lodMesh;
+    bool lodMeshReady = false;
+    VkBuffer lodVertexBuffer;
+    VkDeviceMemory lodVertexBufferMemory;
+    VkBuffer lodIndexBuffer;
+    VkDeviceMemory lodIndexBufferMemory;
+    LodSelector lodSelector;
+    LodSelection lodSelection;
+    Clock::time_point lastLodReport;
+
+    // CPU driven scene, only when --scene-objects is given. it's frustum culled every frame and whatever survives is
+    // written as one point per object into this frame's draw buffer, so the GPU only ever sees the visible ones
+    Scene scene;
+    FrustumCuller frustumCuller;
+    std::vector<uint32_t> visibleObjects;
+    std::vector<VkBuffer> sceneDrawBuffers;
+    std::vector<VkDeviceMemory> sceneDrawBuffersMemory;
+    std::vector<Vertex*> sceneDrawVertices;
+    uint32_t sceneDrawCount = 0;
+    // the camera for this frame's scene draw
+    glm::mat4 sceneViewProjection{1.0f};
+    double sceneCullMsTotal = 0.0;
+    uint32_t sceneCullFrames = 0;
+    Clock::time_point lastSceneReport;
+
+    // streamed textures, only when --textures or --procedural-textures is given. images decode on the worker pool,
+    // textureResidency decides which of their mip levels are on the GPU, and a texture's image is rebuilt with the new
+    // range of levels whenever that changes (Vulkan 1.1 without sparse residency can't add or drop levels in place)
+    struct StreamedTexture {
+        std::string name;
+        std::future<TextureSource> pending;
+        // empty until decoded, and forever if that failed
+        std::optional<TextureSource> source;
+        uint32_t residencyId = 0;
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        // the source mip level that is level 0 of image
+        uint32_t baseLevel = 0;
+    };
+    // a texture's new image, filled in by this frame's command buffer before anything samples it
+    struct TextureRebuild {
+        VkImage image;
+        uint32_t levelCount;
+        // levels the old image already has are copied over on the GPU, only new ones come from the staging buffer
+        VkImage oldImage;
+        std::vector<VkImageCopy> copies;
+        VkBuffer stagingBuffer;
+        std::vector<VkBufferImageCopy> uploads;
+    };
+    // images (and staging buffers) the GPU may still be using, destroyed like retired pipelines
+    struct RetiredTextureResources {
+        VkImage image;
+        VkDeviceMemory memory;
+        VkImageView view;
+        VkDescriptorSet descriptorSet;
+        VkBuffer buffer;
+        VkDeviceMemory bufferMemory;
+        uint64_t retiredFrame;
+    };
+    bool texturesEnabled = false;
+    // whether textureCompressionBC got enabled on the device
+    bool bcTexturesSupported = false;
+    std::vector<StreamedTexture> streamedTextures;
+    std::vector<uint32_t> textureOfResidency;
+    TextureResidency textureResidency;
+    std::vector<TextureRebuild> textureRebuilds;
+    std::vector<RetiredTextureResources> retiredTextureResources;
+    // set 0 of the shared pipeline layout
+    VkDescriptorSetLayout textureSetLayout;
+    VkDescriptorPool textureDescriptorPool;
+    VkSampler textureSampler;
+    VkBuffer textureQuadBuffer;
+    VkDeviceMemory textureQuadBufferMemory;
+    uint32_t textureGridStart = 0;
+    uint64_t textureLevelsStreamedIn = 0;
+    uint64_t textureLevelsEvicted = 0;
+    Clock::time_point lastTextureReport;
+
+    // one draw of the main pass. the record functions queue these up, and they're recorded once the frame's draws have
+    // been sorted (see draw_sort.h)
+    struct DrawItem {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        // only for the textured pipeline
+        const StreamedTexture* texture = nullptr;
+        VkBuffer vertexBuffer = VK_NULL_HANDLE;
+        // VK_NULL_HANDLE for a non indexed draw
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+        // vertices or indices
+        uint32_t count = 0;
+        uint32_t first = 0;
+        // pipelines built from shader.vert read this, the textured one doesn't
+        bool usesDrawData = true;
+        DrawData data;
+    };
+
+    // the main pass' draws for the frame being recorded, and the order they get recorded in
+    std::vector<DrawItem> frameDraws;
+    std::vector<DrawSortEntry> drawOrder;
+    DrawSorter drawSorter;
+    DrawKeyIds drawPipelineIds{DrawKey::PIPELINE_BITS};
+    DrawKeyIds drawSetIds{DrawKey::SET_BITS};
+    DrawKeyIds drawBufferIds{DrawKey::BUFFER_BITS};
+    DrawBindStats drawBindStats;
+    double drawSortMsTotal = 0.0;
+    uint32_t drawSortFrames = 0;
+    Clock::time_point lastDrawReport = Clock::now();
+
+    // every buffer, image, pipeline, descriptor set and memory allocation we make, counted as it's created
+    ResourceStats resourceStats;
+    // VK_EXT_memory_budget got enabled, so heap usage and budgets come from the driver
+    bool memoryBudgetEnabled = false;
+    // the budget gets checked every second, the full report only prints every --memory-report seconds
+    Clock::time_point lastBudgetCheck;
+    Clock::time_point lastMemoryLog;
+    // refilled by every check rather than made anew, so checks after the first don't touch the heap
+    MemoryReport memoryReport;
+    // heaps currently over the warning threshold, so each crossing only warns once
+    std::vector<bool> heapsNearBudget;
+
+    // only set while a frame that's being recorded for replay gets its commands recorded (and read back)
+    std::unique_ptr<CommandStreamRecorder> frameRecorder;
+    bool frameRecordRequested = false;
+    // with --record-frame, what buffer contents get read back needs their sizes
+    std::unordered_map<VkBuffer, VkDeviceSize> bufferSizes;
+    // the recorded frame's buffers, by their id in the stream
+    std::vector<VkBuffer> recordedBuffers;
+
     const uint32_t WIDTH = 800;
     const uint32_t HEIGHT = 600;
-    const int MAX_FRAMES_IN_FLIGHT = 2;
+    const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+    // readback buffers on top of the frames in flight, giving the encoders a few frames of slack before we drop any
+    const uint32_t EXTRA_READBACK_SLOTS = 3;
+    const char* PARTICLE_SHADER = "shaders/particles.comp.spv";
+    // frames every workgroup size runs for in the benchmark. the first few are thrown away as warm up
+    const uint64_t BENCHMARK_FRAMES = 240;
+    const uint64_t BENCHMARK_WARMUP_FRAMES = 16;
+    // times the render path benchmark rebuilds the swapchain dependent objects
+    const int RENDER_BENCHMARK_REBUILDS = 32;
+    // levels this size and smaller are loaded together and never evicted, so a texture always has something to show
+    const uint32_t TEXTURE_TAIL_SIZE = 64;
+    // bytes of new mip levels a frame may copy into staging buffers
+    const uint64_t TEXTURE_UPLOAD_BUDGET = 16ull << 20;
+    const uint32_t PROCEDURAL_TEXTURE_SIZE = 1024;
+    // the textures on screen, a grid that moves one row down the list every few seconds
+    const uint32_t TEXTURE_GRID_COLUMNS = 4;
+    const uint32_t TEXTURE_GRID_ROWS = 3;
+    const float TEXTURE_SCROLL_SECONDS = 3.0f;
+    // fraction of a heap's budget past which we start warning
+    const double MEMORY_BUDGET_WARNING = 0.9;
+    // DrawData slots per frame to start with, doubled whenever a frame needs more
+    const uint32_t DRAW_DATA_CAPACITY = 1024;
+    // starting size of each frame arena, they grow to whatever the biggest frame needed
+    const size_t FRAME_ARENA_BLOCK_SIZE = 256 * 1024;
+    // frames --check-allocations lets go by before it starts counting, for the pipelines, meshes and first texture
+    // uploads to settle in
+    const uint64_t ALLOCATION_CHECK_WARMUP_FRAMES = 120;
     // just adding a standard diagnostics layer
     const std::vector<const char*> validationLayers = {
             "VK_LAYER_KHRONOS_validation"
@@ -107,17 +749,97 @@ private:
             VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
     const std::vector<Vertex> vertices = {
-            {{0.0f, -0.5f}, {1.0f, 1.0f, 1.0f}},
-            {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
-            {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}
+            {{0.0f, -0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}},
+            {{0.5f, 0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}},
+            {{-0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}}
     };
+    // the pipeline we can always draw with, built synchronously during startup
+    const PipelineStateDesc fallbackPipelineDesc{};
+    // variants selectable with the number keys. they all get compiled in the background right after startup
+    const std::vector<PipelineStateDesc> pipelineVariants = [] {
+        std::vector<PipelineStateDesc> variants(5);
+        // 1: default
+        // 2: no culling
+        variants[1].cullMode = VK_CULL_MODE_NONE;
+        // 3: grayscale
+        variants[2].specialization.featureFlags = PIPELINE_FEATURE_GRAYSCALE;
+        // 4: inverted colors blended at half opacity
+        variants[3].specialization.featureFlags = PIPELINE_FEATURE_INVERT;
+        variants[3].specialization.alpha = 0.5f;
+        variants[3].blendEnable = true;
+        // 5: just the vertices as points
+        variants[4].topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+        return variants;
+    }();
+    // draws the particle buffer as points
+    const PipelineStateDesc particlePipelineDesc = [] {
+        PipelineStateDesc desc;
+        desc.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+        desc.cullMode = VK_CULL_MODE_NONE;
+        desc.vertexLayout = VertexLayout::Particle;
+        return desc;
+    }();
+    // the culled scene's objects, one point each
+    const PipelineStateDesc scenePointPipelineDesc = [] {
+        PipelineStateDesc desc;
+        desc.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+        desc.cullMode = VK_CULL_MODE_NONE;
+        return desc;
+    }();
+    // the streamed texture grid
+    const PipelineStateDesc texturedPipelineDesc = [] {
+        PipelineStateDesc desc;
+        desc.vertShader = "shaders/textured.vert.spv";
+        desc.fragShader = "shaders/textured.frag.spv";
+        desc.cullMode = VK_CULL_MODE_NONE;
+        desc.vertexLayout = VertexLayout::Textured;
+        return desc;
+    }();
+    // the LOD mesh. vertex clustering can flip the odd triangle, so nothing is culled
+    const PipelineStateDesc lodMeshPipelineDesc = [] {
+        PipelineStateDesc desc;
+        desc.cullMode = VK_CULL_MODE_NONE;
+        desc.depthTest = true;
+        desc.depthWrite = true;
+        return desc;
+    }();
+    // with --depth-prepass the LOD mesh is drawn twice: depth only first, then color only where its depth matched, so
+    // every pixel is shaded once however much the mesh overlaps itself
+    const PipelineStateDesc lodDepthPrepassPipelineDesc = [this] {
+        PipelineStateDesc desc = lodMeshPipelineDesc;
+        desc.colorWrite = false;
+        return desc;
+    }();
+    const PipelineStateDesc lodAfterPrepassPipelineDesc = [this] {
+        PipelineStateDesc desc = lodMeshPipelineDesc;
+        desc.depthWrite = false;
+        desc.depthCompareOp = VK_COMPARE_OP_EQUAL;
+        return desc;
+    }();
     // we only want to enable these on debug builds
     #ifdef NDEBUG
         const bool enableValidationLayers = false;
+        const bool enableShaderHotReload = false;
     #else
         const bool enableValidationLayers = true;
+        const bool enableShaderHotReload = true;
     #endif
 
+    // scratch memory for lists that only live for a frame (barriers, plans, ...), one arena per frame in flight so a
+    // frame's memory stays put until its fence says the GPU is done with it. declared after MAX_FRAMES_IN_FLIGHT,
+    // which it's built from
+    FrameArenas frameArenas{MAX_FRAMES_IN_FLIGHT, FRAME_ARENA_BLOCK_SIZE};
+    // heap allocation counts as of the last report (see allocation_counter.h). a warmed up frame should make none
+    uint64_t renderThreadAllocationsAtReport = 0;
+    uint64_t allAllocationsAtReport = 0;
+    uint64_t framesAtAllocationReport = 0;
+    Clock::time_point lastAllocationReport = Clock::now();
+    // the most any frame since the last report had of its arena, sampled once the frame is done with it
+    size_t frameArenaPeakBytes = 0;
+    // the render thread's count when --check-allocations started counting, and what it had gone up by at the end
+    uint64_t allocationCheckStart = 0;
+    std::optional<uint64_t> checkedAllocations;
+
     void initWindow() {
         // don't forget this! :)
         glfwInit();
@@ -127,22 +849,103 @@ private:
         glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
         window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+
+        // GLFW callbacks are plain function pointers, so we stash `this` in the window to get back to the app
+        glfwSetWindowUserPointer(window, this);
+        glfwSetKeyCallback(window, keyCallback);
+    }
+
+    static void keyCallback(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        if (action != GLFW_PRESS) {
+            return;
+        }
+        // number keys pick a pipeline variant
+        if (key >= GLFW_KEY_1 && key < GLFW_KEY_1 + static_cast<int>(app->pipelineVariants.size())) {
+            app->activePipelineVariant = key - GLFW_KEY_1;
+        }
+        if (key == GLFW_KEY_F12 && app->options.recordFile) {
+            app->frameRecordRequested = true;
+        }
     }
 
     void initVulkan() {
-        createInstance();
-        createSurface();
-        pickPhysicalDevice();
-        createLogicalDevice();
-        createSwapChain();
-        createSwapChainImageViews();
-        createRenderPass();
-        createGraphicsPipeline();
-        createFramebuffers();
-        createCommandPool();
-        createVertexBuffer();
-        createCommandBuffers();
-        createSyncObjects();
+        timePhase("createInstance", [this] { createInstance(); });
+        timePhase("createSurface", [this] { createSurface(); });
+        timePhase("pickPhysicalDevice", [this] { pickPhysicalDevice(); });
+        timePhase("selectDeviceGroup", [this] { selectDeviceGroup(); });
+        timePhase("createLogicalDevice", [this] { createLogicalDevice(); });
+        timePhase("configureDeviceGroupPresent", [this] { configureDeviceGroupPresent(); });
+        // the render pass (and so the pipeline) only needs the image format, not the swapchain itself. picking it up
+        // front lets the fallback pipeline compile on a worker while we do everything else on this thread
+        timePhase("chooseSurfaceFormat", [this] { chooseSurfaceFormat(); });
+        timePhase("chooseRenderTargetFormats", [this] { chooseRenderTargetFormats(); });
+        timePhase("createRenderPass", [this] { createRenderPass(); });
+        timePhase("createGraphicsPipeline", [this] { createGraphicsPipeline(); });
+        timePhase("createSwapChain", [this] { createSwapChain(); });
+        timePhase("createSwapChainImageViews", [this] { createSwapChainImageViews(); });
+        timePhase("createRenderTargets", [this] { createRenderTargets(); });
+        timePhase("createFramebuffers", [this] { createFramebuffers(); });
+        timePhase("createCommandPool", [this] { createCommandPool(); });
+        timePhase("createVertexBuffer", [this] { createVertexBuffer(); });
+        timePhase("createDrawDataBuffers", [this] { createDrawDataBuffers(); });
+        timePhase("createParticleSystem", [this] { createParticleSystem(); });
+        timePhase("createScene", [this] { createScene(); });
+        timePhase("createTextureStreaming", [this] { createTextureStreaming(); });
+        timePhase("createCommandBuffers", [this] { createCommandBuffers(); });
+        timePhase("createSyncObjects", [this] { createSyncObjects(); });
+        timePhase("createCaptureResources", [this] { createCaptureResources(); });
+        // ideally the fallback finished a while ago and this is free
+        timePhase("waitForFallbackPipeline", [this] { finishGraphicsPipeline(); });
+    }
+
+    template<typename F>
+    void timePhase(const char* name, F&& phase) {
+        auto start = Clock::now();
+        phase();
+        startupPhases.emplace_back(name, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+
+    void printStartupReport() {
+        double total = 0.0;
+        printf("Startup breakdown:\n");
+        for (const auto& phase : startupPhases) {
+            printf(" - %-28s %8.2f ms\n", phase.first, phase.second);
+            total += phase.second;
+        }
+        printf(" = %-28s %8.2f ms\n", "total", total);
+    }
+
+    // things the first frame doesn't need get created once it's on screen, so they don't delay it
+    void onFirstFramePresented() {
+        firstFramePresented = true;
+        double timeToFirstFrame = std::chrono::duration<double, std::milli>(Clock::now() - launchTime).count();
+        printf("Time to first frame: %.2f ms\n", timeToFirstFrame);
+
+        for (const auto& variant : pipelineVariants) {
+            requestPipeline(variant);
+        }
+        if (particlesEnabled) {
+            requestPipeline(particlePipelineDesc);
+        }
+        if (options.sceneObjectCount > 0) {
+            requestPipeline(scenePointPipelineDesc);
+        }
+        if (texturesEnabled) {
+            requestPipeline(texturedPipelineDesc);
+            startTextureLoads();
+        }
+        if (options.lodMeshResolution > 0) {
+            requestPipeline(lodMeshPipelineDesc);
+            if (options.depthPrepass) {
+                requestPipeline(lodDepthPrepassPipelineDesc);
+                requestPipeline(lodAfterPrepassPipelineDesc);
+            }
+            startLodMeshBuild();
+        }
+        if (enableShaderHotReload) {
+            shaderWatcher = std::make_unique<ShaderWatcher>("shaders");
+        }
     }
 
     void createInstance() {
@@ -169,21 +972,25 @@ private:
         uint32_t glfwExtensionCount = 0;
         const char** glfwExtensions;
         glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-        printf("GLFW Required Vulkan Instance Extensions:\n");
-        for (int i = 0; i < glfwExtensionCount; i++) {
-            printf(" - %s\n", glfwExtensions[i]);
-        }
         createInfo.enabledExtensionCount = glfwExtensionCount;
         createInfo.ppEnabledExtensionNames = glfwExtensions;
 
-        // checking for available Vk extensions
-        uint32_t vkExtensionCount = 0;
-        vkEnumerateInstanceExtensionProperties(nullptr, &vkExtensionCount, nullptr);
-        std::vector<VkExtensionProperties> vkExtensions(vkExtensionCount);
-        vkEnumerateInstanceExtensionProperties(nullptr, &vkExtensionCount, vkExtensions.data());
-        printf("Available Vulkan Instance Extensions:\n");
-        for (const auto& extension : vkExtensions) {
-            printf(" - %s\n", extension.extensionName);
+        // the rest is purely informational, and enumerating every extension isn't free, so quiet mode skips it
+        if (!options.quiet) {
+            printf("GLFW Required Vulkan Instance Extensions:\n");
+            for (uint32_t i = 0; i < glfwExtensionCount; i++) {
+                printf(" - %s\n", glfwExtensions[i]);
+            }
+
+            // checking for available Vk extensions
+            uint32_t vkExtensionCount = 0;
+            vkEnumerateInstanceExtensionProperties(nullptr, &vkExtensionCount, nullptr);
+            std::vector<VkExtensionProperties> vkExtensions(vkExtensionCount);
+            vkEnumerateInstanceExtensionProperties(nullptr, &vkExtensionCount, vkExtensions.data());
+            printf("Available Vulkan Instance Extensions:\n");
+            for (const auto& extension : vkExtensions) {
+                printf(" - %s\n", extension.extensionName);
+            }
         }
 
         // set validation layers if wanted
@@ -234,41 +1041,259 @@ private:
         std::vector<VkPhysicalDevice> devices(deviceCount);
         vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
-        printf("Available Physical Devices:\n");
-        // pick first suitable device
-        for (const auto& device : devices) {
+        // pick the best scoring device, unless the user asked for a specific one
+        std::vector<uint64_t> scores(devices.size());
+        size_t best = 0;
+        for (size_t i = 0; i < devices.size(); i++) {
+            scores[i] = rateDevice(devices[i]);
+            if (scores[i] > scores[best]) {
+                best = i;
+            }
+        }
+
+        if (options.gpu) {
+            size_t requested = findRequestedDevice(devices, *options.gpu);
+            if (scores[requested] == 0) {
+                throw std::runtime_error("the GPU picked with --gpu isn't suitable for this application!");
+            }
+            best = requested;
+        }
+        if (scores[best] == 0) {
+            throw std::runtime_error("found supported devices but none are suitable for application!");
+        }
+        physicalDevice = devices[best];
+
+        if (!options.quiet) {
+            printf("Available Physical Devices:\n");
+            for (size_t i = 0; i < devices.size(); i++) {
+                VkPhysicalDeviceProperties deviceProperties;
+                vkGetPhysicalDeviceProperties(devices[i], &deviceProperties);
+                printf(" - [%zu] %s (%s, %llu MiB device local) score %016llx%s\n", i, deviceProperties.deviceName,
+                       deviceTypeName(deviceProperties.deviceType),
+                       (unsigned long long) (deviceLocalMemorySize(devices[i]) >> 20),
+                       (unsigned long long) scores[i], i == best ? " <=" : "");
+            }
+        }
+    }
+
+    // --gpu takes the device's index in the list above, or failing that a part of its name that only one device has
+    static size_t findRequestedDevice(const std::vector<VkPhysicalDevice>& devices, const std::string& gpu) {
+        if (!gpu.empty() && gpu.find_first_not_of("0123456789") == std::string::npos) {
+            size_t index = std::stoull(gpu);
+            if (index < devices.size()) {
+                return index;
+            }
+        }
+
+        std::vector<size_t> matches;
+        std::string names;
+        for (size_t i = 0; i < devices.size(); i++) {
             VkPhysicalDeviceProperties deviceProperties;
-            vkGetPhysicalDeviceProperties(device, &deviceProperties);
-            printf(" - %s", deviceProperties.deviceName);
-            switch (deviceProperties.deviceType) {
-                case VK_PHYSICAL_DEVICE_TYPE_OTHER:
-                    printf(" (Other)");
-                    break;
-                case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
-                    printf(" (Integrated GPU)");
-                    break;
-                case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
-                    printf(" (Discrete GPU)");
-                    break;
-                case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
-                    printf(" (Virtual GPU)");
-                    break;
-                case VK_PHYSICAL_DEVICE_TYPE_CPU:
-                    printf(" (CPU)");
-                    break;
-                case VK_PHYSICAL_DEVICE_TYPE_MAX_ENUM:
-                    printf(" (Max?)");
-                    break;
+            vkGetPhysicalDeviceProperties(devices[i], &deviceProperties);
+            if (strstr(deviceProperties.deviceName, gpu.c_str()) != nullptr) {
+                matches.push_back(i);
+                names += std::string(names.empty() ? "" : ", ") + deviceProperties.deviceName;
+            }
+        }
+        if (matches.empty()) {
+            throw std::runtime_error("no GPU matches --gpu " + gpu);
+        }
+        if (matches.size() > 1) {
+            throw std::runtime_error("--gpu " + gpu + " matches more than one GPU (" + names + "), pass its index instead");
+        }
+        return matches[0];
+    }
+
+    // 0 means the device can't run this app at all, otherwise higher is better. the score is packed so the device
+    // type always wins, then the amount of VRAM, then how nice its queues are:
+    //   bits 40-47: device type, bits 8-39: device local memory in MiB, bits 0-7: queue capabilities
+    uint64_t rateDevice(VkPhysicalDevice device) {
+        if (!isDeviceSuitable(device)) {
+            return 0;
+        }
+
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+        uint64_t typeScore;
+        switch (deviceProperties.deviceType) {
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+                typeScore = 5;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+                typeScore = 4;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+                typeScore = 3;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_CPU:
+                typeScore = 2;
+                break;
+            default:
+                typeScore = 1;
+                break;
+        }
+
+        uint64_t memoryScore = std::min<uint64_t>(deviceLocalMemorySize(device) >> 20, 0xFFFFFFFFull);
+
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+        uint64_t queueScore = 0;
+        for (const auto& queueFamily : queueFamilies) {
+            // async compute and a dedicated copy engine let work overlap with rendering
+            if ((queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+                queueScore |= 1 << 3;
             }
-            if (isDeviceSuitable(device) && physicalDevice == VK_NULL_HANDLE) {
-                physicalDevice = device;
-                printf(" <=");
+            if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                queueScore |= 1 << 2;
             }
-            printf("\n");
+            // we need timestamps for any kind of GPU profiling
+            if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && queueFamily.timestampValidBits > 0) {
+                queueScore |= 1 << 0;
+            }
+        }
+        // graphics and present on one family means no ownership juggling for the swapchain images
+        QueueFamilyIndices indices = findQueueFamilies(device);
+        if (indices.graphicsFamily == indices.presentFamily) {
+            queueScore |= 1 << 1;
         }
 
-        if (physicalDevice == VK_NULL_HANDLE) {
-            throw std::runtime_error("found supported devices but none are suitable for application!");
+        return (typeScore << 40) | (memoryScore << 8) | queueScore;
+    }
+
+    uint64_t deviceLocalMemorySize(VkPhysicalDevice device) {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(device, &memProperties);
+        uint64_t size = 0;
+        for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+            if (memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                size += memProperties.memoryHeaps[i].size;
+            }
+        }
+        return size;
+    }
+
+    // looks for a device group (GPUs linked by the driver, like SLI/CrossFire setups) containing the GPU we picked.
+    // the logical device is then created over the whole group and frames are spread over it
+    void selectDeviceGroup() {
+        if (options.deviceGroupMode == DeviceGroupMode::None) {
+            return;
+        }
+
+        uint32_t groupCount = 0;
+        vkEnumeratePhysicalDeviceGroups(instance, &groupCount, nullptr);
+        VkPhysicalDeviceGroupProperties emptyGroup{};
+        emptyGroup.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GROUP_PROPERTIES;
+        std::vector<VkPhysicalDeviceGroupProperties> groups(groupCount, emptyGroup);
+        vkEnumeratePhysicalDeviceGroups(instance, &groupCount, groups.data());
+
+        for (const auto& group : groups) {
+            auto begin = group.physicalDevices;
+            auto end = group.physicalDevices + group.physicalDeviceCount;
+            if (group.physicalDeviceCount > 1 && std::find(begin, end, physicalDevice) != end) {
+                deviceGroupDevices.assign(begin, end);
+                deviceGroupMode = options.deviceGroupMode;
+                break;
+            }
+        }
+
+        if (deviceGroupDevices.empty()) {
+            printf("No device group with more than one GPU contains the selected device, rendering on one GPU\n");
+        } else if (!options.quiet) {
+            printf("Using a device group of %zu GPUs\n", deviceGroupDevices.size());
+        }
+    }
+
+    // figures out how the presentation engine can show images rendered across the group. this can only be asked once
+    // the logical device exists. if the mode we want isn't supported we stay on the group but render on GPU 0 only
+    void configureDeviceGroupPresent() {
+        if (deviceGroupDevices.empty()) {
+            return;
+        }
+        deviceGroupPresentCapabilities.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_PRESENT_CAPABILITIES_KHR;
+        vkGetDeviceGroupPresentCapabilitiesKHR(device, &deviceGroupPresentCapabilities);
+        VkDeviceGroupPresentModeFlagsKHR modes = deviceGroupPresentCapabilities.modes;
+
+        bool everyDevicePresentsLocally = true;
+        for (uint32_t i = 0; i < deviceGroupDevices.size(); i++) {
+            if (!(deviceGroupPresentCapabilities.presentMask[i] & (1u << i))) {
+                everyDevicePresentsLocally = false;
+            }
+        }
+
+        if (deviceGroupMode == DeviceGroupMode::Alternate) {
+            // each GPU presents the frames it rendered itself, or hands them to one that can present
+            if ((modes & VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR) && everyDevicePresentsLocally) {
+                deviceGroupPresentMode = VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR;
+                return;
+            }
+            if (modes & VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR) {
+                deviceGroupPresentMode = VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR;
+                return;
+            }
+        } else if (deviceGroupMode == DeviceGroupMode::Split) {
+            // every GPU's slice ends up in the same presented image
+            if (modes & VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_MULTI_DEVICE_BIT_KHR) {
+                deviceGroupPresentMode = VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_MULTI_DEVICE_BIT_KHR;
+                return;
+            }
+            if (modes & VK_DEVICE_GROUP_PRESENT_MODE_SUM_BIT_KHR) {
+                deviceGroupPresentMode = VK_DEVICE_GROUP_PRESENT_MODE_SUM_BIT_KHR;
+                return;
+            }
+        }
+        printf("The device group can't present in the requested mode, rendering on one GPU\n");
+        deviceGroupMode = DeviceGroupMode::None;
+        deviceGroupPresentMode = VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR;
+    }
+
+    // decides which GPUs render the next frame
+    void selectFrameDevices() {
+        uint32_t deviceCount = static_cast<uint32_t>(deviceGroupDevices.size());
+        switch (deviceGroupMode) {
+            case DeviceGroupMode::Alternate:
+                currentDeviceIndex = static_cast<uint32_t>(frameNumber % deviceCount);
+                currentDeviceMask = 1u << currentDeviceIndex;
+                break;
+            case DeviceGroupMode::Split:
+                currentDeviceIndex = 0;
+                currentDeviceMask = (1u << deviceCount) - 1;
+                break;
+            case DeviceGroupMode::None:
+                currentDeviceIndex = 0;
+                currentDeviceMask = 1;
+                break;
+        }
+    }
+
+    // which GPU(s) the presentation engine takes this frame's image from
+    uint32_t presentDeviceMask() {
+        if (deviceGroupPresentMode == VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR) {
+            // any GPU whose presentation engine can reach the one that rendered the frame
+            for (uint32_t i = 0; i < deviceGroupDevices.size(); i++) {
+                if (deviceGroupPresentCapabilities.presentMask[i] & currentDeviceMask) {
+                    return 1u << i;
+                }
+            }
+        }
+        return currentDeviceMask;
+    }
+
+    static const char* deviceTypeName(VkPhysicalDeviceType type) {
+        switch (type) {
+            case VK_PHYSICAL_DEVICE_TYPE_OTHER:
+                return "Other";
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+                return "Integrated GPU";
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+                return "Discrete GPU";
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+                return "Virtual GPU";
+            case VK_PHYSICAL_DEVICE_TYPE_CPU:
+                return "CPU";
+            default:
+                return "Max?";
         }
     }
 
@@ -297,12 +1322,16 @@ private:
     }
 
     bool checkDeviceExtensionSupport(const VkPhysicalDevice& device) {
+        return hasDeviceExtensions(device, deviceExtensions);
+    }
+
+    static bool hasDeviceExtensions(VkPhysicalDevice device, const std::vector<const char*>& extensions) {
         uint32_t extensionCount = 0;
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
         std::vector<VkExtensionProperties> availableExtensions(extensionCount);
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-        std::unordered_set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        std::unordered_set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
         for (const auto& extension : availableExtensions) {
             requiredExtensions.erase(extension.extensionName);
@@ -372,8 +1401,12 @@ private:
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
-        // for now, we are leaving this VK_FALSE since we don't need any special features
+        // the only optional feature we use: BC1/BC7 textures, which desktop GPUs all have and mobile ones mostly don't
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
         VkPhysicalDeviceFeatures deviceFeatures{};
+        deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+        bcTexturesSupported = supportedFeatures.textureCompressionBC == VK_TRUE;
         // same pattern as instance creation
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -382,9 +1415,53 @@ private:
 
         createInfo.pEnabledFeatures = &deviceFeatures;
 
-        // make sure we have needed extensions (for now just swapchain)
-        createInfo.enabledExtensionCount = deviceExtensions.size();
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        // spans the logical device over every GPU in the group. all the per GPU decisions are made with device masks
+        // when recording, submitting and presenting
+        VkDeviceGroupDeviceCreateInfo deviceGroupInfo{};
+        if (!deviceGroupDevices.empty()) {
+            deviceGroupInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_DEVICE_CREATE_INFO;
+            deviceGroupInfo.physicalDeviceCount = static_cast<uint32_t>(deviceGroupDevices.size());
+            deviceGroupInfo.pPhysicalDevices = deviceGroupDevices.data();
+            createInfo.pNext = &deviceGroupInfo;
+        }
+
+        // dynamic rendering is an extension on 1.1, and it needs two more to go with it
+        std::vector<const char*> enabledExtensions = deviceExtensions;
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+        dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+        if (options.dynamicRendering) {
+            const std::vector<const char*> dynamicRenderingExtensions = {
+                    VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+                    VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+                    VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME
+            };
+            VkPhysicalDeviceFeatures2 features2{};
+            features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features2.pNext = &dynamicRenderingFeatures;
+            if (hasDeviceExtensions(physicalDevice, dynamicRenderingExtensions)) {
+                vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+            }
+            if (dynamicRenderingFeatures.dynamicRendering == VK_TRUE) {
+                enabledExtensions.insert(enabledExtensions.end(), dynamicRenderingExtensions.begin(), dynamicRenderingExtensions.end());
+                dynamicRenderingFeatures.pNext = const_cast<void*>(createInfo.pNext);
+                createInfo.pNext = &dynamicRenderingFeatures;
+                dynamicRenderingEnabled = true;
+            } else {
+                printf("This GPU doesn't support dynamic rendering, using a render pass\n");
+            }
+        }
+
+        // lets us ask how much of each heap is actually ours to use, rather than just how big it is
+        if (hasDeviceExtensions(physicalDevice, {VK_EXT_MEMORY_BUDGET_EXTENSION_NAME})) {
+            enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            memoryBudgetEnabled = true;
+        } else if (!options.quiet) {
+            printf("VK_EXT_memory_budget isn't supported, memory reports only count our own allocations\n");
+        }
+
+        // make sure we have needed extensions
+        createInfo.enabledExtensionCount = enabledExtensions.size();
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         // newer vulkan impls ignore this and use instance layers but older ones might want this
         if (enableValidationLayers){
@@ -403,6 +1480,15 @@ private:
         // gets a handle to the actual queues where we can submit commands (we have 1 queue only so we can just use ix 0)
         vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
         vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+
+        // the loader only exports core functions, extension ones have to be looked up on the device
+        if (dynamicRenderingEnabled) {
+            cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
+            cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
+            if (cmdBeginRendering == nullptr || cmdEndRendering == nullptr) {
+                throw std::runtime_error("failed to load the dynamic rendering functions");
+            }
+        }
     }
 
     void createSurface() {
@@ -447,7 +1533,7 @@ private:
         return availableFormats[0];
     }
 
-    VkPresentModeKHR chooseSwapChainPresentMode(const std::vector<VkPresentModeKHR>& availableFormats) {
+    VkPresentModeKHR chooseSwapChainPresentMode(const std::vector<VkPresentModeKHR>& /*availableModes*/) {
         // https://vulkan-tutorial.com/Drawing_a_triangle/Presentation/Swap_chain#page_Choosing-the-right-settings-for-the-swap-chain
         // this mode is guaranteed to be available so let's just use this
         return VK_PRESENT_MODE_FIFO_KHR;
@@ -473,10 +1559,16 @@ private:
         }
     }
 
+    void chooseSurfaceFormat() {
+        swapChainSurfaceFormat = chooseSwapChainSurfaceFormat(querySwapChainSupport(physicalDevice).formats);
+        swapChainImageFormat = swapChainSurfaceFormat.format;
+    }
+
     void createSwapChain() {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
-        VkSurfaceFormatKHR surfaceFormat = chooseSwapChainSurfaceFormat(swapChainSupport.formats);
+        // picked by chooseSurfaceFormat() already, the render pass was made with it
+        VkSurfaceFormatKHR surfaceFormat = swapChainSurfaceFormat;
         VkPresentModeKHR presentMode = chooseSwapChainPresentMode(swapChainSupport.presentModes);
         VkExtent2D extent = chooseSwapChainExtent(swapChainSupport.capabilities);
 
@@ -499,6 +1591,20 @@ private:
         createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
         // we would use VK_IMAGE_USAGE_TRANSFER_DST_BIT instead if we wanted to do stuff like post-processing
 
+        // capturing copies straight out of the swapchain images, which they have to allow
+        if (options.captureDirectory) {
+            bool byteFormat = surfaceFormat.format == VK_FORMAT_B8G8R8A8_SRGB || surfaceFormat.format == VK_FORMAT_B8G8R8A8_UNORM
+                    || surfaceFormat.format == VK_FORMAT_R8G8B8A8_SRGB || surfaceFormat.format == VK_FORMAT_R8G8B8A8_UNORM;
+            if (!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+                printf("The swapchain images can't be copied from, capture is disabled\n");
+            } else if (!byteFormat) {
+                printf("Capture only supports 8 bit RGBA/BGRA swapchains (got format %d), capture is disabled\n", surfaceFormat.format);
+            } else {
+                createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+                captureEnabled = true;
+            }
+        }
+
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
         uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
 
@@ -527,6 +1633,14 @@ private:
         // necessary when recreating swapchains on stuff like window resize
         createInfo.oldSwapchain = VK_NULL_HANDLE;
 
+        // with a device group the swapchain has to know how the GPUs will present into it
+        VkDeviceGroupSwapchainCreateInfoKHR deviceGroupInfo{};
+        if (!deviceGroupDevices.empty()) {
+            deviceGroupInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_SWAPCHAIN_CREATE_INFO_KHR;
+            deviceGroupInfo.modes = deviceGroupPresentMode;
+            createInfo.pNext = &deviceGroupInfo;
+        }
+
         VkResult res;
         if ((res = vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain)) != VK_SUCCESS) {
             printf("Failed to create swapchain (VkResult: %d)\n", res);
@@ -537,8 +1651,7 @@ private:
         swapChainImages.resize(imageCount);
         vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
 
-        // save these for rendering
-        swapChainImageFormat = surfaceFormat.format;
+        // save this for rendering
         swapChainExtent = extent;
     }
 
@@ -573,17 +1686,127 @@ private:
         }
     }
 
+    // the sample count and depth format have to be known before any pipeline is built, the images themselves wait
+    // for the swapchain's extent
+    void chooseRenderTargetFormats() {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        VkSampleCountFlags supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+        uint32_t samples = options.msaaSamples;
+        while (samples > 1 && (supported & samples) == 0) {
+            samples >>= 1;
+        }
+        if (samples != options.msaaSamples) {
+            printf("%ux MSAA isn't supported, using %ux\n", options.msaaSamples, samples);
+        }
+        msaaSamples = static_cast<VkSampleCountFlagBits>(samples);
+
+        // D32 is exact and everywhere on desktop, the other two are the fallbacks the spec guarantees one of
+        for (VkFormat format : {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D16_UNORM}) {
+            VkFormatProperties formatProperties;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+            if (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+                depthFormat = format;
+                break;
+            }
+        }
+        if (depthFormat == VK_FORMAT_UNDEFINED) {
+            throw std::runtime_error("no supported depth format");
+        }
+    }
+
+    void createRenderTargets() {
+        if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+            msaaColorTarget = createRenderTarget(swapChainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+        }
+        depthTarget = createRenderTarget(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+        if (!options.quiet && !firstFramePresented) {
+            printf("Render targets: %ux MSAA, depth format %d, %s\n", uint32_t(msaaSamples), depthFormat,
+                   depthTarget.lazilyAllocated ? "lazily allocated" : "in device local memory");
+        }
+    }
+
+    // an attachment that's only ever written and read within a render pass, at the swapchain's size
+    RenderTarget createRenderTarget(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = {swapChainExtent.width, swapChainExtent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = msaaSamples;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        RenderTarget target;
+        VkResult res;
+        if ((res = createImage(&imageInfo, &target.image)) != VK_SUCCESS) {
+            printf("Failed to create a render target (VkResult: %d)\n", res);
+            throw std::runtime_error("failed to create render target image");
+        }
+
+        // desktop GPUs have no lazily allocated memory, there it's just device local
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, target.image, &memRequirements);
+        std::optional<uint32_t> memoryType = tryFindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+        target.lazilyAllocated = memoryType.has_value();
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = memoryType ? *memoryType : findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if ((res = allocateMemory(&allocInfo, &target.memory)) != VK_SUCCESS) {
+            printf("Failed to allocate render target memory (VkResult: %d)\n", res);
+            throw std::runtime_error("failed to allocate render target memory");
+        }
+        vkBindImageMemory(device, target.image, target.memory, 0);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = target.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange = {aspect, 0, 1, 0, 1};
+        if ((res = vkCreateImageView(device, &viewInfo, nullptr, &target.view)) != VK_SUCCESS) {
+            printf("Failed to create a render target view (VkResult: %d)\n", res);
+            throw std::runtime_error("failed to create render target view");
+        }
+        return target;
+    }
+
+    void destroyRenderTargets() {
+        if (msaaColorTarget.image != VK_NULL_HANDLE) {
+            destroyRenderTarget(msaaColorTarget);
+        }
+        destroyRenderTarget(depthTarget);
+    }
+
+    void destroyRenderTarget(RenderTarget& target) {
+        vkDestroyImageView(device, target.view, nullptr);
+        destroyImage(target.image);
+        freeMemory(target.memory);
+        target = RenderTarget{};
+    }
+
     void createRenderPass() {
-        // this is the output attachment that gets shown
+        // dynamic rendering describes the attachments when it starts rendering, pipelines just need their formats
+        if (dynamicRenderingEnabled) {
+            return;
+        }
+        bool multisampled = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+
+        // this is the output attachment that gets shown. with MSAA it's the multisampled target instead, which only
+        // exists for the pass: nothing is stored, the resolve at the end of the subpass is all that's kept
         VkAttachmentDescription colorAttachment{};
         colorAttachment.format = swapChainImageFormat;
-        // no MSAA so we just do one sample
-        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachment.samples = msaaSamples;
 
         // clears framebuffer when it's loaded for use in the render pass
         colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
         // we want to store stuff into the framebuffer
-        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
 
         // currently, don't care about these
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
@@ -591,37 +1814,78 @@ private:
 
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
         // make sure the image is in presentable form
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorAttachment.finalLayout = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+        // depth is cleared at the start and thrown away at the end, which is what lets it stay in tile memory
+        VkAttachmentDescription depthAttachment{};
+        depthAttachment.format = depthFormat;
+        depthAttachment.samples = msaaSamples;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        // the swapchain image the samples get averaged into
+        VkAttachmentDescription resolveAttachment = colorAttachment;
+        resolveAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        resolveAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        resolveAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        resolveAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         // now create a reference to this attachment that supports how we write to it from out frag shader
         VkAttachmentReference colorAttachmentRef{};
         colorAttachmentRef.attachment = 0;
         colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        VkAttachmentReference depthAttachmentRef{};
+        depthAttachmentRef.attachment = 1;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        VkAttachmentReference resolveAttachmentRef{};
+        resolveAttachmentRef.attachment = 2;
+        resolveAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
         // we need to reference a color attachment of this render pass
         VkSubpassDescription subpass{};
         subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
         subpass.colorAttachmentCount = 1;
         subpass.pColorAttachments = &colorAttachmentRef;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+        if (multisampled) {
+            subpass.pResolveAttachments = &resolveAttachmentRef;
+        }
 
         // finally, we define the render pass that has the color attachments and subpasses (one of each for now)
+        std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, resolveAttachment};
         VkRenderPassCreateInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        renderPassInfo.attachmentCount = 1;
-        renderPassInfo.pAttachments = &colorAttachment;
+        renderPassInfo.attachmentCount = multisampled ? 3 : 2;
+        renderPassInfo.pAttachments = attachments.data();
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
 
-        VkSubpassDependency dependency{};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.dstSubpass = 0;
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.srcAccessMask = 0;
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
+        // the depth and MSAA images are shared by every frame in flight, so on top of waiting for the swapchain image
+        // this frame's writes to them wait for the previous frame's
+        std::array<VkSubpassDependency, 2> dependencies{};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        // the capture copies the image right after the pass. without this the implicit dependency out of the pass only
+        // waits at bottom of pipe, so nothing would order the transition to PRESENT_SRC (and the resolve) before the copy.
+        // the swapchain doesn't exist yet to say whether capture will really work, so this goes by the option alone
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        renderPassInfo.dependencyCount = options.captureDirectory ? 2 : 1;
+        renderPassInfo.pDependencies = dependencies.data();
 
         if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
             throw std::runtime_error("failed to create render pass!");
@@ -630,11 +1894,137 @@ private:
     }
 
     void createGraphicsPipeline() {
-        auto vertexShaderCode = readFile("shaders/shader.vert.spv");
-        auto fragmentShaderCode = readFile("shaders/shader.frag.spv");
+        // set 0 is a texture. only the textured pipelines read it, but keeping it in the one shared layout means any
+        // pipeline can be bound without disturbing what's already bound
+        VkDescriptorSetLayoutBinding textureBinding{};
+        textureBinding.binding = 0;
+        textureBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        textureBinding.descriptorCount = 1;
+        textureBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        VkDescriptorSetLayoutCreateInfo textureLayoutInfo{};
+        textureLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        textureLayoutInfo.bindingCount = 1;
+        textureLayoutInfo.pBindings = &textureBinding;
+        if (vkCreateDescriptorSetLayout(device, &textureLayoutInfo, nullptr, &textureSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture descriptor set layout!");
+        }
 
-        VkShaderModule vertexShaderModule = createShaderModule(vertexShaderCode);
-        VkShaderModule fragmentShaderModule = createShaderModule(fragmentShaderCode);
+        // set 1 is this frame's DrawData buffer, for when draws can't (or were told not to) use push constants
+        VkDescriptorSetLayoutBinding drawDataBinding{};
+        drawDataBinding.binding = 0;
+        drawDataBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        drawDataBinding.descriptorCount = 1;
+        drawDataBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+        VkDescriptorSetLayoutCreateInfo drawDataLayoutInfo{};
+        drawDataLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        drawDataLayoutInfo.bindingCount = 1;
+        drawDataLayoutInfo.pBindings = &drawDataBinding;
+        if (vkCreateDescriptorSetLayout(device, &drawDataLayoutInfo, nullptr, &drawDataSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create draw data descriptor set layout!");
+        }
+
+        // every GPU has at least 128 bytes of push constants, most have 256. DrawData goes in them when it fits
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        drawData.init(properties.limits.maxPushConstantsSize, options.drawDataBuffer, DRAW_DATA_CAPACITY);
+        if (!options.quiet) {
+            printf("Draw data: %zu bytes per draw, through %s (%u bytes of push constants)\n", sizeof(DrawData),
+                   drawData.path() == DrawDataPath::PushConstants ? "push constants" : "a per frame buffer",
+                   properties.limits.maxPushConstantsSize);
+        }
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = std::min<uint32_t>(sizeof(DrawData), properties.limits.maxPushConstantsSize);
+
+        std::array<VkDescriptorSetLayout, 2> setLayouts = {textureSetLayout, drawDataSetLayout};
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        // every variant shares this layout, which is what lets us switch between them without rebinding anything else
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+
+        // lets the driver reuse compiled shader code between variants (they mostly only differ in fixed function
+        // state). the cache is internally synchronized so all the worker threads can share it
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+
+        // we need at least one pipeline before we can draw anything. it starts compiling (shader loading included)
+        // on a worker right away and finishGraphicsPipeline() picks it up once the rest of startup is done. the other
+        // variants aren't needed for the first frame, so they are only requested after it (onFirstFramePresented)
+        fallbackPipelineFuture = workerPool.submit([this] { return buildPipeline(fallbackPipelineDesc); });
+    }
+
+    void finishGraphicsPipeline() {
+        BuiltPipeline built = fallbackPipelineFuture.get();
+        fallbackPipeline = built.pipeline;
+        pipelineLibrary[fallbackPipelineDesc.hash()] = PipelineEntry{fallbackPipelineDesc, built.pipeline, std::move(built.vertCode),
+                                                                     std::move(built.fragCode)};
+    }
+
+    static void getVertexInput(VertexLayout layout, VkVertexInputBindingDescription& binding,
+                               std::array<VkVertexInputAttributeDescription, 2>& attributes) {
+        switch (layout) {
+            case VertexLayout::Vertex:
+                binding = Vertex::getBindingDescription();
+                attributes = Vertex::getAttributeDescriptions();
+                break;
+            case VertexLayout::Particle:
+                binding = Particle::getBindingDescription();
+                attributes = Particle::getAttributeDescriptions();
+                break;
+            case VertexLayout::Textured:
+                binding = TexturedVertex::getBindingDescription();
+                attributes = TexturedVertex::getAttributeDescriptions();
+                break;
+        }
+    }
+
+    // builds one pipeline from its description. this gets called from worker threads, so it must only read state
+    // that doesn't change after startup (device, render pass, layout, cache)
+    BuiltPipeline buildPipeline(const PipelineStateDesc& desc) {
+        BuiltPipeline built;
+        // the driver copies the code while creating the module, so the mappings only need to live until then (unless
+        // frames get recorded, which need their own copy)
+        MappedFile vertShader(desc.vertShader);
+        MappedFile fragShader(desc.fragShader);
+        if (options.recordFile) {
+            built.vertCode.assign(vertShader.view().data, vertShader.view().data + vertShader.view().size);
+            built.fragCode.assign(fragShader.view().data, fragShader.view().data + fragShader.view().size);
+        }
+        VkShaderModule vertexShaderModule = createShaderModule(vertShader.view());
+        VkShaderModule fragmentShaderModule = createShaderModule(fragShader.view());
+
+        // maps the fields of ShaderSpecialization onto the constant_ids used in the shaders
+        std::array<VkSpecializationMapEntry, 3> specializationEntries{};
+        specializationEntries[0].constantID = 0;
+        specializationEntries[0].offset = offsetof(ShaderSpecialization, featureFlags);
+        specializationEntries[0].size = sizeof(ShaderSpecialization::featureFlags);
+        specializationEntries[1].constantID = 1;
+        specializationEntries[1].offset = offsetof(ShaderSpecialization, alpha);
+        specializationEntries[1].size = sizeof(ShaderSpecialization::alpha);
+        specializationEntries[2].constantID = 2;
+        specializationEntries[2].offset = offsetof(ShaderSpecialization, drawDataInBuffer);
+        specializationEntries[2].size = sizeof(ShaderSpecialization::drawDataInBuffer);
+        ShaderSpecialization specialization = desc.specialization;
+        specialization.drawDataInBuffer = drawData.path() == DrawDataPath::Buffer ? VK_TRUE : VK_FALSE;
+
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+        specializationInfo.pMapEntries = specializationEntries.data();
+        specializationInfo.dataSize = sizeof(ShaderSpecialization);
+        specializationInfo.pData = &specialization;
 
         VkPipelineShaderStageCreateInfo vertShaderStageCreateInfo{};
         vertShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -644,12 +2034,15 @@ private:
         // this is the entry point of this shader (means we can use the same shader module for multiple stages with
         // different entry points)
         vertShaderStageCreateInfo.pName = "main";
+        // constant ids that a stage doesn't declare are simply ignored, so both stages can share the same info
+        vertShaderStageCreateInfo.pSpecializationInfo = &specializationInfo;
 
         VkPipelineShaderStageCreateInfo fragShaderStageCreateInfo{};
         fragShaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         fragShaderStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         fragShaderStageCreateInfo.module = fragmentShaderModule;
         fragShaderStageCreateInfo.pName = "main";
+        fragShaderStageCreateInfo.pSpecializationInfo = &specializationInfo;
 
         // an array of shader stages we can use later
         VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageCreateInfo, fragShaderStageCreateInfo};
@@ -660,8 +2053,9 @@ private:
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
         // settings these to 0 since we hardcoded the vertices
-        auto bindingDescription = Vertex::getBindingDescription();
-        auto attributeDescriptions = Vertex::getAttributeDescriptions();
+        VkVertexInputBindingDescription bindingDescription{};
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+        getVertexInput(desc.vertexLayout, bindingDescription, attributeDescriptions);
         // just one buffer binding (vertex data)
         vertexInputInfo.vertexBindingDescriptionCount = 1;
         // each vertex has two attributes
@@ -669,34 +2063,19 @@ private:
         vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
         vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
-        // describing how geometry should be assembled. we are doing triangle list since that's common but for stuff
-        // like an n-body simulation we could do points
+        // describing how geometry should be assembled. we are doing triangle list since that's common but the
+        // particle simulation draws points
         VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
         inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        inputAssembly.topology = desc.topology;
         inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-        // we are drawing to the entire framebuffer so that's why we set it to the whole width/height
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float) swapChainExtent.width;
-        viewport.height = (float) swapChainExtent.height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-
-        // we want to draw to the entire framebuffer, so we use its extents (if we wanted to have some UI at the bottom
-        // we could scissor those out and save efficiency
-        VkRect2D scissor{};
-        scissor.offset = {0, 0};
-        scissor.extent = swapChainExtent;
-
+        // viewport and scissor are dynamic state (set while recording), so the pipeline doesn't depend on the
+        // swapchain extent and variants don't need rebuilding when it changes. we only need to give the counts here
         VkPipelineViewportStateCreateInfo viewportState{};
         viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         viewportState.viewportCount = 1;
-        viewportState.pViewports = &viewport;
         viewportState.scissorCount = 1;
-        viewportState.pScissors = &scissor;
 
         VkPipelineRasterizationStateCreateInfo rasterizer{};
         rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -708,22 +2087,35 @@ private:
         // thickness of lines for line mode
         rasterizer.lineWidth = 1.0f;
         // you recognize these!
-        rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+        rasterizer.cullMode = desc.cullMode;
+        rasterizer.frontFace = desc.frontFace;
         rasterizer.depthBiasEnable = VK_FALSE;
 
         // will revisit this, but for now we won't have any anti-aliasing
         VkPipelineMultisampleStateCreateInfo multisampling{};
         multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
         multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-        // no depth and stencil testing for now
-
-        // we just want to overwrite any color there from a previous fragment
+        multisampling.rasterizationSamples = msaaSamples;
+
+        // there's always a depth buffer, only some pipelines use it
+        VkPipelineDepthStencilStateCreateInfo depthStencil{};
+        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depthStencil.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+        depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+        depthStencil.depthCompareOp = desc.depthCompareOp;
+        depthStencil.depthBoundsTestEnable = VK_FALSE;
+        depthStencil.stencilTestEnable = VK_FALSE;
+
+        // either overwrite any color there from a previous fragment, or do regular alpha blending
         VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        colorBlendAttachment.blendEnable = VK_FALSE;
+        colorBlendAttachment.colorWriteMask = desc.colorWrite ? VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT : 0;
+        colorBlendAttachment.blendEnable = desc.blendEnable ? VK_TRUE : VK_FALSE;
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
         VkPipelineColorBlendStateCreateInfo colorBlending{};
         colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -734,28 +2126,16 @@ private:
         // listing stuff we can change dynamically rather than reconstructing the entire pipeline
         VkDynamicState dynamicStates[] = {
                 VK_DYNAMIC_STATE_VIEWPORT,
+                VK_DYNAMIC_STATE_SCISSOR,
                 VK_DYNAMIC_STATE_LINE_WIDTH
         };
 
         VkPipelineDynamicStateCreateInfo dynamicState{};
         dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        dynamicState.dynamicStateCount = 2;
+        dynamicState.dynamicStateCount = 3;
         dynamicState.pDynamicStates = dynamicStates;
 
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 0; // Optional
-        pipelineLayoutInfo.pSetLayouts = nullptr; // Optional
-        pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-        pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-
-        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create pipeline layout!");
-        }
-
         VkGraphicsPipelineCreateInfo pipelineInfo{};
-        VkComputePipelineCreateInfo something{};
-        something.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
         pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
         // counting programmable stages we are using
         pipelineInfo.stageCount = 2;
@@ -767,26 +2147,212 @@ private:
         pipelineInfo.pRasterizationState = &rasterizer;
         pipelineInfo.pColorBlendState = &colorBlending;
         pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pDepthStencilState = &depthStencil;
+        pipelineInfo.pDynamicState = &dynamicState;
         pipelineInfo.layout = pipelineLayout;
         // we define this pipeline to be the first of one subpass of the entire render pass
         pipelineInfo.renderPass = renderPass;
         pipelineInfo.subpass = 0;
-
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create graphics pipeline!");
+        // or, without a render pass, what it'll be rendering into
+        VkPipelineRenderingCreateInfoKHR renderingInfo{};
+        if (dynamicRenderingEnabled) {
+            renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+            renderingInfo.colorAttachmentCount = 1;
+            renderingInfo.pColorAttachmentFormats = &swapChainImageFormat;
+            renderingInfo.depthAttachmentFormat = depthFormat;
+            pipelineInfo.pNext = &renderingInfo;
         }
 
+        VkPipeline pipeline;
+        VkResult res = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+
         // we destroy these at the end of the function since they're not what's executed, just what is used to make
         // the machine code that actually will be executed
         vkDestroyShaderModule(device, vertexShaderModule, nullptr);
         vkDestroyShaderModule(device, fragmentShaderModule, nullptr);
+
+        if (res != VK_SUCCESS) {
+            printf("Failed to create graphics pipeline (VkResult: %d)\n", res);
+            throw std::runtime_error("failed to create graphics pipeline!");
+        }
+        resourceStats.created(ResourceKind::Pipeline);
+        built.pipeline = pipeline;
+        return built;
+    }
+
+    // makes sure this variant exists in the library, kicking off a background compile if it's new
+    void requestPipeline(const PipelineStateDesc& desc) {
+        uint64_t key = desc.hash();
+        if (pipelineLibrary.count(key) != 0) {
+            return;
+        }
+        pipelineLibrary[key] = PipelineEntry{desc, VK_NULL_HANDLE, {}, {}};
+        rebuildPipeline(key);
+    }
+
+    // (re)compiles a library entry on the worker pool. if a compile for it is already running it may have read the
+    // old shaders, so we just remember to go again once it finishes
+    void rebuildPipeline(uint64_t key) {
+        if (pendingPipelines.count(key) != 0) {
+            stalePipelines.insert(key);
+            return;
+        }
+        PipelineStateDesc desc = pipelineLibrary[key].desc;
+        pendingPipelines[key] = workerPool.submit([this, desc] { return buildPipeline(desc); });
+    }
+
+    // never blocks: if the variant isn't ready yet we queue it up and hand back the fallback in the meantime
+    VkPipeline getPipeline(const PipelineStateDesc& desc) {
+        VkPipeline pipeline = findReadyPipeline(desc);
+        return pipeline != VK_NULL_HANDLE ? pipeline : fallbackPipeline;
+    }
+
+    // like getPipeline, but VK_NULL_HANDLE instead of the fallback. for pipelines the fallback can't stand in for
+    // (different vertex layout, for one)
+    VkPipeline findReadyPipeline(const PipelineStateDesc& desc) {
+        auto it = pipelineLibrary.find(desc.hash());
+        if (it == pipelineLibrary.end()) {
+            requestPipeline(desc);
+            return VK_NULL_HANDLE;
+        }
+        return it->second.pipeline;
+    }
+
+    // moves finished background compiles into the library. this runs once per frame on the main thread, which is the
+    // only thread that ever touches pipelineLibrary, so no locking is needed
+    void pollPipelineCompiles() {
+        ArenaVector<uint64_t> rebuilds(frameArenas.allocator<uint64_t>());
+        for (auto it = pendingPipelines.begin(); it != pendingPipelines.end();) {
+            if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                it++;
+                continue;
+            }
+            uint64_t key = it->first;
+            PipelineEntry& entry = pipelineLibrary[key];
+            try {
+                BuiltPipeline built = it->second.get();
+                // a previous version of this pipeline may still be used by frames in flight
+                if (entry.pipeline != VK_NULL_HANDLE) {
+                    retirePipeline(entry.pipeline);
+                }
+                entry.pipeline = built.pipeline;
+                entry.vertCode = std::move(built.vertCode);
+                entry.fragCode = std::move(built.fragCode);
+                if (key == fallbackPipelineDesc.hash()) {
+                    fallbackPipeline = built.pipeline;
+                }
+            } catch (const std::exception& e) {
+                // we keep whatever we had before, so a typo while editing a shader doesn't take the pipeline away
+                printf("Failed to compile pipeline variant %016llx: %s\n", (unsigned long long) key, e.what());
+            }
+            it = pendingPipelines.erase(it);
+            if (stalePipelines.erase(key) != 0) {
+                rebuilds.push_back(key);
+            }
+        }
+        for (uint64_t key : rebuilds) {
+            rebuildPipeline(key);
+        }
+    }
+
+    // picks up edited shader sources, recompiles them in the background and then rebuilds every pipeline that uses
+    // them. the new pipelines get swapped in by pollPipelineCompiles() at the start of a frame
+    void pollShaderReloads() {
+        if (!shaderWatcher) {
+            return;
+        }
+        for (const auto& source : shaderWatcher->takeChanged()) {
+            if (pendingShaderCompiles.count(source) != 0) {
+                staleShaderSources.insert(source);
+                continue;
+            }
+            printf("Recompiling %s\n", source.c_str());
+            pendingShaderCompiles[source] = workerPool.submit([source] { compileShaderSource(source); });
+        }
+
+        std::vector<std::string> recompiles;
+        for (auto it = pendingShaderCompiles.begin(); it != pendingShaderCompiles.end();) {
+            if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                it++;
+                continue;
+            }
+            std::string source = it->first;
+            try {
+                it->second.get();
+                std::string spirvPath = spirvPathFor(source);
+                for (const auto& entry : pipelineLibrary) {
+                    if (entry.second.desc.vertShader == spirvPath || entry.second.desc.fragShader == spirvPath) {
+                        rebuildPipeline(entry.first);
+                    }
+                }
+                if (particlesEnabled && spirvPath == PARTICLE_SHADER) {
+                    rebuildParticlePipeline();
+                }
+            } catch (const std::exception& e) {
+                printf("Failed to compile %s:\n%s\n", source.c_str(), e.what());
+            }
+            it = pendingShaderCompiles.erase(it);
+            if (staleShaderSources.erase(source) != 0) {
+                recompiles.push_back(source);
+            }
+        }
+        for (const auto& source : recompiles) {
+            pendingShaderCompiles[source] = workerPool.submit([source] { compileShaderSource(source); });
+        }
+    }
+
+    // pipelines can't be destroyed while a command buffer that uses them is still executing, so replaced ones wait
+    // here until every frame that might have used them has retired
+    void retirePipeline(VkPipeline pipeline) {
+        retiredPipelines.push_back({pipeline, frameNumber});
+    }
+
+    void destroyRetiredPipelines(bool all = false) {
+        for (auto it = retiredPipelines.begin(); it != retiredPipelines.end();) {
+            if (all || frameNumber >= it->retiredFrame + MAX_FRAMES_IN_FLIGHT) {
+                destroyPipeline(it->pipeline);
+                it = retiredPipelines.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+
+    void destroyPipelineLibrary() {
+        // stop reacting to shader edits, then let any compiles that are still running finish since we can't destroy
+        // the device out from under them
+        shaderWatcher.reset();
+        for (auto& pending : pendingShaderCompiles) {
+            pending.second.wait();
+        }
+        pendingShaderCompiles.clear();
+        for (auto& pending : pendingPipelines) {
+            try {
+                VkPipeline pipeline = pending.second.get().pipeline;
+                retirePipeline(pipeline);
+            } catch (const std::exception&) {
+            }
+        }
+        pendingPipelines.clear();
+        for (const auto& entry : pipelineLibrary) {
+            if (entry.second.pipeline != VK_NULL_HANDLE) {
+                destroyPipeline(entry.second.pipeline);
+            }
+        }
+        pipelineLibrary.clear();
+        destroyRetiredPipelines(true);
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
     }
 
-    VkShaderModule createShaderModule(const std::vector<char>& code) {
+    VkShaderModule createShaderModule(ByteView code) {
+        // pCode is read as uint32_t words, so the bytes have to be aligned like them (mapped files always are)
+        if (!code.isAlignedFor<uint32_t>()) {
+            throw std::runtime_error("SPIR-V code must be 4 byte aligned and a whole number of words");
+        }
         VkShaderModuleCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+        createInfo.codeSize = code.size;
+        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data);
         VkShaderModule shaderModule;
         VkResult res;
         if ((res = vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule)) != VK_SUCCESS) {
@@ -796,35 +2362,28 @@ private:
         return shaderModule;
     }
 
-    static std::vector<char> readFile(const std::string& filename) {
-        std::ifstream file(filename, std::ios::ate | std::ios::binary);
-        if (!file.is_open()) {
-            throw std::runtime_error("failed to open file!");
-        }
-        size_t fileSize = file.tellg();
-        std::vector<char> buffer(fileSize);
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-        file.close();
-
-        return buffer;
-    }
-
     void createFramebuffers() {
+        if (dynamicRenderingEnabled) {
+            return;
+        }
         // we need one framebuffer from each image/imageview in our swapchain
         swapChainFramebuffers.resize(swapChainImageViews.size());
 
         for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-            VkImageView attachments[] = {
-                    swapChainImageViews[i]
-            };
+            // in the order of the render pass' attachments: with MSAA the swapchain image is only the resolve target
+            std::vector<VkImageView> attachments;
+            if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+                attachments = {msaaColorTarget.view, depthTarget.view, swapChainImageViews[i]};
+            } else {
+                attachments = {swapChainImageViews[i], depthTarget.view};
+            }
 
             VkFramebufferCreateInfo framebufferInfo{};
             framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
             // making sure it's compatible with the color attachment of our render pass
             framebufferInfo.renderPass = renderPass;
-            framebufferInfo.attachmentCount = 1;
-            framebufferInfo.pAttachments = attachments;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+            framebufferInfo.pAttachments = attachments.data();
             framebufferInfo.width = swapChainExtent.width;
             framebufferInfo.height = swapChainExtent.height;
             // one layer since we're not doing VR/AR fanciness
@@ -836,6 +2395,13 @@ private:
         }
     }
 
+    void destroyFramebuffers() {
+        for (const auto& framebuffer : swapChainFramebuffers) {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+        swapChainFramebuffers.clear();
+    }
+
     void createCommandPool() {
         QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
 
@@ -843,6 +2409,8 @@ private:
         VkCommandPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+        // we reset and re-record each command buffer every frame
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
         if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
             throw std::runtime_error("failed to create command pool!");
@@ -850,174 +2418,2463 @@ private:
     }
 
     void createVertexBuffer() {
+        createHostVisibleBuffer(ByteView(vertices.data(), sizeof(vertices[0]) * vertices.size()),
+                                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer, vertexBufferMemory);
+    }
+
+    // one mapped buffer of DrawData slots per frame in flight, and a set pointing at each. shader.vert declares the
+    // buffer whichever path is in use, so set 1 always gets something bound, it just stays tiny on the push path
+    void createDrawDataBuffers() {
+        uint32_t capacity = drawData.path() == DrawDataPath::Buffer ? drawData.bufferCapacity() : 1;
+        drawDataBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        drawDataBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        drawDataSlots.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            drawDataSlots[i] = static_cast<DrawData*>(createMappedBuffer(sizeof(DrawData) * capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                                         drawDataBuffers[i], drawDataBuffersMemory[i]));
+        }
+
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = MAX_FRAMES_IN_FLIGHT;
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &drawDataDescriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create draw data descriptor pool!");
+        }
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, drawDataSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = drawDataDescriptorPool;
+        allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+        allocInfo.pSetLayouts = layouts.data();
+        drawDataSets.resize(MAX_FRAMES_IN_FLIGHT);
+        if (vkAllocateDescriptorSets(device, &allocInfo, drawDataSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate draw data descriptor sets!");
+        }
+        resourceStats.created(ResourceKind::DescriptorSet, MAX_FRAMES_IN_FLIGHT);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            VkDescriptorBufferInfo bufferInfo{};
+            bufferInfo.buffer = drawDataBuffers[i];
+            bufferInfo.offset = 0;
+            // exactly the slots, shader.vert takes an instance past the end of the array to mean pushed data
+            bufferInfo.range = sizeof(DrawData) * capacity;
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = drawDataSets[i];
+            write.dstBinding = 0;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo = &bufferInfo;
+            vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+        }
+    }
+
+    void destroyDrawDataBuffers() {
+        vkDestroyDescriptorPool(device, drawDataDescriptorPool, nullptr);
+        resourceStats.destroyed(ResourceKind::DescriptorSet, static_cast<uint32_t>(drawDataSets.size()));
+        drawDataSets.clear();
+        for (size_t i = 0; i < drawDataBuffers.size(); i++) {
+            destroyBuffer(drawDataBuffers[i]);
+            freeMemory(drawDataBuffersMemory[i]);
+        }
+    }
+
+    // gets this frame's DrawData slots ready and binds them for the whole frame. the fence has already been waited
+    // on, so the buffer is free to write
+    void beginDrawData(VkCommandBuffer commandBuffer) {
+        // last time some frame ran out of slots. making them bigger means replacing every frame's buffer, so this
+        // waits for the GPU, but it only happens a handful of times at most
+        if (drawData.takeOverflow()) {
+            vkDeviceWaitIdle(device);
+            destroyDrawDataBuffers();
+            drawData.setBufferCapacity(drawData.bufferCapacity() * 2);
+            createDrawDataBuffers();
+            if (!options.quiet) {
+                printf("Draw data buffers were full, grew them to %u slots\n", drawData.bufferCapacity());
+            }
+        }
+        drawData.beginFrame(drawDataSlots[currentFrame]);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &drawDataSets[currentFrame], 0, nullptr);
+    }
+
+    // hands a draw its DrawData and returns the firstInstance it has to be drawn with. draws that share the previous
+    // draw's values cost nothing extra on either path
+    uint32_t setDrawData(VkCommandBuffer commandBuffer, const DrawData& data) {
+        DrawDataBinding<DrawData>::Slot slot = drawData.allocate(data);
+        if (!slot.changed) {
+            return slot.instance;
+        }
+        if (slot.path == DrawDataPath::PushConstants) {
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawData), &data);
+        }
+        // replays always push, whatever path the frame was recorded with
+        if (frameRecorder) {
+            frameRecorder->command(StreamOp::PushConstants, {0, sizeof(DrawData), frameRecorder->addBlob(&data, sizeof(DrawData))});
+        }
+        return slot.instance;
+    }
+
+    // makes a buffer the CPU can write to and fills it with the given bytes. the contents can come from anywhere (a
+    // vector, a mapped asset file...), they are copied exactly once, straight into the mapped buffer memory
+    void createHostVisibleBuffer(ByteView contents, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+        void* data = createMappedBuffer(contents.size, usage, buffer, bufferMemory);
+        memcpy(data, contents.data, contents.size);
+        vkUnmapMemory(device, bufferMemory);
+    }
+
+    // makes a buffer the CPU can write straight into and hands back where it's mapped. the mapping stays valid until
+    // the memory is unmapped or freed
+    void* createMappedBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         // requires size in bytes
-        bufferInfo.size = sizeof(vertices[0]) * vertices.size();
-        bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
         // queue that uses this buffer will get exclusive access (no cross-queue sync needed)
         bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-        if (vkCreateBuffer(device, &bufferInfo, nullptr, &vertexBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create vertex buffer!");
+        if (createBuffer(&bufferInfo, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create buffer!");
         }
 
         VkMemoryRequirements memRequirements;
-        vkGetBufferMemoryRequirements(device, vertexBuffer, &memRequirements);
+        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
         VkMemoryAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
         allocInfo.allocationSize = memRequirements.size;
         allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &vertexBufferMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate vertex buffer memory!");
+        if (allocateMemory(&allocInfo, &bufferMemory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate buffer memory!");
         }
 
-        vkBindBufferMemory(device, vertexBuffer, vertexBufferMemory, 0);
+        vkBindBufferMemory(device, buffer, bufferMemory, 0);
 
         void* data;
-        vkMapMemory(device, vertexBufferMemory, 0, bufferInfo.size, 0, &data);
-        memcpy(data, vertices.data(), (size_t) bufferInfo.size);
-        vkUnmapMemory(device, vertexBufferMemory);
+        vkMapMemory(device, bufferMemory, 0, bufferInfo.size, 0, &data);
+        return data;
     }
 
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-        VkPhysicalDeviceMemoryProperties memProperties;
-        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    // makes a buffer that lives in VRAM. the CPU can't see it, contents have to be copied (or computed) in
+    void createDeviceLocalBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-            if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-                return i;
-            }
+        if (createBuffer(&bufferInfo, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create buffer!");
         }
 
-        throw std::runtime_error("failed to find suitable memory type!");
-    }
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-    void createCommandBuffers() {
-        // we need multiple command buffers b/c we need one for each image in the swapchain
-        commandBuffers.resize(swapChainFramebuffers.size());
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-        // telling the command pool to create N buffers and how to do so
+        VkResult res;
+        if ((res = allocateMemory(&allocInfo, &bufferMemory)) != VK_SUCCESS) {
+            printf("Failed to allocate device local memory (VkResult: %d)\n", res);
+            throw std::runtime_error("failed to allocate buffer memory!");
+        }
+
+        vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    }
+
+    // records some commands into a throwaway command buffer and waits for them to finish. only meant for setup work
+    template<typename F>
+    void runOneTimeCommands(F&& record) {
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.commandPool = commandPool;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = (uint32_t) commandBuffers.size();
+        allocInfo.commandBufferCount = 1;
 
-        if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate command buffers!");
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffer!");
         }
 
-        // now we must record what each command buffer does
-        for (size_t i = 0; i < commandBuffers.size(); i++) {
-            VkCommandBufferBeginInfo beginInfo{};
-            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
-            if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-                throw std::runtime_error("failed to begin recording command buffer");
-            }
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        // setup work runs on every GPU of a device group, they all need their own copy of the data
+        VkDeviceGroupCommandBufferBeginInfo deviceGroupBeginInfo{};
+        if (!deviceGroupDevices.empty()) {
+            deviceGroupBeginInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_COMMAND_BUFFER_BEGIN_INFO;
+            deviceGroupBeginInfo.deviceMask = (1u << deviceGroupDevices.size()) - 1;
+            beginInfo.pNext = &deviceGroupBeginInfo;
+        }
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        record(commandBuffer);
+        vkEndCommandBuffer(commandBuffer);
 
-            // this command buffer shall contain a render pass
-            VkRenderPassBeginInfo renderPassInfo{};
-            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            renderPassInfo.renderPass = renderPass;
-            // specify which of the framebuffers we want to actually write to
-            renderPassInfo.framebuffer = swapChainFramebuffers[i];
-            renderPassInfo.renderArea.offset = {0, 0};
-            renderPassInfo.renderArea.extent = swapChainExtent;
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        VkResult res;
+        if ((res = vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE)) != VK_SUCCESS) {
+            printf("Failed to submit setup commands (VkResult: %d)\n", res);
+            throw std::runtime_error("failed to submit setup commands!");
+        }
+        vkQueueWaitIdle(graphicsQueue);
+        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+    }
 
-            // clear the framebuffer before rendering to it
-            VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-            renderPassInfo.clearValueCount = 1;
-            renderPassInfo.pClearValues = &clearColor;
+    // sets up the compute particle simulation: one buffer the compute shader updates in place and the graphics
+    // pipeline draws from directly, so the particles never come back to the CPU
+    void createParticleSystem() {
+        if (options.particleCount == 0) {
+            return;
+        }
+        // each GPU of the group would step its own copy of the particle buffer only on the frames it renders, so with
+        // AFR the copies drift apart and the particles jump around from frame to frame
+        if (!deviceGroupDevices.empty()) {
+            printf("Particles don't work with device groups yet, they're disabled\n");
+            return;
+        }
 
-            vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        // the simulation is recorded into the same command buffer as the drawing, so the graphics queue has to be able
+        // to run compute too (practically always the case)
+        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+        const VkQueueFamilyProperties& graphicsFamily = queueFamilies[indices.graphicsFamily.value()];
+        if (!(graphicsFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+            printf("The graphics queue can't run compute shaders, particles are disabled\n");
+            return;
+        }
 
-            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+        const VkPhysicalDeviceLimits& limits = deviceProperties.limits;
 
-            VkBuffer vertexBuffers[] = {vertexBuffer};
-            VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
+        uint32_t particleCount = options.particleCount;
+        VkDeviceSize bufferSize = VkDeviceSize(particleCount) * sizeof(Particle);
+        if (bufferSize > limits.maxStorageBufferRange) {
+            throw std::runtime_error("too many particles, the GPU can't bind a storage buffer of " + std::to_string(bufferSize) + " bytes");
+        }
+        uint32_t maxWorkgroupSize = std::min(limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupInvocations);
+        particleWorkgroupSize = std::min(options.particleWorkgroupSize, maxWorkgroupSize);
+        if (particleWorkgroupSize != options.particleWorkgroupSize) {
+            printf("Workgroup size %u is more than this GPU supports, using %u\n", options.particleWorkgroupSize, particleWorkgroupSize);
+        }
+        // the smallest workgroup size we'll ever use decides how many groups a dispatch needs
+        uint32_t smallestWorkgroupSize = options.particleBenchmark ? std::min(32u, particleWorkgroupSize) : particleWorkgroupSize;
+        if ((particleCount + smallestWorkgroupSize - 1) / smallestWorkgroupSize > limits.maxComputeWorkGroupCount[0]) {
+            throw std::runtime_error("too many particles for a single dispatch with this workgroup size");
+        }
 
-            vkCmdDraw(commandBuffers[i], static_cast<uint32_t>(vertices.size()), 1, 0, 0);
+        // start everything off on a disc, orbiting the center. the buffer is only ever written by the CPU this once
+        std::vector<Particle> particles(particleCount);
+        uint32_t seed = 0x9E3779B9u;
+        auto random = [&seed] {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            return static_cast<float>(seed) / 4294967296.0f;
+        };
+        for (auto& particle : particles) {
+            float radius = 0.1f + 0.8f * std::sqrt(random());
+            float angle = random() * 6.2831853f;
+            particle.position = glm::vec2(std::cos(angle), std::sin(angle)) * radius;
+            particle.velocity = glm::vec2(-std::sin(angle), std::cos(angle)) * (0.3f / std::sqrt(radius));
+            particle.color = glm::vec4(1.0f);
+        }
 
-            vkCmdEndRenderPass(commandBuffers[i]);
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        createHostVisibleBuffer(ByteView(particles.data(), bufferSize), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                stagingBuffer, stagingBufferMemory);
+        createDeviceLocalBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                particleBuffer, particleBufferMemory);
+        runOneTimeCommands([&](VkCommandBuffer commandBuffer) {
+            VkBufferCopy region{};
+            region.size = bufferSize;
+            vkCmdCopyBuffer(commandBuffer, stagingBuffer, particleBuffer, 1, &region);
+        });
+        destroyBuffer(stagingBuffer);
+        freeMemory(stagingBufferMemory);
+
+        // the compute shader sees the buffer through a single storage buffer binding
+        VkDescriptorSetLayoutBinding binding{};
+        binding.binding = 0;
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &binding;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &particleDescriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create particle descriptor set layout!");
+        }
 
-            if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-                throw std::runtime_error("failed to record command buffer!");
-            }
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = 1;
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &particleDescriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create particle descriptor pool!");
         }
-    }
 
-    void createSyncObjects() {
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-        imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = particleDescriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &particleDescriptorSetLayout;
+        if (vkAllocateDescriptorSets(device, &allocInfo, &particleDescriptorSet) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate particle descriptor set!");
+        }
+        resourceStats.created(ResourceKind::DescriptorSet);
+
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer = particleBuffer;
+        bufferInfo.offset = 0;
+        bufferInfo.range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = particleDescriptorSet;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+        // time step and friends change every frame, which is what push constants are for
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(ParticleParams);
 
-        VkSemaphoreCreateInfo semaphoreInfo{};
-        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &particleDescriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &particlePipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create particle pipeline layout!");
+        }
 
-        VkFenceCreateInfo fenceInfo{};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        particlePipeline = buildComputePipeline(particleWorkgroupSize);
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-                vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-                vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+        // timestamps around the dispatch give us the simulation's own GPU time, separate from the rest of the frame
+        if (graphicsFamily.timestampValidBits > 0 && limits.timestampPeriod > 0.0f) {
+            VkQueryPoolCreateInfo queryPoolInfo{};
+            queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPoolInfo.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
+            if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &particleQueryPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create timestamp query pool!");
+            }
+            timestampPeriodNs = limits.timestampPeriod;
+            timestampMask = graphicsFamily.timestampValidBits >= 64 ? ~0ull : (1ull << graphicsFamily.timestampValidBits) - 1;
+        } else {
+            printf("The graphics queue has no timestamps, particle throughput won't be measured\n");
+        }
+        particleQueryWorkgroupSizes.assign(MAX_FRAMES_IN_FLIGHT, 0);
 
-                throw std::runtime_error("failed to create synchronization objects for a frame!");
+        if (options.particleBenchmark) {
+            // powers of two from a single warp/wavefront's worth up to what the GPU allows
+            for (uint32_t size = 32; size <= maxWorkgroupSize; size *= 2) {
+                benchmarkWorkgroupSizes.push_back(size);
             }
+            if (benchmarkWorkgroupSizes.empty()) {
+                benchmarkWorkgroupSizes.push_back(maxWorkgroupSize);
+            }
+            benchmarkIndex = 0;
+            benchmarkFramesLeft = BENCHMARK_FRAMES;
+            setParticleWorkgroupSize(benchmarkWorkgroupSizes[0]);
         }
+
+        particlesEnabled = true;
+        lastSimulationStep = Clock::now();
+        lastParticleReport = lastSimulationStep;
     }
 
-    void mainLoop() {
-        while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
-            drawFrame();
+    // builds the particle compute pipeline for a workgroup size. like buildPipeline this may run on a worker thread
+    VkPipeline buildComputePipeline(uint32_t workgroupSize) {
+        VkShaderModule computeShaderModule = createShaderModule(MappedFile(PARTICLE_SHADER).view());
+
+        // local_size_x_id = 0 in particles.comp
+        VkSpecializationMapEntry specializationEntry{};
+        specializationEntry.constantID = 0;
+        specializationEntry.offset = 0;
+        specializationEntry.size = sizeof(uint32_t);
+
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = 1;
+        specializationInfo.pMapEntries = &specializationEntry;
+        specializationInfo.dataSize = sizeof(uint32_t);
+        specializationInfo.pData = &workgroupSize;
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = computeShaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+        pipelineInfo.layout = particlePipelineLayout;
+
+        VkPipeline pipeline;
+        VkResult res = vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+        vkDestroyShaderModule(device, computeShaderModule, nullptr);
+
+        if (res != VK_SUCCESS) {
+            printf("Failed to create compute pipeline (VkResult: %d)\n", res);
+            throw std::runtime_error("failed to create compute pipeline!");
         }
+        resourceStats.created(ResourceKind::Pipeline);
+        return pipeline;
+    }
 
-        vkDeviceWaitIdle(device);
+    // switches the simulation to another workgroup size. compute pipelines are quick to build, so this just happens
+    // inline (it's only used by the benchmark)
+    void setParticleWorkgroupSize(uint32_t workgroupSize) {
+        if (workgroupSize == particleWorkgroupSize) {
+            return;
+        }
+        retirePipeline(particlePipeline);
+        particlePipeline = buildComputePipeline(workgroupSize);
+        particleWorkgroupSize = workgroupSize;
     }
 
-    void drawFrame() {
-        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+    // recompiles the compute pipeline in the background after particles.comp changed
+    void rebuildParticlePipeline() {
+        if (pendingParticlePipeline.valid()) {
+            particlePipelineStale = true;
+            return;
+        }
+        uint32_t workgroupSize = particleWorkgroupSize;
+        pendingParticleWorkgroupSize = workgroupSize;
+        pendingParticlePipeline = workerPool.submit([this, workgroupSize] { return buildComputePipeline(workgroupSize); });
+    }
 
-        uint32_t imageIndex;
-        vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    void pollParticlePipeline() {
+        if (!pendingParticlePipeline.valid() || pendingParticlePipeline.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+        try {
+            VkPipeline pipeline = pendingParticlePipeline.get();
+            // the benchmark may have moved on to another workgroup size while this was compiling
+            if (pendingParticleWorkgroupSize == particleWorkgroupSize) {
+                retirePipeline(particlePipeline);
+                particlePipeline = pipeline;
+            } else {
+                retirePipeline(pipeline);
+            }
+        } catch (const std::exception& e) {
+            printf("Failed to compile the particle pipeline: %s\n", e.what());
+        }
+        if (particlePipelineStale) {
+            particlePipelineStale = false;
+            rebuildParticlePipeline();
+        }
+    }
 
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    // records one simulation step. goes before the render pass, since compute can't be dispatched inside one
+    void recordParticleSimulation(VkCommandBuffer commandBuffer) {
+        // the benchmark uses a fixed step so every workgroup size simulates exactly the same thing
+        auto now = Clock::now();
+        float deltaTime = std::min(std::chrono::duration<float>(now - lastSimulationStep).count(), 1.0f / 30.0f);
+        if (options.particleBenchmark) {
+            deltaTime = 1.0f / 60.0f;
+        }
+        lastSimulationStep = now;
+        simulationTime += deltaTime;
+
+        // the previous frame's draw (and its dispatch) must be done with the buffer before we overwrite it
+        VkMemoryBarrier beforeSimulation{};
+        beforeSimulation.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        beforeSimulation.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        beforeSimulation.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &beforeSimulation, 0, nullptr, 0, nullptr);
+
+        uint32_t queryBase = static_cast<uint32_t>(currentFrame) * 2;
+        if (particleQueryPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(commandBuffer, particleQueryPool, queryBase, 2);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, particleQueryPool, queryBase);
+            particleQueryWorkgroupSizes[currentFrame] = particleWorkgroupSize;
+        }
 
-        VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+        ParticleParams params{deltaTime, simulationTime, options.particleCount};
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particlePipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particlePipelineLayout, 0, 1, &particleDescriptorSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, particlePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+        vkCmdDispatch(commandBuffer, (options.particleCount + particleWorkgroupSize - 1) / particleWorkgroupSize, 1, 1);
 
-        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;
+        if (particleQueryPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, particleQueryPool, queryBase + 1);
+        }
 
-        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+        // and the draw reads what the dispatch wrote
+        VkMemoryBarrier afterSimulation{};
+        afterSimulation.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        afterSimulation.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        afterSimulation.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                             0, 1, &afterSimulation, 0, nullptr, 0, nullptr);
+    }
 
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to submit draw command buffer!");
+    // picks up the timestamps of the last frame that used this frame slot (its fence has just been waited on) and
+    // reports the throughput every couple of seconds
+    void collectParticleTimings() {
+        if (!particlesEnabled) {
+            return;
+        }
+        uint32_t workgroupSize = particleQueryWorkgroupSizes[currentFrame];
+        if (particleQueryPool != VK_NULL_HANDLE && workgroupSize != 0) {
+            particleQueryWorkgroupSizes[currentFrame] = 0;
+            uint64_t timestamps[2];
+            uint32_t queryBase = static_cast<uint32_t>(currentFrame) * 2;
+            if (vkGetQueryPoolResults(device, particleQueryPool, queryBase, 2, sizeof(timestamps), timestamps,
+                                      sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+                double seconds = double((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriodNs * 1e-9;
+                // measurements still in flight from the previous benchmark size don't count towards this one
+                if (workgroupSize == particleWorkgroupSize) {
+                    particleGpuSeconds += seconds;
+                    particleSteps++;
+                }
+            }
         }
 
-        // Check if a previous frame is using this image (i.e. there is its fence to wait on)
-        if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-            vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+        if (options.particleBenchmark) {
+            advanceParticleBenchmark();
+            return;
+        }
+        auto now = Clock::now();
+        if (now - lastParticleReport >= std::chrono::seconds(2)) {
+            if (particleSteps > 0 && !options.quiet) {
+                double stepSeconds = particleGpuSeconds / double(particleSteps);
+                printf("Particles: %u, workgroup size %u, %.3f ms/step on the GPU, %.1f M particles/s\n",
+                       options.particleCount, particleWorkgroupSize, stepSeconds * 1e3, options.particleCount / stepSeconds * 1e-6);
+            }
+            particleGpuSeconds = 0.0;
+            particleSteps = 0;
+            lastParticleReport = now;
+        }
+    }
+
+    void advanceParticleBenchmark() {
+        if (benchmarkIndex >= benchmarkWorkgroupSizes.size()) {
+            return;
+        }
+        // throw away the first frames of every size, before the clocks and caches have settled
+        if (benchmarkFramesLeft > BENCHMARK_FRAMES - BENCHMARK_WARMUP_FRAMES) {
+            particleGpuSeconds = 0.0;
+            particleSteps = 0;
+        }
+        if (--benchmarkFramesLeft > 0) {
+            return;
+        }
+        double particlesPerSecond = particleSteps > 0 ? options.particleCount * double(particleSteps) / particleGpuSeconds : 0.0;
+        benchmarkResults.emplace_back(particleWorkgroupSize, particlesPerSecond);
+        particleGpuSeconds = 0.0;
+        particleSteps = 0;
+        if (++benchmarkIndex < benchmarkWorkgroupSizes.size()) {
+            benchmarkFramesLeft = BENCHMARK_FRAMES;
+            setParticleWorkgroupSize(benchmarkWorkgroupSizes[benchmarkIndex]);
+        } else {
+            printParticleBenchmark();
+        }
+    }
+
+    void printParticleBenchmark() {
+        if (benchmarkResults.empty()) {
+            return;
+        }
+        auto best = std::max_element(benchmarkResults.begin(), benchmarkResults.end(),
+                                     [](const auto& a, const auto& b) { return a.second < b.second; });
+        printf("Particle benchmark (%u particles, %llu frames per size):\n", options.particleCount, (unsigned long long) (BENCHMARK_FRAMES - BENCHMARK_WARMUP_FRAMES));
+        for (const auto& result : benchmarkResults) {
+            printf(" - workgroup size %4u: %10.1f M particles/s%s\n", result.first, result.second * 1e-6,
+                   &result == &*best ? " <=" : "");
+        }
+        // the whole sweep has been reported, don't print it again on exit
+        benchmarkResults.clear();
+    }
+
+    void destroyParticleSystem() {
+        if (!particlesEnabled) {
+            return;
+        }
+        // a benchmark cut short still reports the sizes it got through
+        printParticleBenchmark();
+        if (pendingParticlePipeline.valid()) {
+            try {
+                destroyPipeline(pendingParticlePipeline.get());
+            } catch (const std::exception&) {
+            }
+        }
+        destroyPipeline(particlePipeline);
+        vkDestroyPipelineLayout(device, particlePipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, particleDescriptorPool, nullptr);
+        resourceStats.destroyed(ResourceKind::DescriptorSet);
+        vkDestroyDescriptorSetLayout(device, particleDescriptorSetLayout, nullptr);
+        if (particleQueryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, particleQueryPool, nullptr);
+        }
+        destroyBuffer(particleBuffer);
+        freeMemory(particleBufferMemory);
+    }
+
+    // a wavy height field, standing in for a big scanned/sculpted mesh
+    static void generateHeightField(uint32_t resolution, std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices) {
+        positions.clear();
+        indices.clear();
+        positions.reserve(size_t(resolution + 1) * (resolution + 1));
+        indices.reserve(size_t(resolution) * resolution * 6);
+        for (uint32_t y = 0; y <= resolution; y++) {
+            for (uint32_t x = 0; x <= resolution; x++) {
+                float u = float(x) / float(resolution) * 2.0f - 1.0f;
+                float v = float(y) / float(resolution) * 2.0f - 1.0f;
+                float height = 0.05f * (std::sin(7.0f * u) * std::cos(5.0f * v) + 0.5f * std::sin(23.0f * u + 11.0f * v));
+                positions.emplace_back(u, v, height);
+            }
+        }
+        for (uint32_t y = 0; y < resolution; y++) {
+            for (uint32_t x = 0; x < resolution; x++) {
+                uint32_t a = y * (resolution + 1) + x;
+                uint32_t b = a + 1;
+                uint32_t c = a + resolution + 1;
+                uint32_t d = c + 1;
+                indices.insert(indices.end(), {a, c, b, b, c, d});
+            }
+        }
+    }
+
+    // builds the cluster hierarchy on its own thread. the per group simplification inside is spread over the worker
+    // pool, which is why the build itself can't be a job on that pool
+    void startLodMeshBuild() {
+        uint32_t resolution = options.lodMeshResolution;
+        lodMeshFuture = std::async(std::launch::async, [this, resolution] {
+            auto start = Clock::now();
+            std::vector<glm::vec3> positions;
+            std::vector<uint32_t> indices;
+            generateHeightField(resolution, positions, indices);
+            LodMesh mesh = buildLodMesh(std::move(positions), std::move(indices), &workerPool);
+            if (!options.quiet) {
+                printf("Built LOD hierarchy for %llu triangles: %zu clusters over %u levels in %.2f s\n",
+                       (unsigned long long) mesh.sourceTriangleCount, mesh.clusters.size(), mesh.levelCount,
+                       std::chrono::duration<double>(Clock::now() - start).count());
+            }
+            return mesh;
+        });
+    }
+
+    // the LOD mesh is seen from straight above, so a point's depth comes from its height: higher is nearer
+    static float lodDepth(float height) {
+        return 0.5f - 2.0f * height;
+    }
+
+    // uploads the hierarchy once it's built. every level goes into the same buffers: each meshlet gets its own copy of
+    // its vertices (colored by level, so you can see the selection at work) and its triangles become regular 32 bit
+    // indices, laid out in cluster order so neighboring clusters can be drawn together
+    void pollLodMesh() {
+        if (!lodMeshFuture.valid() || lodMeshFuture.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+        // a build that threw (out of memory on a huge --lod-mesh, say) just leaves the demo off
+        try {
+            lodMesh = lodMeshFuture.get();
+        } catch (const std::exception& e) {
+            printf("Failed to build the LOD mesh: %s\n", e.what());
+            return;
+        }
+
+        const glm::vec3 levelColors[] = {
+                {1.0f, 1.0f, 1.0f}, {1.0f, 0.4f, 0.4f}, {1.0f, 0.8f, 0.3f}, {0.5f, 1.0f, 0.4f},
+                {0.3f, 0.9f, 1.0f}, {0.4f, 0.5f, 1.0f}, {0.8f, 0.4f, 1.0f}, {1.0f, 0.5f, 0.8f},
+        };
+        std::vector<Vertex> lodVertices(lodMesh.meshletVertices.size());
+        std::vector<uint32_t> lodIndices(lodMesh.meshletTriangles.size());
+        for (const LodCluster& cluster : lodMesh.clusters) {
+            const Meshlet& meshlet = cluster.meshlet;
+            glm::vec3 color = levelColors[cluster.level % (sizeof(levelColors) / sizeof(levelColors[0]))];
+            for (uint32_t i = meshlet.vertexOffset; i < meshlet.vertexOffset + meshlet.vertexCount; i++) {
+                glm::vec3 position = lodMesh.positions[lodMesh.meshletVertices[i]];
+                // seen from straight above, with the height as shading
+                lodVertices[i].pos = glm::vec3(glm::vec2(position.x, position.y) * 0.95f, lodDepth(position.z));
+                lodVertices[i].color = color * (0.6f + 4.0f * position.z);
+            }
+            for (uint32_t i = meshlet.triangleOffset * 3; i < (meshlet.triangleOffset + meshlet.triangleCount) * 3; i++) {
+                lodIndices[i] = meshlet.vertexOffset + lodMesh.meshletTriangles[i];
+            }
+        }
+
+        VkDeviceSize vertexBytes = sizeof(Vertex) * lodVertices.size();
+        VkDeviceSize indexBytes = sizeof(uint32_t) * lodIndices.size();
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        std::vector<uint8_t> staging(vertexBytes + indexBytes);
+        memcpy(staging.data(), lodVertices.data(), vertexBytes);
+        memcpy(staging.data() + vertexBytes, lodIndices.data(), indexBytes);
+        createHostVisibleBuffer(ByteView(staging.data(), staging.size()), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, stagingBuffer, stagingBufferMemory);
+        createDeviceLocalBuffer(vertexBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, lodVertexBuffer, lodVertexBufferMemory);
+        createDeviceLocalBuffer(indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, lodIndexBuffer, lodIndexBufferMemory);
+        // a one time stall, only when the mesh shows up
+        runOneTimeCommands([&](VkCommandBuffer commandBuffer) {
+            VkBufferCopy vertexRegion{0, 0, vertexBytes};
+            vkCmdCopyBuffer(commandBuffer, stagingBuffer, lodVertexBuffer, 1, &vertexRegion);
+            VkBufferCopy indexRegion{vertexBytes, 0, indexBytes};
+            vkCmdCopyBuffer(commandBuffer, stagingBuffer, lodIndexBuffer, 1, &indexRegion);
+        });
+        destroyBuffer(stagingBuffer);
+        freeMemory(stagingBufferMemory);
+
+        // the CPU only needs the cluster list from here on
+        lodMesh.positions = {};
+        lodMesh.meshletVertices = {};
+        lodMesh.meshletTriangles = {};
+        lodMeshReady = true;
+        lastLodReport = Clock::now();
+    }
+
+    // picks this frame's clusters. the mesh is drawn from above, but the error is measured from a viewer flying low
+    // over it, so detail visibly follows that viewer around
+    void updateLodSelection() {
+        if (!lodMeshReady) {
+            return;
+        }
+        float time = std::chrono::duration<float>(Clock::now() - launchTime).count();
+        LodCamera camera{};
+        camera.position = glm::vec3(0.5f * std::cos(0.2f * time), 0.5f * std::sin(0.2f * time), 0.25f);
+        // a 60 degree vertical field of view over the swapchain's height
+        camera.projectionScale = float(swapChainExtent.height) / (2.0f * std::tan(glm::radians(60.0f) * 0.5f));
+        lodSelector.select(lodMesh, camera, options.triangleBudget, lodSelection);
+
+        auto now = Clock::now();
+        if (now - lastLodReport >= std::chrono::seconds(2)) {
+            if (!options.quiet) {
+                printf("LOD: %zu clusters, %llu of %llu triangles (budget %llu), %.2f px error\n", lodSelection.clusters.size(),
+                       (unsigned long long) lodSelection.triangleCount, (unsigned long long) lodMesh.sourceTriangleCount,
+                       (unsigned long long) options.triangleBudget, lodSelection.errorThreshold);
+            }
+            lastLodReport = now;
+        }
+    }
+
+    void queueLodMesh() {
+        VkPipeline lodPipeline = findReadyPipeline(lodMeshPipelineDesc);
+        if (lodPipeline == VK_NULL_HANDLE || lodSelection.clusters.empty()) {
+            return;
+        }
+        // the prepass is only used once both of its pipelines are in, until then the mesh is drawn the plain way. its
+        // draws have a layer of their own, so they all come before the color pass' however the rest sorts
+        VkPipeline prepassPipeline = options.depthPrepass ? findReadyPipeline(lodDepthPrepassPipelineDesc) : VK_NULL_HANDLE;
+        VkPipeline afterPrepassPipeline = options.depthPrepass ? findReadyPipeline(lodAfterPrepassPipelineDesc) : VK_NULL_HANDLE;
+        if (prepassPipeline != VK_NULL_HANDLE && afterPrepassPipeline != VK_NULL_HANDLE) {
+            queueLodClusters(DrawLayer::DepthPrepass, prepassPipeline);
+            lodPipeline = afterPrepassPipeline;
+        }
+        queueLodClusters(DrawLayer::Opaque, lodPipeline);
+    }
+
+    void queueLodClusters(DrawLayer layer, VkPipeline pipeline) {
+        DrawItem item;
+        item.pipeline = pipeline;
+        item.vertexBuffer = lodVertexBuffer;
+        item.indexBuffer = lodIndexBuffer;
+        // selected clusters whose indices sit back to back in the index buffer go out as a single draw
+        const std::vector<uint32_t>& selected = lodSelection.clusters;
+        for (size_t i = 0; i < selected.size();) {
+            // sorted by the depth the run's first cluster's center ends up at, the same one its vertices get
+            float depth = lodDepth(lodMesh.clusters[selected[i]].self.center.z);
+            const Meshlet& first = lodMesh.clusters[selected[i]].meshlet;
+            uint32_t firstIndex = first.triangleOffset * 3;
+            uint32_t indexCount = first.triangleCount * 3;
+            for (i++; i < selected.size(); i++) {
+                const Meshlet& next = lodMesh.clusters[selected[i]].meshlet;
+                if (next.triangleOffset * 3 != firstIndex + indexCount) {
+                    break;
+                }
+                indexCount += next.triangleCount * 3;
+            }
+            item.count = indexCount;
+            item.first = firstIndex;
+            queueDraw(layer, depth, item);
+        }
+    }
+
+    void destroyLodMesh() {
+        // the build uses the worker pool, so it has to be done before anything goes away
+        if (lodMeshFuture.valid()) {
+            lodMeshFuture.wait();
+        }
+        if (!lodMeshReady) {
+            return;
+        }
+        destroyBuffer(lodVertexBuffer);
+        freeMemory(lodVertexBufferMemory);
+        destroyBuffer(lodIndexBuffer);
+        freeMemory(lodIndexBufferMemory);
+    }
+
+    // scatters objects through a cube around the camera. every frame's draw buffer can hold all of them, since in the
+    // worst case nothing gets culled
+    void createScene() {
+        if (options.sceneObjectCount == 0) {
+            return;
+        }
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (uint32_t i = 0; i < options.sceneObjectCount; i++) {
+            glm::vec3 center(position(rng), position(rng), position(rng));
+            glm::vec3 color(0.3f + 0.7f * unit(rng), 0.3f + 0.7f * unit(rng), 0.3f + 0.7f * unit(rng));
+            scene.add(center, 0.5f + unit(rng), glm::vec3(0.0f), 0.5f, color);
+        }
+        scene.updateBounds();
+
+        sceneDrawBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        sceneDrawBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        sceneDrawVertices.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            sceneDrawVertices[i] = static_cast<Vertex*>(createMappedBuffer(sizeof(Vertex) * options.sceneObjectCount,
+                                                                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                                                           sceneDrawBuffers[i], sceneDrawBuffersMemory[i]));
+        }
+        lastSceneReport = Clock::now();
+    }
+
+    // culls the scene for a camera spinning in its middle and fills this frame's draw buffer from the draw list. has
+    // to run after the frame's fence, the GPU may still be reading the buffer before that
+    void updateScene() {
+        if (options.sceneObjectCount == 0) {
+            return;
+        }
+        float time = std::chrono::duration<float>(Clock::now() - launchTime).count();
+        float aspect = float(swapChainExtent.width) / float(std::max(swapChainExtent.height, 1u));
+        glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(60.0f), aspect, 0.1f, 100.0f);
+        glm::vec3 forward(std::cos(0.3f * time), 0.0f, std::sin(0.3f * time));
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f), forward, glm::vec3(0.0f, 1.0f, 0.0f));
+        sceneViewProjection = projection * view;
+
+        auto start = Clock::now();
+        frustumCuller.cull(scene, Frustum::fromMatrix(sceneViewProjection), visibleObjects, &workerPool);
+        sceneCullMsTotal += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        sceneCullFrames++;
+
+        // the draw list is just object ids, this turns it into what the point pipeline draws. the camera goes in the
+        // draw's DrawData, so the points stay in world space
+        Vertex* out = sceneDrawVertices[currentFrame];
+        for (uint32_t id : visibleObjects) {
+            out->pos = scene.worldCenter(id);
+            out->color = scene.color(id);
+            out++;
+        }
+        sceneDrawCount = static_cast<uint32_t>(visibleObjects.size());
+
+        auto now = Clock::now();
+        if (now - lastSceneReport >= std::chrono::seconds(2)) {
+            if (!options.quiet) {
+                printf("Scene: %u of %zu objects visible, culling took %.3f ms per frame\n", sceneDrawCount, scene.size(),
+                       sceneCullMsTotal / sceneCullFrames);
+            }
+            sceneCullMsTotal = 0.0;
+            sceneCullFrames = 0;
+            lastSceneReport = now;
+        }
+    }
+
+    void queueScene() {
+        VkPipeline scenePipeline = findReadyPipeline(scenePointPipelineDesc);
+        if (scenePipeline == VK_NULL_HANDLE || sceneDrawCount == 0) {
+            return;
+        }
+        DrawItem item;
+        item.pipeline = scenePipeline;
+        item.vertexBuffer = sceneDrawBuffers[currentFrame];
+        item.count = sceneDrawCount;
+        item.data.transform = sceneViewProjection;
+        queueDraw(DrawLayer::Opaque, 0.0f, item);
+    }
+
+    void destroyScene() {
+        for (size_t i = 0; i < sceneDrawBuffers.size(); i++) {
+            destroyBuffer(sceneDrawBuffers[i]);
+            freeMemory(sceneDrawBuffersMemory[i]);
+        }
+    }
+
+    static VkFormat vulkanFormat(TextureFormat format) {
+        switch (format) {
+            case TextureFormat::Rgba8:
+                return VK_FORMAT_R8G8B8A8_SRGB;
+            case TextureFormat::Bc1:
+                return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+            case TextureFormat::Bc7:
+                return VK_FORMAT_BC7_SRGB_BLOCK;
+        }
+        throw std::runtime_error("unknown texture format");
+    }
+
+    // a colorful test pattern with detail at every scale, so it's easy to see which mip level is showing
+    static TextureSource generateProceduralTexture(uint32_t index, uint32_t size) {
+        float hue = float(index) * 0.618034f;
+        glm::vec3 base(0.5f + 0.5f * std::cos(6.2831853f * hue), 0.5f + 0.5f * std::cos(6.2831853f * (hue + 0.33f)),
+                       0.5f + 0.5f * std::cos(6.2831853f * (hue + 0.67f)));
+        float ringFrequency = 40.0f + float(index % 7) * 10.0f;
+        std::vector<uint8_t> pixels(size_t(size) * size * 4);
+        for (uint32_t y = 0; y < size; y++) {
+            for (uint32_t x = 0; x < size; x++) {
+                float u = float(x) / float(size) - 0.5f;
+                float v = float(y) / float(size) - 0.5f;
+                float checker = float(((x * 8 / size) + (y * 8 / size)) & 1);
+                float rings = 0.5f + 0.5f * std::sin(std::sqrt(u * u + v * v) * ringFrequency);
+                float lines = (x % 16 == 0 || y % 16 == 0) ? 0.5f : 1.0f;
+                glm::vec3 color = base * ((0.35f + 0.45f * checker + 0.2f * rings) * lines);
+                uint8_t* pixel = &pixels[(size_t(y) * size + x) * 4];
+                pixel[0] = static_cast<uint8_t>(std::clamp(color.x, 0.0f, 1.0f) * 255.0f);
+                pixel[1] = static_cast<uint8_t>(std::clamp(color.y, 0.0f, 1.0f) * 255.0f);
+                pixel[2] = static_cast<uint8_t>(std::clamp(color.z, 0.0f, 1.0f) * 255.0f);
+                pixel[3] = 255;
+            }
+        }
+        return TextureSource::fromPixels(size, size, std::move(pixels));
+    }
+
+    // everything texture streaming needs on the GPU that doesn't depend on the textures themselves. the textures start
+    // loading once the first frame is up (startTextureLoads)
+    void createTextureStreaming() {
+        std::vector<std::string> paths;
+        if (options.textureDirectory) {
+            for (const auto& entry : std::filesystem::directory_iterator(*options.textureDirectory)) {
+                std::string extension = entry.path().extension().string();
+                if (entry.is_regular_file() && (extension == ".ppm" || extension == ".vtex")) {
+                    paths.push_back(entry.path().string());
+                }
+            }
+            std::sort(paths.begin(), paths.end());
+            if (paths.empty()) {
+                printf("No .ppm or .vtex files in %s\n", options.textureDirectory->c_str());
+            }
+        }
+        if (paths.empty() && options.proceduralTextureCount == 0) {
+            return;
+        }
+        // uploads are recorded into the frame's command buffer, which only runs on that frame's GPU
+        if (!deviceGroupDevices.empty()) {
+            printf("Texture streaming doesn't work with device groups yet, it's disabled\n");
+            return;
+        }
+        texturesEnabled = true;
+        textureResidency = TextureResidency(options.textureBudgetMiB << 20);
+        if (options.compressTextures && !bcTexturesSupported) {
+            printf("This GPU can't sample BC textures, loading them uncompressed\n");
+            options.compressTextures.reset();
+        }
+
+        for (const auto& path : paths) {
+            StreamedTexture texture;
+            texture.name = path;
+            streamedTextures.push_back(std::move(texture));
+        }
+        for (uint32_t i = 0; i < options.proceduralTextureCount; i++) {
+            StreamedTexture texture;
+            texture.name = "procedural texture " + std::to_string(i);
+            streamedTextures.push_back(std::move(texture));
+        }
+
+        // trilinear, and no clamp on the LOD: every image only has the levels that are resident, and sampling one
+        // finer than that just clamps to its level 0
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        VkResult res;
+        if ((res = vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler)) != VK_SUCCESS) {
+            printf("Failed to create the texture sampler (VkResult: %d)\n", res);
+            throw std::runtime_error("failed to create texture sampler");
+        }
+
+        // a texture's old descriptor set lives on for a couple of frames after it gets a new one
+        uint32_t maxSets = static_cast<uint32_t>(streamedTextures.size()) * (MAX_FRAMES_IN_FLIGHT + 1);
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSize.descriptorCount = maxSets;
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        poolInfo.maxSets = maxSets;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &textureDescriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture descriptor pool!");
+        }
+
+        // two triangles per grid cell, with a little gap around each
+        std::vector<TexturedVertex> quads;
+        for (uint32_t row = 0; row < TEXTURE_GRID_ROWS; row++) {
+            for (uint32_t column = 0; column < TEXTURE_GRID_COLUMNS; column++) {
+                float cellWidth = 2.0f / TEXTURE_GRID_COLUMNS;
+                float cellHeight = 2.0f / TEXTURE_GRID_ROWS;
+                float x0 = -1.0f + cellWidth * (column + 0.05f), x1 = -1.0f + cellWidth * (column + 0.95f);
+                float y0 = -1.0f + cellHeight * (row + 0.05f), y1 = -1.0f + cellHeight * (row + 0.95f);
+                quads.insert(quads.end(), {{{x0, y0}, {0.0f, 0.0f}}, {{x1, y0}, {1.0f, 0.0f}}, {{x1, y1}, {1.0f, 1.0f}},
+                                           {{x0, y0}, {0.0f, 0.0f}}, {{x1, y1}, {1.0f, 1.0f}}, {{x0, y1}, {0.0f, 1.0f}}});
+            }
+        }
+        createHostVisibleBuffer(ByteView(quads.data(), sizeof(TexturedVertex) * quads.size()), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                textureQuadBuffer, textureQuadBufferMemory);
+        lastTextureReport = Clock::now();
+    }
+
+    // decoding, mip generation and block compression all happen on the worker pool. each texture is one job that
+    // encodes on its own thread: the jobs can't hand blocks to the pool they're running on without risking waits on
+    // work queued up behind themselves, and a few textures loading at once keep the pool busy anyway
+    void startTextureLoads() {
+        uint32_t proceduralIndex = 0;
+        std::optional<TextureFormat> compressTo = options.compressTextures;
+        for (auto& texture : streamedTextures) {
+            if (texture.name.rfind("procedural texture ", 0) == 0) {
+                uint32_t index = proceduralIndex++;
+                uint32_t size = PROCEDURAL_TEXTURE_SIZE;
+                texture.pending = workerPool.submit([index, size, compressTo] {
+                    TextureSource source = generateProceduralTexture(index, size);
+                    return compressTo ? compressTexture(source, *compressTo, BcQuality::Fast) : std::move(source);
+                });
+            } else {
+                std::string path = texture.name;
+                texture.pending = workerPool.submit([path, compressTo] {
+                    TextureSource source = TextureSource::fromFile(path);
+                    if (compressTo && source.format() == TextureFormat::Rgba8) {
+                        return compressTexture(source, *compressTo, BcQuality::Fast);
+                    }
+                    return source;
+                });
+            }
+        }
+    }
+
+    // hands finished decodes over to the residency tracker
+    void pollTextureLoads() {
+        for (uint32_t i = 0; i < streamedTextures.size(); i++) {
+            StreamedTexture& texture = streamedTextures[i];
+            if (!texture.pending.valid() || texture.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                continue;
+            }
+            try {
+                texture.source = texture.pending.get();
+            } catch (const std::exception& e) {
+                printf("Failed to load %s: %s\n", texture.name.c_str(), e.what());
+                continue;
+            }
+            if (texture.source->format() != TextureFormat::Rgba8 && !bcTexturesSupported) {
+                printf("Skipping %s, this GPU can't sample %s textures\n", texture.name.c_str(),
+                       textureFormatName(texture.source->format()));
+                texture.source.reset();
+                continue;
+            }
+            const TextureSource& source = *texture.source;
+            std::vector<uint64_t> levelBytes;
+            uint32_t tailLevel = source.levelCount() - 1;
+            for (uint32_t level = 0; level < source.levelCount(); level++) {
+                levelBytes.push_back(source.level(level).size);
+                if (tailLevel == source.levelCount() - 1 && std::max(source.width(level), source.height(level)) <= TEXTURE_TAIL_SIZE) {
+                    tailLevel = level;
+                }
+            }
+            texture.residencyId = textureResidency.add(std::move(levelBytes), tailLevel);
+            textureOfResidency.push_back(i);
+        }
+    }
+
+    // tells the residency tracker what's on screen, then carries out whatever it decides. has to run after the
+    // frame's fence and before it's recorded
+    void updateTextureStreaming() {
+        if (!texturesEnabled) {
+            return;
+        }
+        pollTextureLoads();
+
+        uint32_t textureCount = static_cast<uint32_t>(streamedTextures.size());
+        float time = std::chrono::duration<float>(Clock::now() - launchTime).count();
+        textureGridStart = static_cast<uint32_t>(time / TEXTURE_SCROLL_SECONDS) * TEXTURE_GRID_COLUMNS % textureCount;
+        // the finest level worth having is the one closest to one texel per pixel of its cell
+        float cellWidth = float(swapChainExtent.width) / TEXTURE_GRID_COLUMNS * 0.9f;
+        float cellHeight = float(swapChainExtent.height) / TEXTURE_GRID_ROWS * 0.9f;
+        uint32_t slots = std::min(TEXTURE_GRID_COLUMNS * TEXTURE_GRID_ROWS, textureCount);
+        for (uint32_t slot = 0; slot < slots; slot++) {
+            StreamedTexture& texture = streamedTextures[(textureGridStart + slot) % textureCount];
+            if (!texture.source) {
+                continue;
+            }
+            float texelsPerPixel = std::max(texture.source->width() / cellWidth, texture.source->height() / cellHeight);
+            uint32_t wanted = texelsPerPixel > 1.0f ? static_cast<uint32_t>(std::floor(std::log2(texelsPerPixel))) : 0;
+            textureResidency.request(texture.residencyId, wanted, frameNumber);
+        }
+
+        ArenaVector<TextureResidency::Change> changes(frameArenas.allocator<TextureResidency::Change>());
+        changes.reserve(textureResidency.size());
+        textureResidency.plan(frameNumber, TEXTURE_UPLOAD_BUDGET, changes);
+        for (const auto& change : changes) {
+            StreamedTexture& texture = streamedTextures[textureOfResidency[change.texture]];
+            if (change.toLevel < change.fromLevel) {
+                textureLevelsStreamedIn += std::min(change.fromLevel, texture.source->levelCount()) - change.toLevel;
+            } else {
+                textureLevelsEvicted += change.toLevel - change.fromLevel;
+            }
+            rebuildTextureImage(texture, change.toLevel);
+        }
+
+        auto now = Clock::now();
+        if (now - lastTextureReport >= std::chrono::seconds(2)) {
+            if (!options.quiet) {
+                printf("Textures: %zu of %zu loaded, %.1f of %.1f MiB resident, %llu levels streamed in, %llu evicted\n",
+                       textureResidency.size(), streamedTextures.size(), double(textureResidency.residentBytes()) / (1 << 20),
+                       double(textureResidency.budget()) / (1 << 20), (unsigned long long) textureLevelsStreamedIn,
+                       (unsigned long long) textureLevelsEvicted);
+            }
+            lastTextureReport = now;
+        }
+    }
+
+    // swaps a texture's image for one holding source levels [baseLevel, levelCount). the GPU side of it is recorded
+    // later, by recordTextureRebuilds()
+    void rebuildTextureImage(StreamedTexture& texture, uint32_t baseLevel) {
+        const TextureSource& source = *texture.source;
+        VkFormat format = vulkanFormat(source.format());
+        uint32_t levelCount = source.levelCount() - baseLevel;
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = {source.width(baseLevel), source.height(baseLevel), 1};
+        imageInfo.mipLevels = levelCount;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        // transfer source too, the next rebuild copies the levels it keeps out of this image
+        imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkImage image;
+        VkResult res;
+        if ((res = createImage(&imageInfo, &image)) != VK_SUCCESS) {
+            printf("Failed to create an image for %s (VkResult: %d)\n", texture.name.c_str(), res);
+            throw std::runtime_error("failed to create texture image");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, image, &memRequirements);
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VkDeviceMemory memory;
+        if ((res = allocateMemory(&allocInfo, &memory)) != VK_SUCCESS) {
+            printf("Failed to allocate memory for %s (VkResult: %d)\n", texture.name.c_str(), res);
+            throw std::runtime_error("failed to allocate texture memory");
+        }
+        vkBindImageMemory(device, image, memory, 0);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = levelCount;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        VkImageView view;
+        if ((res = vkCreateImageView(device, &viewInfo, nullptr, &view)) != VK_SUCCESS) {
+            printf("Failed to create an image view for %s (VkResult: %d)\n", texture.name.c_str(), res);
+            throw std::runtime_error("failed to create texture image view");
+        }
+
+        // a fresh set rather than updating the old one, which frames still in flight may be using
+        VkDescriptorSetAllocateInfo setInfo{};
+        setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setInfo.descriptorPool = textureDescriptorPool;
+        setInfo.descriptorSetCount = 1;
+        setInfo.pSetLayouts = &textureSetLayout;
+        VkDescriptorSet descriptorSet;
+        if (vkAllocateDescriptorSets(device, &setInfo, &descriptorSet) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate texture descriptor set!");
+        }
+        resourceStats.created(ResourceKind::DescriptorSet);
+        VkDescriptorImageInfo descriptorImage{};
+        descriptorImage.sampler = textureSampler;
+        descriptorImage.imageView = view;
+        descriptorImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = descriptorSet;
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &descriptorImage;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+        TextureRebuild rebuild{};
+        rebuild.image = image;
+        rebuild.levelCount = levelCount;
+        uint32_t oldBase = source.levelCount();
+        if (texture.image != VK_NULL_HANDLE) {
+            oldBase = texture.baseLevel;
+            rebuild.oldImage = texture.image;
+            for (uint32_t level = std::max(baseLevel, oldBase); level < source.levelCount(); level++) {
+                VkImageCopy copy{};
+                copy.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - oldBase, 0, 1};
+                copy.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - baseLevel, 0, 1};
+                copy.extent = {source.width(level), source.height(level), 1};
+                rebuild.copies.push_back(copy);
+            }
+            retiredTextureResources.push_back({texture.image, texture.memory, texture.view, texture.descriptorSet,
+                                               VK_NULL_HANDLE, VK_NULL_HANDLE, frameNumber});
+        }
+
+        if (baseLevel < oldBase) {
+            // 16 byte aligned, which covers the copy alignment rules for every format we have
+            std::vector<VkDeviceSize> offsets;
+            VkDeviceSize stagingSize = 0;
+            for (uint32_t level = baseLevel; level < oldBase; level++) {
+                offsets.push_back(stagingSize);
+                stagingSize += (source.level(level).size + 15) & ~VkDeviceSize(15);
+            }
+            VkBuffer stagingBuffer;
+            VkDeviceMemory stagingBufferMemory;
+            auto* staging = static_cast<uint8_t*>(createMappedBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                                     stagingBuffer, stagingBufferMemory));
+            for (uint32_t level = baseLevel; level < oldBase; level++) {
+                ByteView data = source.level(level);
+                memcpy(staging + offsets[level - baseLevel], data.data, data.size);
+                VkBufferImageCopy upload{};
+                upload.bufferOffset = offsets[level - baseLevel];
+                upload.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - baseLevel, 0, 1};
+                upload.imageExtent = {source.width(level), source.height(level), 1};
+                rebuild.uploads.push_back(upload);
+            }
+            rebuild.stagingBuffer = stagingBuffer;
+            // freeing the memory unmaps it
+            retiredTextureResources.push_back({VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE,
+                                               stagingBuffer, stagingBufferMemory, frameNumber});
+        }
+
+        texture.image = image;
+        texture.memory = memory;
+        texture.view = view;
+        texture.descriptorSet = descriptorSet;
+        texture.baseLevel = baseLevel;
+        textureRebuilds.push_back(std::move(rebuild));
+    }
+
+    // fills in this frame's new texture images, ahead of the render pass that samples them
+    void recordTextureRebuilds(VkCommandBuffer commandBuffer) {
+        if (textureRebuilds.empty()) {
+            return;
+        }
+
+        // new images get ready to be written, old ones to be read. the old ones were last sampled by earlier frames'
+        // fragment shaders (or just filled in by the previous frame, whose barrier already waited for that)
+        ArenaVector<VkImageMemoryBarrier> barriers(frameArenas.allocator<VkImageMemoryBarrier>());
+        barriers.reserve(textureRebuilds.size() * 2);
+        for (const auto& rebuild : textureRebuilds) {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = rebuild.image;
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, rebuild.levelCount, 0, 1};
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barriers.push_back(barrier);
+            if (rebuild.oldImage != VK_NULL_HANDLE) {
+                barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                barrier.image = rebuild.oldImage;
+                barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+                barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                barriers.push_back(barrier);
+            }
+        }
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+        for (const auto& rebuild : textureRebuilds) {
+            if (!rebuild.copies.empty()) {
+                vkCmdCopyImage(commandBuffer, rebuild.oldImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, rebuild.image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(rebuild.copies.size()), rebuild.copies.data());
+            }
+            if (!rebuild.uploads.empty()) {
+                vkCmdCopyBufferToImage(commandBuffer, rebuild.stagingBuffer, rebuild.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                       static_cast<uint32_t>(rebuild.uploads.size()), rebuild.uploads.data());
+            }
+        }
+
+        barriers.clear();
+        for (const auto& rebuild : textureRebuilds) {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = rebuild.image;
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, rebuild.levelCount, 0, 1};
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barriers.push_back(barrier);
+        }
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+        textureRebuilds.clear();
+    }
+
+    void queueTextureGrid() {
+        VkPipeline texturedPipeline = findReadyPipeline(texturedPipelineDesc);
+        if (texturedPipeline == VK_NULL_HANDLE) {
+            return;
+        }
+        DrawItem item;
+        item.pipeline = texturedPipeline;
+        item.vertexBuffer = textureQuadBuffer;
+        item.count = 6;
+        item.usesDrawData = false;
+        uint32_t textureCount = static_cast<uint32_t>(streamedTextures.size());
+        uint32_t slots = std::min(TEXTURE_GRID_COLUMNS * TEXTURE_GRID_ROWS, textureCount);
+        for (uint32_t slot = 0; slot < slots; slot++) {
+            const StreamedTexture& texture = streamedTextures[(textureGridStart + slot) % textureCount];
+            // still loading
+            if (texture.descriptorSet == VK_NULL_HANDLE) {
+                continue;
+            }
+            item.texture = &texture;
+            item.first = slot * 6;
+            queueDraw(DrawLayer::Opaque, 0.0f, item);
+        }
+    }
+
+    void destroyRetiredTextures(bool all = false) {
+        for (auto it = retiredTextureResources.begin(); it != retiredTextureResources.end();) {
+            if (!all && frameNumber < it->retiredFrame + MAX_FRAMES_IN_FLIGHT) {
+                it++;
+                continue;
+            }
+            if (it->descriptorSet != VK_NULL_HANDLE) {
+                vkFreeDescriptorSets(device, textureDescriptorPool, 1, &it->descriptorSet);
+                resourceStats.destroyed(ResourceKind::DescriptorSet);
+            }
+            vkDestroyImageView(device, it->view, nullptr);
+            destroyImage(it->image);
+            freeMemory(it->memory);
+            destroyBuffer(it->buffer);
+            freeMemory(it->bufferMemory);
+            it = retiredTextureResources.erase(it);
+        }
+    }
+
+    void destroyTextureStreaming() {
+        if (!texturesEnabled) {
+            return;
+        }
+        // decodes still running would otherwise outlive the pool's other users
+        for (auto& texture : streamedTextures) {
+            if (texture.pending.valid()) {
+                texture.pending.wait();
+            }
+            if (texture.image != VK_NULL_HANDLE) {
+                retiredTextureResources.push_back({texture.image, texture.memory, texture.view, texture.descriptorSet,
+                                                   VK_NULL_HANDLE, VK_NULL_HANDLE, frameNumber});
+            }
+        }
+        destroyRetiredTextures(true);
+        // the sets were freed with their textures, this is just the pool
+        vkDestroyDescriptorPool(device, textureDescriptorPool, nullptr);
+        vkDestroySampler(device, textureSampler, nullptr);
+        destroyBuffer(textureQuadBuffer);
+        freeMemory(textureQuadBufferMemory);
+    }
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+        if (auto memoryType = tryFindMemoryType(typeFilter, properties)) {
+            return *memoryType;
+        }
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    // same as findMemoryType, for when the caller has a plan B
+    std::optional<uint32_t> tryFindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return i;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // everything that makes or destroys buffers, images and device memory goes through these, so resourceStats always
+    // knows what's alive. the destroy ones take null handles like the vkDestroy* functions do
+    VkResult allocateMemory(const VkMemoryAllocateInfo* allocInfo, VkDeviceMemory* memory) {
+        VkResult res = vkAllocateMemory(device, allocInfo, nullptr, memory);
+        if (res == VK_SUCCESS) {
+            resourceStats.allocated(*memory, allocInfo->memoryTypeIndex, allocInfo->allocationSize);
+        }
+        return res;
+    }
+
+    void freeMemory(VkDeviceMemory memory) {
+        resourceStats.freed(memory);
+        vkFreeMemory(device, memory, nullptr);
+    }
+
+    VkResult createBuffer(const VkBufferCreateInfo* bufferInfo, VkBuffer* buffer) {
+        // a recorded frame copies its buffers out, whatever they were made for
+        VkBufferCreateInfo info = *bufferInfo;
+        if (options.recordFile) {
+            info.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        }
+        VkResult res = vkCreateBuffer(device, &info, nullptr, buffer);
+        if (res == VK_SUCCESS) {
+            resourceStats.created(ResourceKind::Buffer);
+            if (options.recordFile) {
+                bufferSizes[*buffer] = info.size;
+            }
+        }
+        return res;
+    }
+
+    void destroyBuffer(VkBuffer buffer) {
+        if (buffer != VK_NULL_HANDLE) {
+            resourceStats.destroyed(ResourceKind::Buffer);
+            bufferSizes.erase(buffer);
+            vkDestroyBuffer(device, buffer, nullptr);
+        }
+    }
+
+    VkResult createImage(const VkImageCreateInfo* imageInfo, VkImage* image) {
+        VkResult res = vkCreateImage(device, imageInfo, nullptr, image);
+        if (res == VK_SUCCESS) {
+            resourceStats.created(ResourceKind::Image);
+        }
+        return res;
+    }
+
+    void destroyImage(VkImage image) {
+        if (image != VK_NULL_HANDLE) {
+            resourceStats.destroyed(ResourceKind::Image);
+            vkDestroyImage(device, image, nullptr);
+        }
+    }
+
+    void destroyPipeline(VkPipeline pipeline) {
+        if (pipeline != VK_NULL_HANDLE) {
+            resourceStats.destroyed(ResourceKind::Pipeline);
+            vkDestroyPipeline(device, pipeline, nullptr);
+        }
+    }
+
+    void printMemoryReport(const MemoryReport& report) const {
+        printf("Memory:");
+        for (size_t i = 0; i < report.heaps.size(); i++) {
+            const HeapReport& heap = report.heaps[i];
+            printf(" heap %zu%s %.1f of %.1f MiB (%.0f%%, %llu allocations)%s", i, heap.deviceLocal ? " (device local)" : "",
+                   double(heap.usage) / (1 << 20), double(heap.budget) / (1 << 20),
+                   heap.budget > 0 ? 100.0 * double(heap.usage) / double(heap.budget) : 0.0,
+                   (unsigned long long) heap.allocations, i + 1 < report.heaps.size() ? "," : "\n");
+        }
+        printf("  by memory type:");
+        for (size_t i = 0; i < report.memoryTypes.size(); i++) {
+            if (report.memoryTypes[i].allocations > 0) {
+                printf(" [%zu] %llu (%.1f MiB)", i, (unsigned long long) report.memoryTypes[i].allocations,
+                       double(report.memoryTypes[i].bytes) / (1 << 20));
+            }
+        }
+        printf("\n  alive:");
+        for (size_t kind = 0; kind < report.objects.size(); kind++) {
+            printf(" %llu %s%s", (unsigned long long) report.objects[kind], resourceKindName(static_cast<ResourceKind>(kind)),
+                   kind + 1 < report.objects.size() ? "," : "\n");
+        }
+    }
+
+    // called every frame: logs the report every few seconds and warns (quiet or not) as soon as a heap gets close to
+    // its budget. past the budget the driver starts paging our memory out, or allocations simply fail
+    void pollMemoryReport() {
+        auto now = Clock::now();
+        bool logDue = options.memoryReportSeconds > 0 && now - lastMemoryLog >= std::chrono::seconds(options.memoryReportSeconds);
+        // the budget query isn't free (the driver may ask the OS), so don't do it every frame
+        if (!logDue && now - lastBudgetCheck < std::chrono::seconds(1)) {
+            return;
+        }
+        // the pollable side of the memory stats: driver heap usage and budgets next to our own counts
+        queryMemoryReport(physicalDevice, memoryBudgetEnabled, resourceStats, memoryReport);
+        const MemoryReport& report = memoryReport;
+        heapsNearBudget.resize(report.heaps.size(), false);
+        for (size_t i = 0; i < report.heaps.size(); i++) {
+            const HeapReport& heap = report.heaps[i];
+            bool nearBudget = heap.budget > 0 && double(heap.usage) >= MEMORY_BUDGET_WARNING * double(heap.budget);
+            if (nearBudget && !heapsNearBudget[i]) {
+                printf("Warning: memory heap %zu is at %.1f of its %.1f MiB budget\n", i, double(heap.usage) / (1 << 20),
+                       double(heap.budget) / (1 << 20));
+            }
+            heapsNearBudget[i] = nearBudget;
+        }
+        if (logDue) {
+            if (!options.quiet) {
+                printMemoryReport(report);
+            }
+            lastMemoryLog = now;
+        }
+        lastBudgetCheck = now;
+    }
+
+    // how many times the heap got hit per frame since the last report. the render thread is the one that matters, the
+    // workers' count includes pipeline compiles and texture decodes, which allocate as much as they like
+    void pollAllocationReport() {
+        auto now = Clock::now();
+        if (now - lastAllocationReport < std::chrono::seconds(2)) {
+            return;
+        }
+        uint64_t renderThread = threadHeapAllocationCount();
+        uint64_t all = heapAllocationCount();
+        double frames = double(std::max<uint64_t>(frameNumber - framesAtAllocationReport, 1));
+        if (!options.quiet) {
+            printf("Heap allocations: %.2f per frame on the render thread, %.2f on all threads, frame arena %.1f of %.1f KiB "
+                   "(%llu overflows)\n", (renderThread - renderThreadAllocationsAtReport) / frames, (all - allAllocationsAtReport) / frames,
+                   frameArenaPeakBytes / 1024.0, frameArenas.arena().capacity() / 1024.0,
+                   (unsigned long long) frameArenas.overflowCount());
+        }
+        frameArenaPeakBytes = 0;
+        renderThreadAllocationsAtReport = renderThread;
+        allAllocationsAtReport = all;
+        framesAtAllocationReport = frameNumber;
+        lastAllocationReport = now;
+    }
+
+    // called as a frame ends. --check-allocations starts counting after the warm up and closes the window once it has
+    // seen enough frames
+    void advanceAllocationCheck() {
+        frameArenaPeakBytes = std::max(frameArenaPeakBytes, frameArenas.bytesUsed());
+        if (options.checkAllocationFrames == 0) {
+            return;
+        }
+        if (frameNumber + 1 == ALLOCATION_CHECK_WARMUP_FRAMES) {
+            allocationCheckStart = threadHeapAllocationCount();
+        } else if (frameNumber + 1 == ALLOCATION_CHECK_WARMUP_FRAMES + options.checkAllocationFrames) {
+            checkedAllocations = threadHeapAllocationCount() - allocationCheckStart;
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+        }
+    }
+
+    void finishAllocationCheck() {
+        if (!checkedAllocations) {
+            throw std::runtime_error("the window was closed before --check-allocations got through its frames");
+        }
+        if (*checkedAllocations != 0) {
+            throw std::runtime_error("the render thread made " + std::to_string(*checkedAllocations) + " heap allocations in "
+                                     + std::to_string(options.checkAllocationFrames) + " warmed up frames");
+        }
+        printf("No heap allocations on the render thread in %llu warmed up frames\n",
+               (unsigned long long) options.checkAllocationFrames);
+    }
+
+    // sets up the readback ring and the writers for capture mode
+    void createCaptureResources() {
+        if (!captureEnabled) {
+            return;
+        }
+        std::filesystem::create_directories(*options.captureDirectory);
+
+        VkDeviceSize frameSize = VkDeviceSize(swapChainExtent.width) * swapChainExtent.height * 4;
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT + EXTRA_READBACK_SLOTS; i++) {
+            auto slot = std::make_unique<ReadbackSlot>();
+
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = frameSize;
+            bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            if (createBuffer(&bufferInfo, &slot->buffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create readback buffer!");
+            }
+
+            VkMemoryRequirements memRequirements;
+            vkGetBufferMemoryRequirements(device, slot->buffer, &memRequirements);
+
+            // the CPU reads every byte of these, and reading uncached (write combined) memory is painfully slow, so
+            // cached memory is worth having to invalidate it ourselves
+            auto memoryType = tryFindMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+            readbackMemoryCoherent = !memoryType;
+            if (!memoryType) {
+                memoryType = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            } else {
+                VkPhysicalDeviceMemoryProperties memProperties;
+                vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+                readbackMemoryCoherent = memProperties.memoryTypes[*memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            }
+
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = memRequirements.size;
+            allocInfo.memoryTypeIndex = *memoryType;
+            VkResult res;
+            if ((res = allocateMemory(&allocInfo, &slot->memory)) != VK_SUCCESS) {
+                printf("Failed to allocate readback memory (VkResult: %d)\n", res);
+                throw std::runtime_error("failed to allocate readback memory!");
+            }
+            vkBindBufferMemory(device, slot->buffer, slot->memory, 0);
+
+            void* data;
+            vkMapMemory(device, slot->memory, 0, VK_WHOLE_SIZE, 0, &data);
+            slot->pixels = static_cast<const uint8_t*>(data);
+            readbackSlots.push_back(std::move(slot));
+        }
+
+        captureWorkers = std::make_unique<ThreadPool>();
+        if (options.captureFormat == CaptureFormat::Raw) {
+            bool bgra = swapChainImageFormat == VK_FORMAT_B8G8R8A8_SRGB || swapChainImageFormat == VK_FORMAT_B8G8R8A8_UNORM;
+            std::string path = *options.captureDirectory + "/capture.raw";
+            rawVideoWriter = std::make_unique<RawVideoWriter>(path, static_cast<size_t>(frameSize));
+            printf("Capturing to %s, encode with:\n  ffmpeg -f rawvideo -pixel_format %s -video_size %ux%u -i %s capture.mp4\n",
+                   path.c_str(), bgra ? "bgra" : "rgba", swapChainExtent.width, swapChainExtent.height, path.c_str());
+        } else {
+            printf("Capturing frames to %s\n", options.captureDirectory->c_str());
+        }
+    }
+
+    // grabs a free readback slot for the frame about to be recorded. if the encoders have fallen so far behind that
+    // every slot is taken, the frame is left out of the capture: we never wait on them
+    void beginFrameReadback() {
+        currentReadback = nullptr;
+        if (!captureEnabled) {
+            return;
+        }
+        for (auto& slot : readbackSlots) {
+            // acquire pairs with the worker's release, so its reads of the pixels are done before we overwrite them
+            if (slot->state.load(std::memory_order_acquire) == ReadbackState::Free) {
+                slot->state.store(ReadbackState::Copying, std::memory_order_relaxed);
+                slot->submittedFrame = frameNumber;
+                slot->captureIndex = capturedFrames++;
+                currentReadback = slot.get();
+                return;
+            }
+        }
+        droppedCaptureFrames++;
+    }
+
+    // copies the swapchain image into this frame's readback buffer. runs after the render pass, which has left the
+    // image in PRESENT_SRC, so we borrow it as a transfer source and put it back
+    void recordFrameReadback(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        VkImageMemoryBarrier toTransfer{};
+        toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        toTransfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        toTransfer.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toTransfer.image = swapChainImages[imageIndex];
+        toTransfer.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+        // tightly packed, so the writers can treat the buffer as width * height pixels
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {swapChainExtent.width, swapChainExtent.height, 1};
+        vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               currentReadback->buffer, 1, &region);
+
+        // back to presentable, and make the copy visible to the host once the frame's fence signals
+        VkImageMemoryBarrier toPresent = toTransfer;
+        toPresent.srcAccessMask = 0;
+        toPresent.dstAccessMask = 0;
+        toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        toPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+        VkBufferMemoryBarrier toHost{};
+        toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toHost.buffer = currentReadback->buffer;
+        toHost.offset = 0;
+        toHost.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, 1, &toHost, 1, &toPresent);
+    }
+
+    // hands every readback whose frame the GPU has finished to a capture worker. we've just waited on the fence of the
+    // frame MAX_FRAMES_IN_FLIGHT back, so that frame and everything before it is done (or everything, once idle)
+    void collectFrameReadbacks(bool all = false) {
+        for (auto& slot : readbackSlots) {
+            if (slot->state.load(std::memory_order_relaxed) != ReadbackState::Copying) {
+                continue;
+            }
+            if (!all && slot->submittedFrame + MAX_FRAMES_IN_FLIGHT > frameNumber) {
+                continue;
+            }
+            if (!readbackMemoryCoherent) {
+                VkMappedMemoryRange range{};
+                range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+                range.memory = slot->memory;
+                range.offset = 0;
+                range.size = VK_WHOLE_SIZE;
+                vkInvalidateMappedMemoryRanges(device, 1, &range);
+            }
+            slot->state.store(ReadbackState::Encoding, std::memory_order_relaxed);
+
+            ReadbackSlot* readback = slot.get();
+            captureWorkers->submit([this, readback] {
+                try {
+                    if (rawVideoWriter) {
+                        rawVideoWriter->writeFrame(readback->captureIndex, readback->pixels);
+                    } else {
+                        char name[32];
+                        snprintf(name, sizeof(name), "/frame_%06llu.png", (unsigned long long) readback->captureIndex);
+                        bool bgra = swapChainImageFormat == VK_FORMAT_B8G8R8A8_SRGB || swapChainImageFormat == VK_FORMAT_B8G8R8A8_UNORM;
+                        writePng(*options.captureDirectory + name, swapChainExtent.width, swapChainExtent.height,
+                                 readback->pixels, bgra);
+                    }
+                } catch (const std::exception& e) {
+                    printf("Failed to write captured frame %llu: %s\n", (unsigned long long) readback->captureIndex, e.what());
+                }
+                readback->state.store(ReadbackState::Free, std::memory_order_release);
+            });
+        }
+    }
+
+    void destroyCaptureResources() {
+        if (!captureEnabled) {
+            return;
+        }
+        // the device is idle by now, so whatever is still in a readback buffer is complete and gets written out
+        collectFrameReadbacks(true);
+        // waits for the encoders to finish everything queued
+        captureWorkers.reset();
+        rawVideoWriter.reset();
+        for (auto& slot : readbackSlots) {
+            vkUnmapMemory(device, slot->memory);
+            destroyBuffer(slot->buffer);
+            freeMemory(slot->memory);
+        }
+        readbackSlots.clear();
+        printf("Captured %llu frames, dropped %llu\n", (unsigned long long) capturedFrames, (unsigned long long) droppedCaptureFrames);
+    }
+
+    void createCommandBuffers() {
+        // one command buffer per frame in flight. they're re-recorded every frame, which is what lets us pick up newly
+        // compiled pipeline variants (or anything else that changes) without stalling
+        commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+
+        // telling the command pool to create N buffers and how to do so
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = (uint32_t) commandBuffers.size();
+
+        if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+    }
+
+    // starts rendering into the swapchain image, through whichever of the two paths the device was set up for. the
+    // draws recorded in between don't care which one it was
+    void beginMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        // clear the framebuffer before rendering to it, depth to the far plane
+        std::array<VkClearValue, 2> clearValues{};
+        clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+        clearValues[1].depthStencil = {1.0f, 0};
+        bool multisampled = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+
+        // for split frame rendering every GPU gets a vertical strip of the image as its render area
+        VkDeviceGroupRenderPassBeginInfo deviceGroupRenderPassInfo{};
+        std::array<VkRect2D, VK_MAX_DEVICE_GROUP_SIZE> deviceRenderAreas{};
+        if (!deviceGroupDevices.empty()) {
+            deviceGroupRenderPassInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_RENDER_PASS_BEGIN_INFO;
+            deviceGroupRenderPassInfo.deviceMask = currentDeviceMask;
+            if (deviceGroupMode == DeviceGroupMode::Split) {
+                uint32_t deviceCount = static_cast<uint32_t>(deviceGroupDevices.size());
+                uint32_t stripWidth = (swapChainExtent.width + deviceCount - 1) / deviceCount;
+                for (uint32_t i = 0; i < deviceCount; i++) {
+                    uint32_t x = std::min(i * stripWidth, swapChainExtent.width);
+                    deviceRenderAreas[i].offset = {static_cast<int32_t>(x), 0};
+                    deviceRenderAreas[i].extent = {std::min(stripWidth, swapChainExtent.width - x), swapChainExtent.height};
+                }
+                deviceGroupRenderPassInfo.deviceRenderAreaCount = deviceCount;
+                deviceGroupRenderPassInfo.pDeviceRenderAreas = deviceRenderAreas.data();
+            }
+        }
+
+        if (dynamicRenderingEnabled) {
+            // the render pass used to do the layout transitions, now they're ours. the swapchain image can't be written
+            // before the acquire semaphore, which the submit waits on at the color attachment output stage. the depth
+            // and MSAA images are shared by the frames in flight, so writing them also waits for the last frame's
+            // writes
+            std::array<VkImageMemoryBarrier, 3> barriers{};
+            for (auto& barrier : barriers) {
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            }
+            barriers[0].srcAccessMask = 0;
+            barriers[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            barriers[0].image = swapChainImages[imageIndex];
+            barriers[0].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            barriers[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            barriers[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            barriers[1].image = depthTarget.image;
+            barriers[1].subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+            if (depthFormat == VK_FORMAT_D24_UNORM_S8_UINT) {
+                barriers[1].subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+            }
+            barriers[2] = barriers[0];
+            barriers[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            barriers[2].image = msaaColorTarget.image;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+                                 0, 0, nullptr, 0, nullptr, multisampled ? 3 : 2, barriers.data());
+
+            // with MSAA the samples are rendered into the transient target and averaged into the swapchain image
+            VkRenderingAttachmentInfoKHR colorAttachment{};
+            colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+            colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            colorAttachment.clearValue = clearValues[0];
+            if (multisampled) {
+                colorAttachment.imageView = msaaColorTarget.view;
+                colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+                colorAttachment.resolveImageView = swapChainImageViews[imageIndex];
+                colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            } else {
+                colorAttachment.imageView = swapChainImageViews[imageIndex];
+                colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            }
+
+            VkRenderingAttachmentInfoKHR depthAttachment{};
+            depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+            depthAttachment.imageView = depthTarget.view;
+            depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depthAttachment.clearValue = clearValues[1];
+
+            VkRenderingInfoKHR renderingInfo{};
+            renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+            renderingInfo.renderArea.offset = {0, 0};
+            renderingInfo.renderArea.extent = swapChainExtent;
+            renderingInfo.layerCount = 1;
+            renderingInfo.colorAttachmentCount = 1;
+            renderingInfo.pColorAttachments = &colorAttachment;
+            renderingInfo.pDepthAttachment = &depthAttachment;
+            if (!deviceGroupDevices.empty()) {
+                renderingInfo.pNext = &deviceGroupRenderPassInfo;
+            }
+            cmdBeginRendering(commandBuffer, &renderingInfo);
+            return;
+        }
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        // specify which of the framebuffers we want to actually write to
+        renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = swapChainExtent;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+        if (!deviceGroupDevices.empty()) {
+            renderPassInfo.pNext = &deviceGroupRenderPassInfo;
+        }
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
+
+    // leaves the swapchain image ready to present (or to be copied out by the frame capture first)
+    void endMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        if (!dynamicRenderingEnabled) {
+            vkCmdEndRenderPass(commandBuffer);
+            return;
+        }
+        cmdEndRendering(commandBuffer);
+        // waits at color attachment output rather than bottom of pipe, so the capture's barrier (which waits on that
+        // stage) is ordered after the transition
+        VkImageMemoryBarrier toPresent{};
+        toPresent.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        toPresent.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        toPresent.dstAccessMask = 0;
+        toPresent.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        toPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        toPresent.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toPresent.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toPresent.image = swapChainImages[imageIndex];
+        toPresent.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr, 1, &toPresent);
+    }
+
+    void queueDraw(DrawLayer layer, float depth, const DrawItem& item) {
+        uint32_t vertexBufferId = drawBufferIds.id(item.vertexBuffer);
+        uint32_t setId = item.texture != nullptr ? drawSetIds.id(item.texture->descriptorSet) : 0;
+        uint64_t key = DrawKey::make(layer, drawPipelineIds.id(item.pipeline), setId, vertexBufferId, depth);
+        drawOrder.push_back({key, static_cast<uint32_t>(frameDraws.size())});
+        frameDraws.push_back(item);
+    }
+
+    // sorts the queued draws and records them, leaving out every bind that would just repeat what's already bound
+    void recordSortedDraws(VkCommandBuffer commandBuffer) {
+        auto start = Clock::now();
+        drawSorter.sort(drawOrder, &workerPool);
+        drawSortMsTotal += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        drawSortFrames++;
+
+        VkPipeline boundPipeline = VK_NULL_HANDLE;
+        const StreamedTexture* boundTexture = nullptr;
+        VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+        VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+        for (const DrawSortEntry& entry : drawOrder) {
+            const DrawItem& item = frameDraws[entry.draw];
+            drawBindStats.draws++;
+            if (item.pipeline != boundPipeline) {
+                bindGraphicsPipeline(commandBuffer, item.pipeline);
+                boundPipeline = item.pipeline;
+                drawBindStats.pipelineBinds++;
+            }
+            if (item.texture != nullptr) {
+                drawBindStats.setDraws++;
+                if (item.texture != boundTexture) {
+                    bindTexture(commandBuffer, *item.texture);
+                    boundTexture = item.texture;
+                    drawBindStats.setBinds++;
+                }
+            }
+            if (item.vertexBuffer != boundVertexBuffer) {
+                bindVertexBuffer(commandBuffer, item.vertexBuffer);
+                boundVertexBuffer = item.vertexBuffer;
+                drawBindStats.vertexBufferBinds++;
+            }
+            uint32_t instance = item.usesDrawData ? setDrawData(commandBuffer, item.data) : 0;
+            if (item.indexBuffer != VK_NULL_HANDLE) {
+                drawBindStats.indexedDraws++;
+                if (item.indexBuffer != boundIndexBuffer) {
+                    bindIndexBuffer(commandBuffer, item.indexBuffer, 0, item.indexType);
+                    boundIndexBuffer = item.indexBuffer;
+                    drawBindStats.indexBufferBinds++;
+                }
+                drawIndexed(commandBuffer, item.count, 1, item.first, 0, instance);
+            } else {
+                draw(commandBuffer, item.count, 1, item.first, instance);
+            }
+        }
+        frameDraws.clear();
+        drawOrder.clear();
+        drawPipelineIds.clear();
+        drawSetIds.clear();
+        drawBufferIds.clear();
+
+        auto now = Clock::now();
+        if (now - lastDrawReport >= std::chrono::seconds(2)) {
+            if (!options.quiet && drawSortFrames > 0) {
+                const DrawBindStats& s = drawBindStats;
+                double frames = drawSortFrames;
+                printf("Draws: %.1f per frame, sorted in %.3f ms, %.1f binds saved per frame (pipelines %.1f of %.1f, "
+                       "textures %.1f of %.1f, vertex buffers %.1f of %.1f, index buffers %.1f of %.1f)\n",
+                       s.draws / frames, drawSortMsTotal / frames, s.bindsSaved() / frames, s.pipelineBinds / frames,
+                       s.draws / frames, s.setBinds / frames, s.setDraws / frames, s.vertexBufferBinds / frames, s.draws / frames,
+                       s.indexBufferBinds / frames, s.indexedDraws / frames);
+            }
+            drawBindStats = DrawBindStats{};
+            drawSortMsTotal = 0.0;
+            drawSortFrames = 0;
+            lastDrawReport = now;
+        }
+    }
+
+    // the commands of the main pass go through these, so a frame being recorded for replay sees every one of them
+    void bindGraphicsPipeline(VkCommandBuffer commandBuffer, VkPipeline pipeline) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        if (frameRecorder) {
+            uint32_t id = frameRecorder->pipelineId(CommandStreamRecorder::handleKey(pipeline), [&] { return describePipeline(pipeline); });
+            frameRecorder->command(StreamOp::BindPipeline, {id});
+        }
+    }
+
+    void bindVertexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset = 0) {
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffer, &offset);
+        if (frameRecorder) {
+            frameRecorder->command(StreamOp::BindVertexBuffer, {recordedBufferId(buffer), uint32_t(offset), uint32_t(offset >> 32)});
+        }
+    }
+
+    void bindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType) {
+        vkCmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
+        if (frameRecorder) {
+            frameRecorder->command(StreamOp::BindIndexBuffer, {recordedBufferId(buffer), uint32_t(offset), uint32_t(offset >> 32),
+                                                               static_cast<uint32_t>(indexType)});
+        }
+    }
+
+    void bindTexture(VkCommandBuffer commandBuffer, const StreamedTexture& texture) {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &texture.descriptorSet, 0, nullptr);
+        if (!frameRecorder) {
+            return;
+        }
+        // the image holds source levels [baseLevel, levelCount), and the source is still around to copy them from
+        uint32_t id = frameRecorder->imageId(CommandStreamRecorder::handleKey(texture.image), [&] {
+            const TextureSource& source = *texture.source;
+            StreamImage image;
+            image.format = vulkanFormat(source.format());
+            image.width = source.width(texture.baseLevel);
+            image.height = source.height(texture.baseLevel);
+            std::vector<uint8_t> contents;
+            for (uint32_t level = texture.baseLevel; level < source.levelCount(); level++) {
+                ByteView data = source.level(level);
+                image.levelSizes.push_back(data.size);
+                contents.insert(contents.end(), data.data, data.data + data.size);
+            }
+            image.blob = frameRecorder->addBlob(contents.data(), contents.size());
+            return image;
+        });
+        frameRecorder->command(StreamOp::BindTexture, {id});
+    }
+
+    void setViewport(VkCommandBuffer commandBuffer, const VkViewport& viewport) {
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        if (frameRecorder) {
+            frameRecorder->command(StreamOp::SetViewport, {CommandStreamRecorder::floatBits(viewport.x), CommandStreamRecorder::floatBits(viewport.y),
+                                                           CommandStreamRecorder::floatBits(viewport.width), CommandStreamRecorder::floatBits(viewport.height),
+                                                           CommandStreamRecorder::floatBits(viewport.minDepth), CommandStreamRecorder::floatBits(viewport.maxDepth)});
+        }
+    }
+
+    void setScissor(VkCommandBuffer commandBuffer, const VkRect2D& scissor) {
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        if (frameRecorder) {
+            frameRecorder->command(StreamOp::SetScissor, {uint32_t(scissor.offset.x), uint32_t(scissor.offset.y), scissor.extent.width,
+                                                          scissor.extent.height});
+        }
+    }
+
+    void draw(VkCommandBuffer commandBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
+        vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+        if (frameRecorder) {
+            frameRecorder->command(StreamOp::Draw, {vertexCount, instanceCount, firstVertex, firstInstance});
+        }
+    }
+
+    void drawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset,
+                     uint32_t firstInstance) {
+        vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+        if (frameRecorder) {
+            frameRecorder->command(StreamOp::DrawIndexed, {indexCount, instanceCount, firstIndex, uint32_t(vertexOffset), firstInstance});
+        }
+    }
+
+    // buffer contents are only known once the frame has run, so they're read back by finishFrameRecording()
+    uint32_t recordedBufferId(VkBuffer buffer) {
+        return frameRecorder->bufferId(CommandStreamRecorder::handleKey(buffer), [&] {
+            recordedBuffers.push_back(buffer);
+            return StreamBuffer{};
+        });
+    }
+
+    // a library pipeline's description, turned into plain values with the shader code it was built from copied in
+    StreamPipeline describePipeline(VkPipeline pipeline) {
+        for (const auto& entry : pipelineLibrary) {
+            if (entry.second.pipeline != pipeline) {
+                continue;
+            }
+            const PipelineStateDesc& desc = entry.second.desc;
+            StreamPipeline out;
+            out.vertShader = frameRecorder->addBlob(entry.second.vertCode.data(), entry.second.vertCode.size());
+            out.fragShader = frameRecorder->addBlob(entry.second.fragCode.data(), entry.second.fragCode.size());
+            out.topology = desc.topology;
+            out.cullMode = desc.cullMode;
+            out.frontFace = desc.frontFace;
+            out.blendEnable = desc.blendEnable;
+            out.colorWrite = desc.colorWrite;
+            out.depthTest = desc.depthTest;
+            out.depthWrite = desc.depthWrite;
+            out.depthCompareOp = desc.depthCompareOp;
+            VkVertexInputBindingDescription binding{};
+            std::array<VkVertexInputAttributeDescription, 2> attributes{};
+            getVertexInput(desc.vertexLayout, binding, attributes);
+            out.vertexStride = binding.stride;
+            for (const auto& attribute : attributes) {
+                out.attributes.push_back({attribute.location, attribute.format, attribute.offset});
+            }
+            // drawDataInBuffer is always off, the replay pushes every draw's data whichever path it was recorded with
+            out.specialization = {desc.specialization.featureFlags, CommandStreamRecorder::floatBits(desc.specialization.alpha), VK_FALSE};
+            return out;
+        }
+        throw std::runtime_error("recorded a pipeline that isn't in the pipeline library");
+    }
+
+    // with --record-frame, starts recording the frame about to be recorded if it's the one asked for (or F12 was hit)
+    void beginFrameRecording() {
+        if (!options.recordFile || (frameNumber != options.recordFrame && !frameRecordRequested)) {
+            return;
+        }
+        frameRecordRequested = false;
+        frameRecorder = std::make_unique<CommandStreamRecorder>();
+        recordedBuffers.clear();
+        CommandStream& stream = frameRecorder->stream;
+        stream.width = swapChainExtent.width;
+        stream.height = swapChainExtent.height;
+        stream.colorFormat = swapChainImageFormat;
+        stream.depthFormat = depthFormat;
+        stream.samples = static_cast<uint32_t>(msaaSamples);
+    }
+
+    // the buffers a recorded frame drew from only hold what it saw once it has run (the particles are simulated in
+    // the same command buffer), so that's when they get copied out. this stalls, but only for the one frame
+    void finishFrameRecording() {
+        if (!frameRecorder) {
+            return;
+        }
+        vkQueueWaitIdle(graphicsQueue);
+        for (size_t id = 0; id < recordedBuffers.size(); id++) {
+            VkBuffer buffer = recordedBuffers[id];
+            VkDeviceSize size = bufferSizes.at(buffer);
+            VkBuffer stagingBuffer;
+            VkDeviceMemory stagingBufferMemory;
+            void* data = createMappedBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, stagingBuffer, stagingBufferMemory);
+            runOneTimeCommands([&](VkCommandBuffer commandBuffer) {
+                VkBufferCopy copy{};
+                copy.size = size;
+                vkCmdCopyBuffer(commandBuffer, buffer, stagingBuffer, 1, &copy);
+            });
+            frameRecorder->stream.buffers[id].blob = frameRecorder->addBlob(data, size);
+            vkUnmapMemory(device, stagingBufferMemory);
+            destroyBuffer(stagingBuffer);
+            freeMemory(stagingBufferMemory);
+        }
+
+        const CommandStream& stream = frameRecorder->stream;
+        uint64_t bytes = 0;
+        for (const auto& blob : stream.blobs) {
+            bytes += blob.size();
+        }
+        try {
+            writeCommandStream(*options.recordFile, stream);
+            printf("Recorded frame %llu into %s: %zu commands, %zu pipelines, %zu buffers, %zu images, %.1f MiB of data\n",
+                   (unsigned long long) frameNumber, options.recordFile->c_str(), stream.commands.size(), stream.pipelines.size(),
+                   stream.buffers.size(), stream.images.size(), double(bytes) / (1 << 20));
+        } catch (const std::exception& e) {
+            printf("Failed to record frame: %s\n", e.what());
+        }
+        frameRecorder.reset();
+        recordedBuffers.clear();
+    }
+
+    // records what a frame does into the given command buffer, targeting the given swapchain image
+    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        // we re-record it every frame anyway
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        // the commands only execute on the GPUs picked for this frame
+        VkDeviceGroupCommandBufferBeginInfo deviceGroupBeginInfo{};
+        if (!deviceGroupDevices.empty()) {
+            deviceGroupBeginInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_COMMAND_BUFFER_BEGIN_INFO;
+            deviceGroupBeginInfo.deviceMask = currentDeviceMask;
+            beginInfo.pNext = &deviceGroupBeginInfo;
+        }
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer");
+        }
+
+        if (particlesEnabled) {
+            recordParticleSimulation(commandBuffer);
+        }
+        recordTextureRebuilds(commandBuffer);
+
+        beginMainPass(commandBuffer, imageIndex);
+        beginDrawData(commandBuffer);
+
+        // we are drawing to the entire framebuffer so that's why we set it to the whole width/height
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = (float) swapChainExtent.width;
+        viewport.height = (float) swapChainExtent.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        setViewport(commandBuffer, viewport);
+
+        // we want to draw to the entire framebuffer, so we use its extents (if we wanted to have some UI at the bottom
+        // we could scissor those out and save efficiency
+        VkRect2D scissor{};
+        scissor.offset = {0, 0};
+        scissor.extent = swapChainExtent;
+        setScissor(commandBuffer, scissor);
+
+        vkCmdSetLineWidth(commandBuffer, 1.0f);
+
+        // the main pass' draws are only queued here, recordSortedDraws() records them in draw key order. the triangle
+        // and particles are in the overlay layer, so they still end up on top of the LOD mesh, the scene and the textures
+        if (lodMeshReady) {
+            queueLodMesh();
+        }
+        if (options.sceneObjectCount > 0) {
+            queueScene();
+        }
+        if (texturesEnabled) {
+            queueTextureGrid();
+        }
+
+        DrawItem triangle;
+        triangle.pipeline = getPipeline(pipelineVariants[activePipelineVariant]);
+        triangle.vertexBuffer = vertexBuffer;
+        triangle.count = static_cast<uint32_t>(vertices.size());
+        queueDraw(DrawLayer::Overlay, 0.0f, triangle);
+
+        if (particlesEnabled) {
+            // the fallback reads Vertex data, so nothing is drawn until the point pipeline has compiled
+            VkPipeline pointPipeline = findReadyPipeline(particlePipelineDesc);
+            if (pointPipeline != VK_NULL_HANDLE) {
+                DrawItem particles;
+                particles.pipeline = pointPipeline;
+                particles.vertexBuffer = particleBuffer;
+                particles.count = options.particleCount;
+                queueDraw(DrawLayer::Overlay, 0.0f, particles);
+            }
+        }
+
+        recordSortedDraws(commandBuffer);
+
+        endMainPass(commandBuffer, imageIndex);
+
+        if (currentReadback != nullptr) {
+            recordFrameReadback(commandBuffer, imageIndex);
+        }
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+    }
+
+    void createSyncObjects() {
+        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+        imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+                vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
+                vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+
+                throw std::runtime_error("failed to create synchronization objects for a frame!");
+            }
+        }
+    }
+
+    // averages the time spent recording a frame (and between frames) once things have settled, then leaves timing
+    // what rebuilding for a new swapchain costs to finishRenderBenchmark(). run it once with and once without
+    // --dynamic-rendering to compare the two
+    void advanceRenderBenchmark(double recordSeconds) {
+        if (!firstFramePresented || renderBenchmarkFrame >= BENCHMARK_FRAMES) {
+            return;
+        }
+        uint64_t frame = renderBenchmarkFrame++;
+        if (frame < BENCHMARK_WARMUP_FRAMES) {
+            return;
+        }
+        if (frame == BENCHMARK_WARMUP_FRAMES) {
+            renderBenchmarkStart = Clock::now();
+            renderBenchmarkRecordSeconds = 0.0;
+        }
+        renderBenchmarkRecordSeconds += recordSeconds;
+        if (renderBenchmarkFrame < BENCHMARK_FRAMES) {
+            return;
+        }
+
+        renderBenchmarkFrameSeconds = std::chrono::duration<double>(Clock::now() - renderBenchmarkStart).count()
+                / double(BENCHMARK_FRAMES - BENCHMARK_WARMUP_FRAMES);
+        renderBenchmarkRebuildPending = true;
+    }
+
+    // times rebuilding what's tied to the swapchain images and prints the report. this frame's command buffer is
+    // already recorded (and about to be submitted) when the benchmark finishes, so this runs at the start of the next
+    // frame instead, before anything gets recorded against the objects it destroys
+    void finishRenderBenchmark() {
+        renderBenchmarkRebuildPending = false;
+        // the render targets and framebuffers are what's tied to the swapchain images, the render pass only to their
+        // format
+        vkDeviceWaitIdle(device);
+        auto rebuildStart = Clock::now();
+        for (int i = 0; i < RENDER_BENCHMARK_REBUILDS; i++) {
+            destroyFramebuffers();
+            destroyRenderTargets();
+            createRenderTargets();
+            createFramebuffers();
+        }
+        double rebuildSeconds = std::chrono::duration<double>(Clock::now() - rebuildStart).count() / RENDER_BENCHMARK_REBUILDS;
+
+        double frames = double(BENCHMARK_FRAMES - BENCHMARK_WARMUP_FRAMES);
+        printf("Render path benchmark (%s, %llu frames):\n", dynamicRenderingEnabled ? "dynamic rendering" : "render pass",
+               (unsigned long long) (BENCHMARK_FRAMES - BENCHMARK_WARMUP_FRAMES));
+        printf(" - recording:         %8.3f ms/frame\n", renderBenchmarkRecordSeconds / frames * 1e3);
+        printf(" - frame time:        %8.3f ms\n", renderBenchmarkFrameSeconds * 1e3);
+        // dynamic rendering has no framebuffers, so all there is to time is the render targets
+        if (dynamicRenderingEnabled) {
+            printf(" - render targets:    %8.3f ms (no framebuffers to rebuild on this path)\n", rebuildSeconds * 1e3);
+        } else {
+            printf(" - swapchain rebuild: %8.3f ms (render targets and %zu framebuffers)\n", rebuildSeconds * 1e3,
+                   swapChainFramebuffers.size());
+        }
+    }
+
+    void mainLoop() {
+        while (!glfwWindowShouldClose(window)) {
+            glfwPollEvents();
+            drawFrame();
+        }
+
+        vkDeviceWaitIdle(device);
+    }
+
+    void drawFrame() {
+        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        // whatever this frame slot allocated last time round was only needed until now
+        frameArenas.beginFrame(currentFrame);
+        if (renderBenchmarkRebuildPending) {
+            finishRenderBenchmark();
+        }
+
+        // frame boundary: anything that finished compiling in the background can be used from this frame on, and
+        // pipelines replaced a couple of frames ago are no longer referenced by the GPU
+        destroyRetiredPipelines();
+        destroyRetiredTextures();
+        pollShaderReloads();
+        pollPipelineCompiles();
+        collectFrameReadbacks();
+        pollParticlePipeline();
+        pollLodMesh();
+        updateLodSelection();
+        updateScene();
+        updateTextureStreaming();
+        collectParticleTimings();
+        pollMemoryReport();
+        pollAllocationReport();
+
+        selectFrameDevices();
+
+        uint32_t imageIndex;
+        if (deviceGroupDevices.empty()) {
+            vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        } else {
+            // same thing, but the image has to be acquired for the GPUs that are about to render into it
+            VkAcquireNextImageInfoKHR acquireInfo{};
+            acquireInfo.sType = VK_STRUCTURE_TYPE_ACQUIRE_NEXT_IMAGE_INFO_KHR;
+            acquireInfo.swapchain = swapChain;
+            acquireInfo.timeout = UINT64_MAX;
+            acquireInfo.semaphore = imageAvailableSemaphores[currentFrame];
+            acquireInfo.deviceMask = currentDeviceMask;
+            vkAcquireNextImage2KHR(device, &acquireInfo, &imageIndex);
+        }
+
+        // Check if a previous frame is using this image (i.e. there is its fence to wait on)
+        if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+            vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
         }
         // Mark the image as now being in use by this frame
         imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
+        // the fence above guarantees the GPU is done with this frame's command buffer, so it's safe to re-record
+        vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+        beginFrameReadback();
+        beginFrameRecording();
+        auto recordStart = Clock::now();
+        recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+        if (options.renderBenchmark) {
+            advanceRenderBenchmark(std::chrono::duration<double>(Clock::now() - recordStart).count());
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+        VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
+        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = waitSemaphores;
+        submitInfo.pWaitDstStageMask = waitStages;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+
+        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = signalSemaphores;
+
+        // semaphores are waited on and signalled by one GPU of the group: the one rendering the frame for AFR, the
+        // first one for SFR (it holds the frame back until the whole group is done with the command buffer)
+        VkDeviceGroupSubmitInfo deviceGroupSubmitInfo{};
+        if (!deviceGroupDevices.empty()) {
+            deviceGroupSubmitInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_SUBMIT_INFO;
+            deviceGroupSubmitInfo.waitSemaphoreCount = 1;
+            deviceGroupSubmitInfo.pWaitSemaphoreDeviceIndices = &currentDeviceIndex;
+            deviceGroupSubmitInfo.commandBufferCount = 1;
+            deviceGroupSubmitInfo.pCommandBufferDeviceMasks = &currentDeviceMask;
+            deviceGroupSubmitInfo.signalSemaphoreCount = 1;
+            deviceGroupSubmitInfo.pSignalSemaphoreDeviceIndices = &currentDeviceIndex;
+            submitInfo.pNext = &deviceGroupSubmitInfo;
+        }
+
+        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
+        finishFrameRecording();
+
         VkPresentInfoKHR presentInfo{};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -1029,30 +4886,53 @@ private:
         presentInfo.pSwapchains = swapChains;
         presentInfo.pImageIndices = &imageIndex;
 
+        VkDeviceGroupPresentInfoKHR deviceGroupPresentInfo{};
+        uint32_t presentMask = presentDeviceMask();
+        if (!deviceGroupDevices.empty()) {
+            deviceGroupPresentInfo.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_PRESENT_INFO_KHR;
+            deviceGroupPresentInfo.swapchainCount = 1;
+            deviceGroupPresentInfo.pDeviceMasks = &presentMask;
+            deviceGroupPresentInfo.mode = deviceGroupPresentMode;
+            presentInfo.pNext = &deviceGroupPresentInfo;
+        }
+
         vkQueuePresentKHR(presentQueue, &presentInfo);
 
+        if (!firstFramePresented) {
+            onFirstFramePresented();
+        }
+
+        advanceAllocationCheck();
         currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        frameNumber++;
     }
 
     void cleanup() {
+        destroyCaptureResources();
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
             vkDestroyFence(device, inFlightFences[i], nullptr);
         }
         vkDestroyCommandPool(device, commandPool, nullptr);
-        for (const auto& framebuffer : swapChainFramebuffers) {
-            vkDestroyFramebuffer(device, framebuffer, nullptr);
-        }
-        vkDestroyPipeline(device, graphicsPipeline, nullptr);
+        destroyFramebuffers();
+        destroyRenderTargets();
+        destroyParticleSystem();
+        destroyLodMesh();
+        destroyScene();
+        destroyTextureStreaming();
+        destroyDrawDataBuffers();
+        destroyPipelineLibrary();
         vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, drawDataSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, textureSetLayout, nullptr);
         vkDestroyRenderPass(device, renderPass, nullptr);
         for (const auto& imageView : swapChainImageViews) {
             vkDestroyImageView(device, imageView, nullptr);
         }
         vkDestroySwapchainKHR(device, swapChain, nullptr);
-        vkDestroyBuffer(device, vertexBuffer, nullptr);
-        vkFreeMemory(device, vertexBufferMemory, nullptr);
+        destroyBuffer(vertexBuffer);
+        freeMemory(vertexBufferMemory);
         vkDestroyDevice(device, nullptr);
         vkDestroySurfaceKHR(instance, surface, nullptr);
         vkDestroyInstance(instance, nullptr);
@@ -1062,10 +4942,9 @@ private:
     }
 };
 
-int main() {
-    HelloTriangleApplication app;
-
+int main(int argc, char** argv) {
     try {
+        HelloTriangleApplication app(parseOptions(argc, argv));
         std::cout << "Starting Application" << std::endl;
         app.run();
         std::cout << "Closed Application" << std::endl;
@@ -0,0 +1,132 @@
+#ifndef VULKAN_TUTORIAL_MAPPED_FILE_H
+#define VULKAN_TUTORIAL_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_FILE_USE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <vector>
+#endif
+
+// a read-only view of some bytes that somebody else owns (std::span only shows up in C++20)
+struct ByteView {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    ByteView() = default;
+    ByteView(const void* data, size_t size) : data(static_cast<const uint8_t*>(data)), size(size) {}
+
+    template<typename T>
+    bool isAlignedFor() const {
+        return reinterpret_cast<uintptr_t>(data) % alignof(T) == 0 && size % sizeof(T) == 0;
+    }
+};
+
+// a file mapped read-only into memory. the bytes come straight out of the page cache instead of being copied onto the
+// heap, and the kernel shares those pages with any other process that maps the same file. mappings start on a page
+// boundary, so the data is always suitably aligned for SPIR-V's uint32_t words
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef MAPPED_FILE_USE_MMAP
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("failed to open file " + path);
+        }
+        struct stat info{};
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            throw std::runtime_error("failed to stat file " + path);
+        }
+        length = static_cast<size_t>(info.st_size);
+        // mmap refuses zero length mappings, and an empty file is useless to every caller anyway
+        if (length == 0) {
+            close(fd);
+            throw std::runtime_error("file is empty: " + path);
+        }
+        void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file, so the descriptor isn't needed anymore
+        close(fd);
+        if (address == MAP_FAILED) {
+            throw std::runtime_error("failed to map file " + path);
+        }
+        // we read most files front to back exactly once, so let the kernel read ahead aggressively
+        madvise(address, length, MADV_SEQUENTIAL);
+        mapping = static_cast<const uint8_t*>(address);
+#else
+        // no mmap here, so we read into a uint32_t backed buffer to still keep the alignment promise
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open file " + path);
+        }
+        length = static_cast<size_t>(file.tellg());
+        if (length == 0) {
+            throw std::runtime_error("file is empty: " + path);
+        }
+        storage.resize((length + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(storage.data()), static_cast<std::streamsize>(length));
+        mapping = reinterpret_cast<const uint8_t*>(storage.data());
+#endif
+    }
+
+    ~MappedFile() {
+        release();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            release();
+            mapping = std::exchange(other.mapping, nullptr);
+            length = std::exchange(other.length, 0);
+#ifndef MAPPED_FILE_USE_MMAP
+            storage = std::move(other.storage);
+#endif
+        }
+        return *this;
+    }
+
+    ByteView view() const {
+        return {mapping, length};
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+private:
+    void release() {
+#ifdef MAPPED_FILE_USE_MMAP
+        if (mapping != nullptr) {
+            munmap(const_cast<uint8_t*>(mapping), length);
+        }
+#endif
+        mapping = nullptr;
+        length = 0;
+    }
+
+    const uint8_t* mapping = nullptr;
+    size_t length = 0;
+#ifndef MAPPED_FILE_USE_MMAP
+    std::vector<uint32_t> storage;
+#endif
+};
+
+#endif //VULKAN_TUTORIAL_MAPPED_FILE_H
@@ -0,0 +1,518 @@
+#ifndef VULKAN_TUTORIAL_MESHLET_H
+#define VULKAN_TUTORIAL_MESHLET_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include "thread_pool.h"
+
+// clustered level of detail, in the spirit of Nanite: the mesh is cut into small meshlets, neighboring meshlets are
+// grouped and simplified together into coarser meshlets, and that repeats until there's almost nothing left. the result
+// is a DAG of clusters where every cluster knows its own error and the error of whatever replaces it, which lets a
+// renderer pick a detail level per cluster (instead of per mesh) without cracks between them
+
+// small enough to be processed by one workgroup / mesh shader invocation
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+// how many meshlets get merged and simplified together. groups grow (up to the max) when simplification gets stuck,
+// since bigger groups have relatively fewer locked border vertices
+constexpr uint32_t LOD_GROUP_SIZE = 4;
+constexpr uint32_t LOD_MAX_GROUP_SIZE = 32;
+
+struct Meshlet {
+    // into LodMesh::meshletVertices
+    uint32_t vertexOffset;
+    uint32_t vertexCount;
+    // in triangles, into LodMesh::meshletTriangles (3 entries each)
+    uint32_t triangleOffset;
+    uint32_t triangleCount;
+};
+
+// a bounding sphere plus the geometric error (in mesh units) of the geometry it bounds compared to the full detail mesh
+struct LodBounds {
+    glm::vec3 center{0.0f};
+    float radius = 0.0f;
+    float error = 0.0f;
+};
+
+struct LodCluster {
+    Meshlet meshlet;
+    // 0 is full detail
+    uint32_t level;
+    LodBounds self;
+    // the group this cluster was simplified into. infinite error if nothing replaces it (it's a root)
+    LodBounds parent;
+};
+
+struct LodMesh {
+    std::vector<glm::vec3> positions;
+    // meshlet local vertex -> index into positions
+    std::vector<uint32_t> meshletVertices;
+    // three meshlet local vertex indices per triangle
+    std::vector<uint8_t> meshletTriangles;
+    // every level, finest first
+    std::vector<LodCluster> clusters;
+    uint32_t levelCount = 0;
+    uint64_t sourceTriangleCount = 0;
+};
+
+// spreads the lower 10 bits out so there are two zero bits between each of them
+inline uint32_t mortonSpread(uint32_t x) {
+    x &= 0x3FF;
+    x = (x | (x << 16)) & 0x030000FF;
+    x = (x | (x << 8)) & 0x0300F00F;
+    x = (x | (x << 4)) & 0x030C30C3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+// puts triangles that are close in space next to each other in the index list, which is what makes the greedy meshlet
+// builder below produce compact meshlets (and consecutive meshlets neighbors)
+inline void sortTrianglesSpatially(const std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+    glm::vec3 lo(std::numeric_limits<float>::max());
+    glm::vec3 hi(std::numeric_limits<float>::lowest());
+    for (uint32_t index : indices) {
+        lo = glm::min(lo, positions[index]);
+        hi = glm::max(hi, positions[index]);
+    }
+    glm::vec3 extent = glm::max(hi - lo, glm::vec3(1e-20f));
+
+    std::vector<std::pair<uint32_t, uint32_t>> keys(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++) {
+        glm::vec3 centroid = (positions[indices[i * 3]] + positions[indices[i * 3 + 1]] + positions[indices[i * 3 + 2]]) / 3.0f;
+        glm::vec3 cell = (centroid - lo) / extent * 1023.0f;
+        uint32_t code = mortonSpread(uint32_t(cell.x)) | mortonSpread(uint32_t(cell.y)) << 1 | mortonSpread(uint32_t(cell.z)) << 2;
+        keys[i] = {code, static_cast<uint32_t>(i)};
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<uint32_t> sorted(indices.size());
+    for (size_t i = 0; i < triangleCount; i++) {
+        std::copy_n(&indices[keys[i].second * 3], 3, &sorted[i * 3]);
+    }
+    indices.swap(sorted);
+}
+
+inline LodBounds boundingSphere(const std::vector<glm::vec3>& positions, const uint32_t* vertices, size_t count) {
+    glm::vec3 lo(std::numeric_limits<float>::max());
+    glm::vec3 hi(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < count; i++) {
+        lo = glm::min(lo, positions[vertices[i]]);
+        hi = glm::max(hi, positions[vertices[i]]);
+    }
+    LodBounds bounds;
+    bounds.center = (lo + hi) * 0.5f;
+    for (size_t i = 0; i < count; i++) {
+        bounds.radius = std::max(bounds.radius, glm::length(positions[vertices[i]] - bounds.center));
+    }
+    return bounds;
+}
+
+// a sphere around a bunch of spheres. not the tightest one, but it always contains them all, which the selection
+// relies on
+inline LodBounds mergeBounds(const LodBounds* bounds, size_t count) {
+    glm::vec3 lo(std::numeric_limits<float>::max());
+    glm::vec3 hi(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < count; i++) {
+        lo = glm::min(lo, bounds[i].center - glm::vec3(bounds[i].radius));
+        hi = glm::max(hi, bounds[i].center + glm::vec3(bounds[i].radius));
+    }
+    LodBounds merged;
+    merged.center = (lo + hi) * 0.5f;
+    for (size_t i = 0; i < count; i++) {
+        merged.radius = std::max(merged.radius, glm::length(bounds[i].center - merged.center) + bounds[i].radius);
+        merged.error = std::max(merged.error, bounds[i].error);
+    }
+    return merged;
+}
+
+struct MeshletBuild {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;
+    std::vector<uint8_t> triangles;
+};
+
+// packs a triangle list into meshlets in the order the triangles come in, starting a new meshlet whenever the current
+// one would run out of vertices or triangles
+inline void appendMeshlets(const uint32_t* indices, size_t indexCount, MeshletBuild& out) {
+    Meshlet current{static_cast<uint32_t>(out.vertices.size()), 0, static_cast<uint32_t>(out.triangles.size() / 3), 0};
+    auto flush = [&] {
+        if (current.triangleCount > 0) {
+            out.meshlets.push_back(current);
+        }
+        current = {static_cast<uint32_t>(out.vertices.size()), 0, static_cast<uint32_t>(out.triangles.size() / 3), 0};
+    };
+    // meshlets are tiny, so a linear search over their vertices beats any hash map
+    auto findLocal = [&](uint32_t vertex) -> uint32_t {
+        for (uint32_t i = 0; i < current.vertexCount; i++) {
+            if (out.vertices[current.vertexOffset + i] == vertex) {
+                return i;
+            }
+        }
+        return UINT32_MAX;
+    };
+
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        uint32_t newVertices = 0;
+        for (size_t corner = 0; corner < 3; corner++) {
+            if (findLocal(indices[i + corner]) == UINT32_MAX) {
+                newVertices++;
+            }
+        }
+        if (current.vertexCount + newVertices > MESHLET_MAX_VERTICES || current.triangleCount == MESHLET_MAX_TRIANGLES) {
+            flush();
+        }
+        for (size_t corner = 0; corner < 3; corner++) {
+            uint32_t local = findLocal(indices[i + corner]);
+            if (local == UINT32_MAX) {
+                local = current.vertexCount++;
+                out.vertices.push_back(indices[i + corner]);
+            }
+            out.triangles.push_back(static_cast<uint8_t>(local));
+        }
+        current.triangleCount++;
+    }
+    flush();
+}
+
+// simplifies a group of triangles down to about targetTriangles by vertex clustering: vertices are snapped together on
+// a grid that gets coarser until the target is met. vertices on the border of the group never move, so the result
+// still fits seamlessly against the neighboring groups. error is set to how far any vertex moved
+inline std::vector<uint32_t> simplifyGroup(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices,
+                                           size_t targetTriangles, float& error) {
+    // edges that only one triangle of the group uses are on its border
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        for (size_t corner = 0; corner < 3; corner++) {
+            uint32_t a = indices[i + corner];
+            uint32_t b = indices[i + (corner + 1) % 3];
+            edgeUses[uint64_t(std::min(a, b)) << 32 | std::max(a, b)]++;
+        }
+    }
+    std::unordered_map<uint32_t, bool> locked;
+    for (uint32_t index : indices) {
+        locked.emplace(index, false);
+    }
+    for (const auto& edge : edgeUses) {
+        if (edge.second == 1) {
+            locked[uint32_t(edge.first >> 32)] = true;
+            locked[uint32_t(edge.first)] = true;
+        }
+    }
+
+    glm::vec3 lo(std::numeric_limits<float>::max());
+    glm::vec3 hi(std::numeric_limits<float>::lowest());
+    for (const auto& vertex : locked) {
+        lo = glm::min(lo, positions[vertex.first]);
+        hi = glm::max(hi, positions[vertex.first]);
+    }
+    glm::vec3 size = hi - lo;
+    float extent = std::max({size.x, size.y, size.z, 1e-20f});
+
+    // a grid with cells of size h over the group gives roughly 2 * (extent / h)^2 triangles for surface-like meshes,
+    // so start a bit below that and grow
+    float cellSize = extent * std::sqrt(2.0f / float(std::max<size_t>(targetTriangles, 1))) * 0.5f;
+    std::unordered_map<uint32_t, uint32_t> remap;
+    std::vector<uint32_t> result;
+    for (int attempt = 0; attempt < 32; attempt++) {
+        remap.clear();
+        std::unordered_map<uint64_t, uint32_t> cellRepresentatives;
+        for (const auto& vertex : locked) {
+            if (vertex.second) {
+                remap[vertex.first] = vertex.first;
+                continue;
+            }
+            glm::vec3 cell = glm::floor((positions[vertex.first] - lo) / cellSize);
+            uint64_t key = uint64_t(cell.x) | uint64_t(cell.y) << 21 | uint64_t(cell.z) << 42;
+            // the first vertex to land in a cell represents all of them, so we never invent new positions
+            remap[vertex.first] = cellRepresentatives.emplace(key, vertex.first).first->second;
+        }
+
+        result.clear();
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            uint32_t a = remap[indices[i]];
+            uint32_t b = remap[indices[i + 1]];
+            uint32_t c = remap[indices[i + 2]];
+            if (a != b && b != c && a != c) {
+                result.insert(result.end(), {a, b, c});
+            }
+        }
+        if (result.size() / 3 <= targetTriangles || cellSize > extent) {
+            break;
+        }
+        cellSize *= 1.25f;
+    }
+
+    error = 0.0f;
+    for (const auto& vertex : remap) {
+        error = std::max(error, glm::length(positions[vertex.first] - positions[vertex.second]));
+    }
+    return result;
+}
+
+// builds the whole cluster hierarchy. every round is simplified in parallel on the pool (if given), one group per job,
+// so this must not be called from a job on that same pool
+inline LodMesh buildLodMesh(std::vector<glm::vec3> positions, std::vector<uint32_t> indices, ThreadPool* pool = nullptr) {
+    LodMesh mesh;
+    mesh.positions = std::move(positions);
+    mesh.sourceTriangleCount = indices.size() / 3;
+
+    auto appendLevel = [&mesh](const MeshletBuild& build, uint32_t level, const LodBounds* self) {
+        uint32_t vertexBase = static_cast<uint32_t>(mesh.meshletVertices.size());
+        uint32_t triangleBase = static_cast<uint32_t>(mesh.meshletTriangles.size() / 3);
+        mesh.meshletVertices.insert(mesh.meshletVertices.end(), build.vertices.begin(), build.vertices.end());
+        mesh.meshletTriangles.insert(mesh.meshletTriangles.end(), build.triangles.begin(), build.triangles.end());
+        for (const Meshlet& meshlet : build.meshlets) {
+            LodCluster cluster{};
+            cluster.meshlet = meshlet;
+            cluster.meshlet.vertexOffset += vertexBase;
+            cluster.meshlet.triangleOffset += triangleBase;
+            cluster.level = level;
+            if (self != nullptr) {
+                cluster.self = *self;
+            } else {
+                cluster.self = boundingSphere(mesh.positions, &mesh.meshletVertices[cluster.meshlet.vertexOffset], meshlet.vertexCount);
+            }
+            cluster.parent.error = std::numeric_limits<float>::infinity();
+            mesh.clusters.push_back(cluster);
+        }
+    };
+
+    sortTrianglesSpatially(mesh.positions, indices);
+    MeshletBuild base;
+    appendMeshlets(indices.data(), indices.size(), base);
+    appendLevel(base, 0, nullptr);
+
+    struct GroupResult {
+        MeshletBuild parents;
+        LodBounds bounds;
+        bool simplified = false;
+    };
+
+    // clusters that don't have a parent yet. a group that couldn't be simplified keeps its clusters in here, so they
+    // get another chance next round, grouped with different neighbors
+    std::vector<uint32_t> working(mesh.clusters.size());
+    std::iota(working.begin(), working.end(), 0);
+    uint32_t level = 0;
+    size_t groupSize = LOD_GROUP_SIZE;
+    while (working.size() > 1) {
+        // groups are runs of clusters along a Morton curve through their centers, which keeps them spatially compact
+        glm::vec3 lo(std::numeric_limits<float>::max());
+        glm::vec3 hi(std::numeric_limits<float>::lowest());
+        for (uint32_t i : working) {
+            lo = glm::min(lo, mesh.clusters[i].self.center);
+            hi = glm::max(hi, mesh.clusters[i].self.center);
+        }
+        glm::vec3 extent = glm::max(hi - lo, glm::vec3(1e-20f));
+        std::vector<std::pair<uint32_t, uint32_t>> keys;
+        keys.reserve(working.size());
+        for (uint32_t i : working) {
+            glm::vec3 cell = (mesh.clusters[i].self.center - lo) / extent * 1023.0f;
+            keys.emplace_back(mortonSpread(uint32_t(cell.x)) | mortonSpread(uint32_t(cell.y)) << 1 | mortonSpread(uint32_t(cell.z)) << 2, i);
+        }
+        std::sort(keys.begin(), keys.end());
+        for (size_t i = 0; i < keys.size(); i++) {
+            working[i] = keys[i].second;
+        }
+
+        size_t groupCount = (working.size() + groupSize - 1) / groupSize;
+        std::vector<GroupResult> results(groupCount);
+        auto simplify = [&mesh, &results, &working, groupSize](size_t group) {
+            size_t first = group * groupSize;
+            size_t last = std::min(first + groupSize, working.size());
+
+            std::vector<uint32_t> groupIndices;
+            std::vector<LodBounds> childBounds;
+            for (size_t w = first; w < last; w++) {
+                size_t i = working[w];
+                const Meshlet& meshlet = mesh.clusters[i].meshlet;
+                for (uint32_t t = 0; t < meshlet.triangleCount * 3; t++) {
+                    uint8_t local = mesh.meshletTriangles[meshlet.triangleOffset * 3 + t];
+                    groupIndices.push_back(mesh.meshletVertices[meshlet.vertexOffset + local]);
+                }
+                childBounds.push_back(mesh.clusters[i].self);
+            }
+
+            size_t triangleCount = groupIndices.size() / 3;
+            float simplifyError;
+            std::vector<uint32_t> simplified = simplifyGroup(mesh.positions, groupIndices, triangleCount / 2, simplifyError);
+            // if barely anything could be removed (mostly border left), these clusters stay as they are for good
+            if (simplified.empty() || simplified.size() / 3 > triangleCount * 85 / 100) {
+                return;
+            }
+            GroupResult& result = results[group];
+            result.simplified = true;
+            // the group's error can't be less than its children's, or a coarser level could look better than a finer one
+            result.bounds = mergeBounds(childBounds.data(), childBounds.size());
+            result.bounds.error += simplifyError;
+            appendMeshlets(simplified.data(), simplified.size(), result.parents);
+        };
+
+        if (pool != nullptr) {
+            std::vector<std::future<void>> jobs;
+            jobs.reserve(groupCount);
+            for (size_t group = 0; group < groupCount; group++) {
+                jobs.push_back(pool->submit([&simplify, group] { simplify(group); }));
+            }
+            for (auto& job : jobs) {
+                job.get();
+            }
+        } else {
+            for (size_t group = 0; group < groupCount; group++) {
+                simplify(group);
+            }
+        }
+
+        // children of a group share the group's bounds as their parent bounds, and every new cluster gets them as its
+        // own. that's what makes the whole group switch levels at once, so no cracks open up inside it
+        std::vector<uint32_t> next;
+        size_t simplifiedGroups = 0;
+        for (size_t group = 0; group < groupCount; group++) {
+            const GroupResult& result = results[group];
+            size_t first = group * groupSize;
+            size_t last = std::min(first + groupSize, working.size());
+            if (!result.simplified) {
+                next.insert(next.end(), working.begin() + first, working.begin() + last);
+                continue;
+            }
+            simplifiedGroups++;
+            for (size_t w = first; w < last; w++) {
+                mesh.clusters[working[w]].parent = result.bounds;
+            }
+            size_t firstNew = mesh.clusters.size();
+            appendLevel(result.parents, level + 1, &result.bounds);
+            for (size_t i = firstNew; i < mesh.clusters.size(); i++) {
+                next.push_back(static_cast<uint32_t>(i));
+            }
+        }
+
+        if (simplifiedGroups == 0 && groupSize >= LOD_MAX_GROUP_SIZE) {
+            break;
+        }
+        if (simplifiedGroups * 2 < groupCount) {
+            groupSize = std::min<size_t>(groupSize * 2, LOD_MAX_GROUP_SIZE);
+        }
+        working.swap(next);
+        if (simplifiedGroups > 0) {
+            level++;
+        }
+    }
+    mesh.levelCount = level + 1;
+    return mesh;
+}
+
+// where the mesh is seen from
+struct LodCamera {
+    glm::vec3 position;
+    // pixels covered by one mesh unit at distance 1: viewport height / (2 * tan(vertical fov / 2))
+    float projectionScale;
+    // geometry is never considered closer than this. without it, anything whose bounds contain the camera would have
+    // infinite error and could never be simplified, no matter the budget
+    float nearDistance = 0.01f;
+};
+
+struct LodSelection {
+    // indices into LodMesh::clusters, in increasing order
+    std::vector<uint32_t> clusters;
+    uint64_t triangleCount = 0;
+    // the screen space error (in pixels) that was allowed to fit the budget
+    float errorThreshold = 0.0f;
+};
+
+// picks one level per cluster so that the projected error stays as low as possible while the triangle count stays
+// under a budget. a cluster is drawn when its own error is acceptable but its parent's isn't. finding the best
+// threshold would be a search over the whole hierarchy, so instead every cluster adds its triangles to a histogram of
+// thresholds it would be drawn at, and one prefix sum over that gives the triangle count for every threshold at once.
+// that's two linear passes over the clusters per frame, no matter the budget
+class LodSelector {
+public:
+    // selection's cluster list keeps its storage from call to call, so a steady camera selects without allocating
+    void select(const LodMesh& mesh, const LodCamera& camera, uint64_t triangleBudget, LodSelection& selection) {
+        size_t clusterCount = mesh.clusters.size();
+        lowBuckets.resize(clusterCount);
+        highBuckets.resize(clusterCount);
+        histogram.assign(BUCKET_COUNT + 1, 0);
+
+        for (size_t i = 0; i < clusterCount; i++) {
+            const LodCluster& cluster = mesh.clusters[i];
+            lowBuckets[i] = thresholdBucket(projectedError(cluster.self, camera));
+            highBuckets[i] = thresholdBucket(projectedError(cluster.parent, camera));
+            // at thresholds in [low, high) this cluster is drawn
+            if (lowBuckets[i] < highBuckets[i]) {
+                histogram[lowBuckets[i]] += cluster.meshlet.triangleCount;
+                histogram[highBuckets[i]] -= cluster.meshlet.triangleCount;
+            }
+        }
+
+        // the lowest threshold that fits the budget. if none does, the coarsest one we have
+        uint32_t bucket = BUCKET_COUNT - 1;
+        int64_t triangles = 0;
+        for (uint32_t b = 0; b < BUCKET_COUNT; b++) {
+            triangles += histogram[b];
+            if (triangles <= static_cast<int64_t>(triangleBudget)) {
+                bucket = b;
+                break;
+            }
+        }
+
+        selection.clusters.clear();
+        selection.triangleCount = 0;
+        selection.errorThreshold = bucketThreshold(bucket);
+        for (size_t i = 0; i < clusterCount; i++) {
+            if (lowBuckets[i] <= bucket && bucket < highBuckets[i]) {
+                selection.clusters.push_back(static_cast<uint32_t>(i));
+                selection.triangleCount += mesh.clusters[i].meshlet.triangleCount;
+            }
+        }
+    }
+
+private:
+    // thresholds from 1/256 px up to a million px on a log scale
+    static constexpr uint32_t BUCKET_COUNT = 512;
+    static constexpr float LOG2_MIN = -8.0f;
+    static constexpr float LOG2_RANGE = 28.0f;
+
+    static float projectedError(const LodBounds& bounds, const LodCamera& camera) {
+        if (std::isinf(bounds.error)) {
+            return bounds.error;
+        }
+        // the closest the bounded geometry can get to the camera. since parent spheres contain their children's and have
+        // at least their error, a parent always projects to at least its children's error
+        float distance = std::max(glm::length(bounds.center - camera.position) - bounds.radius, camera.nearDistance);
+        return bounds.error * camera.projectionScale / distance;
+    }
+
+    static float bucketThreshold(uint32_t bucket) {
+        return std::exp2(LOG2_MIN + float(bucket) * LOG2_RANGE / BUCKET_COUNT);
+    }
+
+    // the first bucket whose threshold is >= error (BUCKET_COUNT if there is none)
+    static uint32_t thresholdBucket(float error) {
+        if (!(error > bucketThreshold(0))) {
+            return 0;
+        }
+        if (std::isinf(error)) {
+            return BUCKET_COUNT;
+        }
+        float bucket = std::ceil((std::log2(error) - LOG2_MIN) * BUCKET_COUNT / LOG2_RANGE);
+        return static_cast<uint32_t>(std::min(bucket, float(BUCKET_COUNT)));
+    }
+
+    std::vector<uint32_t> lowBuckets;
+    std::vector<uint32_t> highBuckets;
+    std::vector<int64_t> histogram;
+};
+
+#endif //VULKAN_TUTORIAL_MESHLET_H
@@ -0,0 +1,165 @@
+#ifndef VULKAN_TUTORIAL_RESOURCE_STATS_H
+#define VULKAN_TUTORIAL_RESOURCE_STATS_H
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// bookkeeping for everything the app creates on the device: how many of each kind of object are alive, and how many
+// allocations (and bytes) sit in each memory type. pipelines get built on worker threads, so all of it can be updated
+// from any thread
+
+enum class ResourceKind : uint32_t {
+    Buffer,
+    Image,
+    Pipeline,
+    DescriptorSet,
+    Count,
+};
+
+inline const char* resourceKindName(ResourceKind kind) {
+    switch (kind) {
+        case ResourceKind::Buffer:
+            return "buffers";
+        case ResourceKind::Image:
+            return "images";
+        case ResourceKind::Pipeline:
+            return "pipelines";
+        case ResourceKind::DescriptorSet:
+            return "descriptor sets";
+        case ResourceKind::Count:
+            break;
+    }
+    return "?";
+}
+
+class ResourceStats {
+public:
+    void created(ResourceKind kind, uint32_t count = 1) {
+        objects[static_cast<size_t>(kind)].fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void destroyed(ResourceKind kind, uint32_t count = 1) {
+        objects[static_cast<size_t>(kind)].fetch_sub(count, std::memory_order_relaxed);
+    }
+
+    void allocated(VkDeviceMemory memory, uint32_t memoryType, VkDeviceSize size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        liveAllocations[memory] = {memoryType, size};
+        types[memoryType].allocations++;
+        types[memoryType].bytes += size;
+    }
+
+    // VK_NULL_HANDLE (or anything that wasn't counted) is ignored, like vkFreeMemory does
+    void freed(VkDeviceMemory memory) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = liveAllocations.find(memory);
+        if (it == liveAllocations.end()) {
+            return;
+        }
+        types[it->second.memoryType].allocations--;
+        types[it->second.memoryType].bytes -= it->second.size;
+        liveAllocations.erase(it);
+    }
+
+    uint64_t objectCount(ResourceKind kind) const {
+        return objects[static_cast<size_t>(kind)].load(std::memory_order_relaxed);
+    }
+
+    struct MemoryTypeStats {
+        uint64_t allocations = 0;
+        VkDeviceSize bytes = 0;
+    };
+
+    std::array<MemoryTypeStats, VK_MAX_MEMORY_TYPES> memoryTypes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return types;
+    }
+
+private:
+    struct Allocation {
+        uint32_t memoryType;
+        VkDeviceSize size;
+    };
+
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(ResourceKind::Count)> objects{};
+    mutable std::mutex mutex;
+    std::unordered_map<VkDeviceMemory, Allocation> liveAllocations;
+    std::array<MemoryTypeStats, VK_MAX_MEMORY_TYPES> types{};
+};
+
+// one heap as the driver sees it. with VK_EXT_memory_budget, usage is the whole process' (including what the driver
+// allocated behind our back) and budget is what the OS is actually willing to give us right now, which can be well
+// under the heap size. without it, usage is only what we allocated ourselves and budget is the heap size
+struct HeapReport {
+    VkDeviceSize size = 0;
+    VkDeviceSize budget = 0;
+    VkDeviceSize usage = 0;
+    // just our own allocations, summed over the heap's memory types
+    VkDeviceSize allocatedBytes = 0;
+    uint64_t allocations = 0;
+    bool deviceLocal = false;
+};
+
+struct MemoryReport {
+    // whether budget/usage came from VK_EXT_memory_budget
+    bool driverBudget = false;
+    std::vector<HeapReport> heaps;
+    // per memory type, indexed like VkPhysicalDeviceMemoryProperties::memoryTypes
+    std::vector<ResourceStats::MemoryTypeStats> memoryTypes;
+    std::array<uint64_t, static_cast<size_t>(ResourceKind::Count)> objects{};
+
+    // the heap closest to running out, as a fraction of its budget
+    double worstHeapFraction() const {
+        double worst = 0.0;
+        for (const HeapReport& heap : heaps) {
+            if (heap.budget > 0) {
+                worst = std::max(worst, double(heap.usage) / double(heap.budget));
+            }
+        }
+        return worst;
+    }
+};
+
+// pulls together the driver's view of the heaps and our own counts. the report is filled in place, so one that's
+// reused for every query only allocates the first time
+inline void queryMemoryReport(VkPhysicalDevice physicalDevice, bool memoryBudgetEnabled, const ResourceStats& stats,
+                              MemoryReport& report) {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+    budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    if (memoryBudgetEnabled) {
+        properties.pNext = &budget;
+    }
+    vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+    const VkPhysicalDeviceMemoryProperties& memory = properties.memoryProperties;
+
+    report.driverBudget = memoryBudgetEnabled;
+    auto types = stats.memoryTypes();
+    report.memoryTypes.assign(types.begin(), types.begin() + memory.memoryTypeCount);
+    report.heaps.assign(memory.memoryHeapCount, HeapReport{});
+    for (uint32_t i = 0; i < memory.memoryTypeCount; i++) {
+        HeapReport& heap = report.heaps[memory.memoryTypes[i].heapIndex];
+        heap.allocatedBytes += types[i].bytes;
+        heap.allocations += types[i].allocations;
+    }
+    for (uint32_t i = 0; i < memory.memoryHeapCount; i++) {
+        HeapReport& heap = report.heaps[i];
+        heap.size = memory.memoryHeaps[i].size;
+        heap.deviceLocal = (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heap.budget = memoryBudgetEnabled ? budget.heapBudget[i] : heap.size;
+        heap.usage = memoryBudgetEnabled ? budget.heapUsage[i] : heap.allocatedBytes;
+    }
+    for (size_t kind = 0; kind < report.objects.size(); kind++) {
+        report.objects[kind] = stats.objectCount(static_cast<ResourceKind>(kind));
+    }
+}
+
+#endif //VULKAN_TUTORIAL_RESOURCE_STATS_H
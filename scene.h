@@ -0,0 +1,263 @@
+#ifndef VULKAN_TUTORIAL_SCENE_H
+#define VULKAN_TUTORIAL_SCENE_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+#include "simd.h"
+#include "thread_pool.h"
+
+// a flat list of objects for the CPU driven draw path. everything the per-frame passes look at is kept as structure of
+// arrays (one array per component instead of one struct per object), so a SIMD loop can load several objects' worth of
+// one component with a single instruction and no shuffling. every array is padded to a multiple of simd::MAX_WIDTH so
+// those loops never need a scalar tail
+class Scene {
+public:
+    // an object is a uniformly scaled, translated instance of something with a local bounding sphere
+    uint32_t add(glm::vec3 position, float objectScale, glm::vec3 boundsCenter, float boundsRadius, glm::vec3 color) {
+        uint32_t id = objectCount++;
+        if (objectCount > positionX.size()) {
+            size_t padded = (objectCount + simd::MAX_WIDTH - 1) / simd::MAX_WIDTH * simd::MAX_WIDTH;
+            for (std::vector<float>* array : arrays()) {
+                array->resize(padded, 0.0f);
+            }
+        }
+        positionX[id] = position.x;
+        positionY[id] = position.y;
+        positionZ[id] = position.z;
+        // negative scales would turn the radius negative and make the cull reject the object no matter what
+        scale[id] = std::fabs(objectScale);
+        localX[id] = boundsCenter.x;
+        localY[id] = boundsCenter.y;
+        localZ[id] = boundsCenter.z;
+        localRadius[id] = boundsRadius;
+        colors.push_back(color);
+        boundsDirty = true;
+        return id;
+    }
+
+    void setTransform(uint32_t id, glm::vec3 position, float newScale) {
+        positionX[id] = position.x;
+        positionY[id] = position.y;
+        positionZ[id] = position.z;
+        scale[id] = std::fabs(newScale);
+        boundsDirty = true;
+    }
+
+    // brings the world space bounding spheres up to date with the transforms. culling only reads these, so moving a
+    // handful of objects doesn't make every frame's cull pay for the transform math again
+    void updateBounds() {
+        if (!boundsDirty) {
+            return;
+        }
+        for (size_t i = 0; i < positionX.size(); i += simd::WIDTH) {
+            simd::Float s = simd::load(&scale[i]);
+            simd::store(&worldX[i], simd::mulAdd(simd::load(&localX[i]), s, simd::load(&positionX[i])));
+            simd::store(&worldY[i], simd::mulAdd(simd::load(&localY[i]), s, simd::load(&positionY[i])));
+            simd::store(&worldZ[i], simd::mulAdd(simd::load(&localZ[i]), s, simd::load(&positionZ[i])));
+            simd::store(&worldRadius[i], simd::load(&localRadius[i]) * s);
+        }
+        boundsDirty = false;
+    }
+
+    size_t size() const {
+        return objectCount;
+    }
+
+    // what a frame actually draws with
+    glm::vec3 worldCenter(uint32_t id) const {
+        return {worldX[id], worldY[id], worldZ[id]};
+    }
+
+    glm::vec3 color(uint32_t id) const {
+        return colors[id];
+    }
+
+    // transforms
+    std::vector<float> positionX, positionY, positionZ, scale;
+    // bounding spheres in object space
+    std::vector<float> localX, localY, localZ, localRadius;
+    // and in world space, filled in by updateBounds()
+    std::vector<float> worldX, worldY, worldZ, worldRadius;
+
+private:
+    std::vector<std::vector<float>*> arrays() {
+        return {&positionX, &positionY, &positionZ, &scale, &localX, &localY, &localZ, &localRadius,
+                &worldX, &worldY, &worldZ, &worldRadius};
+    }
+
+    size_t objectCount = 0;
+    // per object data only the draw list needs, so it stays a plain array of structs
+    std::vector<glm::vec3> colors;
+    bool boundsDirty = false;
+};
+
+// the six planes of a view frustum, normals pointing inwards and normalized so plane distances are real distances
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // pulls the planes straight out of a view-projection matrix (Gribb/Hartmann), for Vulkan's 0..1 clip space depth
+    static Frustum fromMatrix(const glm::mat4& viewProjection) {
+        auto row = [&](int i) {
+            return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        };
+        Frustum frustum{};
+        frustum.planes[0] = row(3) + row(0);  // left
+        frustum.planes[1] = row(3) - row(0);  // right
+        frustum.planes[2] = row(3) + row(1);  // top or bottom, depending on the projection's y flip
+        frustum.planes[3] = row(3) - row(1);
+        frustum.planes[4] = row(2);           // near
+        frustum.planes[5] = row(3) - row(2);  // far
+        for (glm::vec4& plane : frustum.planes) {
+            plane = plane * (1.0f / glm::length(glm::vec3(plane.x, plane.y, plane.z)));
+        }
+        return frustum;
+    }
+};
+
+// writes out the ids of every object in [begin, end) whose world space sphere touches the frustum. begin has to be a
+// multiple of simd::MAX_WIDTH. a sphere is out as soon as it's entirely behind any one plane; all six planes are
+// tested for every lane since branching per lane would cost more than the math it saves. out must have room for
+// end - begin ids, and the number written is returned
+inline size_t cullSpheres(const Scene& scene, const Frustum& frustum, size_t begin, size_t end, uint32_t* out) {
+    simd::Float planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; p++) {
+        planeX[p] = simd::splat(frustum.planes[p].x);
+        planeY[p] = simd::splat(frustum.planes[p].y);
+        planeZ[p] = simd::splat(frustum.planes[p].z);
+        planeW[p] = simd::splat(frustum.planes[p].w);
+    }
+
+    size_t written = 0;
+    for (size_t i = begin; i < end; i += simd::WIDTH) {
+        simd::Float x = simd::load(&scene.worldX[i]);
+        simd::Float y = simd::load(&scene.worldY[i]);
+        simd::Float z = simd::load(&scene.worldZ[i]);
+        simd::Float negativeRadius = -simd::load(&scene.worldRadius[i]);
+
+        simd::Float distance = simd::mulAdd(planeX[0], x, simd::mulAdd(planeY[0], y, simd::mulAdd(planeZ[0], z, planeW[0])));
+        simd::Mask outside = distance < negativeRadius;
+        for (int p = 1; p < 6; p++) {
+            distance = simd::mulAdd(planeX[p], x, simd::mulAdd(planeY[p], y, simd::mulAdd(planeZ[p], z, planeW[p])));
+            outside = outside | (distance < negativeRadius);
+        }
+
+        uint32_t visible = ~simd::bits(outside) & ((1u << simd::WIDTH) - 1);
+        // the padding past the last object is never visible
+        if (end - i < size_t(simd::WIDTH)) {
+            visible &= (1u << (end - i)) - 1;
+        }
+        while (visible != 0) {
+            out[written++] = static_cast<uint32_t>(i) + simd::lowestBit(visible);
+            visible &= visible - 1;
+        }
+    }
+    return written;
+}
+
+// culls a whole scene into a draw list of object ids, in ascending order. big scenes are split into chunks that run on
+// the worker pool (the calling thread takes one chunk itself instead of just waiting). the per chunk output buffers
+// are kept around between calls, so a steady scene culls without allocating
+class FrustumCuller {
+public:
+    // small enough to spread over a few cores at a million objects, big enough that the job overhead disappears
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    void cull(const Scene& scene, const Frustum& frustum, std::vector<uint32_t>& visible, ThreadPool* pool = nullptr) {
+        size_t count = scene.size();
+        size_t chunkCount = std::max<size_t>(1, (count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+        if (pool == nullptr || chunkCount == 1) {
+            visible.resize(count);
+            visible.resize(cullSpheres(scene, frustum, 0, count, visible.data()));
+            return;
+        }
+
+        if (chunks.size() < chunkCount) {
+            chunks.resize(chunkCount);
+            pending.resize(chunkCount);
+        }
+        auto runChunk = [&scene, &frustum, this, count](size_t c) {
+            size_t begin = c * CHUNK_SIZE;
+            size_t end = std::min(count, begin + CHUNK_SIZE);
+            if (chunks[c].ids.size() < end - begin) {
+                chunks[c].ids.resize(CHUNK_SIZE);
+            }
+            chunks[c].count = cullSpheres(scene, frustum, begin, end, chunks[c].ids.data());
+        };
+        for (size_t c = 1; c < chunkCount; c++) {
+            pending[c] = pool->submit([&runChunk, c] { runChunk(c); });
+        }
+        runChunk(0);
+        size_t total = chunks[0].count;
+        for (size_t c = 1; c < chunkCount; c++) {
+            pending[c].get();
+            total += chunks[c].count;
+        }
+
+        visible.resize(total);
+        size_t offset = 0;
+        for (size_t c = 0; c < chunkCount; c++) {
+            std::copy_n(chunks[c].ids.data(), chunks[c].count, visible.data() + offset);
+            offset += chunks[c].count;
+        }
+    }
+
+private:
+    struct Chunk {
+        std::vector<uint32_t> ids;
+        size_t count = 0;
+    };
+    std::vector<Chunk> chunks;
+    std::vector<std::future<void>> pending;
+};
+
+// the straightforward version of all of the above, one struct per object and one object at a time. it's only here so
+// cull_bench has something to compare against
+struct SceneObject {
+    glm::vec3 position;
+    float scale;
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+    glm::vec3 color;
+    // filled in by updateObjectBounds()
+    glm::vec3 worldCenter;
+    float worldRadius;
+};
+
+// the same math as Scene::updateBounds(), one object at a time
+inline void updateObjectBounds(std::vector<SceneObject>& objects) {
+    for (SceneObject& object : objects) {
+        float s = std::fabs(object.scale);
+        object.worldCenter.x = simd::mulAdd(object.boundsCenter.x, s, object.position.x);
+        object.worldCenter.y = simd::mulAdd(object.boundsCenter.y, s, object.position.y);
+        object.worldCenter.z = simd::mulAdd(object.boundsCenter.z, s, object.position.z);
+        object.worldRadius = object.boundsRadius * s;
+    }
+}
+
+// and the same plane tests as cullSpheres(), so both come up with exactly the same objects
+inline void cullObjectsScalar(const std::vector<SceneObject>& objects, const Frustum& frustum, std::vector<uint32_t>& visible) {
+    visible.clear();
+    for (size_t i = 0; i < objects.size(); i++) {
+        const glm::vec3& center = objects[i].worldCenter;
+        float negativeRadius = -objects[i].worldRadius;
+        bool inside = true;
+        for (const glm::vec4& plane : frustum.planes) {
+            float distance = simd::mulAdd(plane.x, center.x, simd::mulAdd(plane.y, center.y, simd::mulAdd(plane.z, center.z, plane.w)));
+            if (distance < negativeRadius) {
+                inside = false;
+                break;
+            }
+        }
+        if (inside) {
+            visible.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+#endif //VULKAN_TUTORIAL_SCENE_H
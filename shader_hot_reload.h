@@ -0,0 +1,202 @@
+#ifndef VULKAN_TUTORIAL_SHADER_HOT_RELOAD_H
+#define VULKAN_TUTORIAL_SHADER_HOT_RELOAD_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+// only GLSL sources are interesting, we write the .spv files next to them ourselves and don't want to react to those
+inline bool isShaderSource(const std::filesystem::path& path) {
+    auto extension = path.extension();
+    return extension == ".vert" || extension == ".frag" || extension == ".comp";
+}
+
+// same naming compile.sh uses: shader.vert -> shader.vert.spv
+inline std::string spirvPathFor(const std::string& sourcePath) {
+    return sourcePath + ".spv";
+}
+
+// watches a directory for edited shader sources. on Linux this sits on inotify, everywhere else it falls back to
+// checking modification times a few times a second. the watching happens on its own thread, and the render thread just
+// picks up the list of changed files whenever it's convenient with takeChanged()
+class ShaderWatcher {
+public:
+    explicit ShaderWatcher(std::string directory) : directory(std::move(directory)) {
+        thread = std::thread([this] { watchLoop(); });
+    }
+
+    ~ShaderWatcher() {
+        stopping = true;
+        thread.join();
+    }
+
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    // hands back every source that changed since the last call. editors tend to save in several steps (truncate,
+    // write, rename...), so a file is only reported once it has been quiet for a little while
+    std::vector<std::string> takeChanged() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::string> settled;
+        auto now = std::chrono::steady_clock::now();
+        for (auto it = changed.begin(); it != changed.end();) {
+            if (now - it->second >= SETTLE_TIME) {
+                settled.push_back(it->first);
+                it = changed.erase(it);
+            } else {
+                it++;
+            }
+        }
+        return settled;
+    }
+
+private:
+    static constexpr std::chrono::milliseconds SETTLE_TIME{100};
+    static constexpr int POLL_INTERVAL_MS = 250;
+
+    void markChanged(const std::filesystem::path& path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        changed[path.generic_string()] = std::chrono::steady_clock::now();
+    }
+
+#ifdef __linux__
+    void watchLoop() {
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0 || inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+            printf("Failed to watch %s for shader changes, hot reload is disabled\n", directory.c_str());
+            if (fd >= 0) {
+                close(fd);
+            }
+            return;
+        }
+
+        // events are variable length (they carry the file name), so we read them into an aligned buffer and walk it
+        alignas(inotify_event) char buffer[4096];
+        while (!stopping) {
+            // wake up every so often even without events so we notice we're supposed to stop
+            pollfd pfd{fd, POLLIN, 0};
+            if (poll(&pfd, 1, POLL_INTERVAL_MS) <= 0) {
+                continue;
+            }
+            ssize_t length;
+            while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+                for (char* ptr = buffer; ptr < buffer + length;) {
+                    auto event = reinterpret_cast<const inotify_event*>(ptr);
+                    if (event->len > 0) {
+                        std::filesystem::path path = std::filesystem::path(directory) / event->name;
+                        if (isShaderSource(path)) {
+                            markChanged(path);
+                        }
+                    }
+                    ptr += sizeof(inotify_event) + event->len;
+                }
+            }
+        }
+        close(fd);
+    }
+#else
+    void watchLoop() {
+        std::unordered_map<std::string, std::filesystem::file_time_type> lastWriteTimes;
+        bool firstScan = true;
+        while (!stopping) {
+            std::error_code error;
+            for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+                if (!entry.is_regular_file() || !isShaderSource(entry.path())) {
+                    continue;
+                }
+                auto writeTime = entry.last_write_time(error);
+                auto& last = lastWriteTimes[entry.path().generic_string()];
+                // the first scan only records what's there, so we don't recompile everything on startup
+                if (!firstScan && writeTime != last) {
+                    markChanged(entry.path());
+                }
+                last = writeTime;
+            }
+            firstScan = false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+        }
+    }
+#endif
+
+    std::string directory;
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+    std::mutex mutex;
+    // source path -> when we last saw it change
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> changed;
+};
+
+// compiles a GLSL source to SPIR-V and writes it to the path compile.sh would have. throws with the compiler output on
+// errors. this is slow (tens of milliseconds), so it belongs on a worker thread
+inline void compileShaderSource(const std::string& sourcePath) {
+    std::string outputPath = spirvPathFor(sourcePath);
+    // we write to a temporary file and rename it over the old one, so nothing ever reads a half written .spv
+    std::string tempPath = outputPath + ".tmp";
+
+#ifdef HAVE_SHADERC
+    std::ifstream file(sourcePath);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open shader source " + sourcePath);
+    }
+    std::stringstream source;
+    source << file.rdbuf();
+
+    shaderc_shader_kind kind;
+    auto extension = std::filesystem::path(sourcePath).extension();
+    if (extension == ".vert") {
+        kind = shaderc_glsl_vertex_shader;
+    } else if (extension == ".frag") {
+        kind = shaderc_glsl_fragment_shader;
+    } else {
+        kind = shaderc_glsl_compute_shader;
+    }
+
+    // compilers are cheap to make, and having one per call means worker threads never share one
+    shaderc::Compiler compiler;
+    shaderc::CompileOptions options;
+    options.SetOptimizationLevel(shaderc_optimization_level_performance);
+    shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source.str(), kind, sourcePath.c_str(), options);
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+        throw std::runtime_error(result.GetErrorMessage());
+    }
+
+    std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+    output.write(reinterpret_cast<const char*>(result.cbegin()),
+                 static_cast<std::streamsize>((result.cend() - result.cbegin()) * sizeof(uint32_t)));
+    output.close();
+    if (!output) {
+        throw std::runtime_error("failed to write " + tempPath);
+    }
+#else
+    // built without shaderc, so shell out to glslc like compile.sh does. slower, but still off the render thread
+    std::string command = "glslc -O \"" + sourcePath + "\" -o \"" + tempPath + "\"";
+    if (std::system(command.c_str()) != 0) {
+        throw std::runtime_error("glslc failed to compile " + sourcePath);
+    }
+#endif
+
+    std::filesystem::rename(tempPath, outputPath);
+}
+
+#endif //VULKAN_TUTORIAL_SHADER_HOT_RELOAD_H
@@ -1,2 +1,5 @@
 glslc shader.vert -o shader.vert.spv
-glslc shader.frag -o shader.frag.spv
\ No newline at end of file
+glslc shader.frag -o shader.frag.spv
+glslc particles.comp -o particles.comp.spv
+glslc textured.vert -o textured.vert.spv
+glslc textured.frag -o textured.frag.spv
\ No newline at end of file
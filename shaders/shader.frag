@@ -1,9 +1,23 @@
 #version 450
 
+// specialization constants, filled in per pipeline variant (see ShaderSpecialization in main.cpp)
+layout(constant_id = 0) const uint featureFlags = 0;
+layout(constant_id = 1) const float alpha = 1.0;
+
+const uint FEATURE_GRAYSCALE = 1;
+const uint FEATURE_INVERT = 2;
+
 layout(location = 0) in vec3 fragColor;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec3 color = fragColor;
+    if ((featureFlags & FEATURE_GRAYSCALE) != 0) {
+        color = vec3(dot(color, vec3(0.2126, 0.7152, 0.0722)));
+    }
+    if ((featureFlags & FEATURE_INVERT) != 0) {
+        color = vec3(1.0) - color;
+    }
+    outColor = vec4(color, alpha);
 }
\ No newline at end of file
@@ -1,11 +1,39 @@
 #version 450
 
-layout(location = 0) in vec2 inPosition;
+layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 
 layout(location = 0) out vec3 fragColor;
 
+// set by main.cpp for every pipeline: whether draws pass their data through push constants or this frame's draw data
+// buffer (see DrawDataBinding in draw_data.h)
+layout(constant_id = 2) const bool drawDataInBuffer = false;
+
+// must match DrawData in draw_data.h
+struct DrawData {
+    mat4 transform;
+    vec4 color;
+};
+
+layout(push_constant) uniform DrawPush {
+    DrawData data;
+} push;
+
+// indexed by the draw's firstInstance, which is where gl_InstanceIndex starts. a frame that ran out of slots pushes the
+// rest of its draws' data instead and points them past the end
+layout(std430, set = 1, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+} drawBuffer;
+
+// the depth prepass and the color pass after it compare depths for equality, so both have to compute exactly the same
+// position
+invariant gl_Position;
+
 void main() {
-    gl_Position = vec4(inPosition, 0.0, 1.0);
-    fragColor = inColor;
-}
\ No newline at end of file
+    bool inBuffer = drawDataInBuffer && gl_InstanceIndex < drawBuffer.draws.length();
+    DrawData draw = inBuffer ? drawBuffer.draws[gl_InstanceIndex] : push.data;
+    gl_Position = draw.transform * vec4(inPosition, 1.0);
+    // only matters for point list variants (and must be written for those)
+    gl_PointSize = 1.0;
+    fragColor = inColor * draw.color.rgb;
+}
@@ -0,0 +1,26 @@
+#version 450
+
+// same specialization constants as shader.frag, so textured pipelines can have variants too
+layout(constant_id = 0) const uint featureFlags = 0;
+layout(constant_id = 1) const float alpha = 1.0;
+
+const uint FEATURE_GRAYSCALE = 1;
+const uint FEATURE_INVERT = 2;
+
+// only has the mip levels that are currently streamed in, the sampler clamps to whatever is there
+layout(set = 0, binding = 0) uniform sampler2D textureSampler;
+
+layout(location = 0) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec3 color = texture(textureSampler, fragTexCoord).rgb;
+    if ((featureFlags & FEATURE_GRAYSCALE) != 0) {
+        color = vec3(dot(color, vec3(0.2126, 0.7152, 0.0722)));
+    }
+    if ((featureFlags & FEATURE_INVERT) != 0) {
+        color = vec3(1.0) - color;
+    }
+    outColor = vec4(color, alpha);
+}
@@ -0,0 +1,156 @@
+#ifndef VULKAN_TUTORIAL_SIMD_H
+#define VULKAN_TUTORIAL_SIMD_H
+
+#include <cmath>
+#include <cstdint>
+
+// a tiny wrapper over whatever vector instructions the compiler is allowed to use, just enough for the bulk math in
+// the scene code. the backend is picked at compile time: AVX2 works on 8 floats at a time, SSE2 and NEON on 4, and
+// there's a plain C++ fallback (also 4 wide) for everything else. code written against simd::Float runs unchanged on
+// every backend, it just has to step through its arrays by simd::WIDTH
+
+#if defined(__AVX2__)
+#define SIMD_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define SIMD_SCALAR 1
+#endif
+
+namespace simd {
+
+// the widest any backend gets, so arrays padded to this work for all of them
+constexpr int MAX_WIDTH = 8;
+
+#if defined(SIMD_AVX2)
+
+constexpr int WIDTH = 8;
+struct Float { __m256 v; };
+struct Mask { __m256 v; };
+
+inline const char* backendName() { return "AVX2"; }
+inline Float load(const float* p) { return {_mm256_loadu_ps(p)}; }
+inline void store(float* p, Float a) { _mm256_storeu_ps(p, a.v); }
+inline Float splat(float s) { return {_mm256_set1_ps(s)}; }
+inline Float operator+(Float a, Float b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline Float operator-(Float a, Float b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline Float operator*(Float a, Float b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline Float operator-(Float a) { return {_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f))}; }
+// a * b + c
+inline Float mulAdd(Float a, Float b, Float c) {
+#ifdef __FMA__
+    return {_mm256_fmadd_ps(a.v, b.v, c.v)};
+#else
+    return {_mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v)};
+#endif
+}
+inline Mask operator<(Float a, Float b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline Mask operator|(Mask a, Mask b) { return {_mm256_or_ps(a.v, b.v)}; }
+// one bit per lane, lane 0 in bit 0
+inline uint32_t bits(Mask m) { return static_cast<uint32_t>(_mm256_movemask_ps(m.v)); }
+
+#elif defined(SIMD_SSE2)
+
+constexpr int WIDTH = 4;
+struct Float { __m128 v; };
+struct Mask { __m128 v; };
+
+inline const char* backendName() { return "SSE2"; }
+inline Float load(const float* p) { return {_mm_loadu_ps(p)}; }
+inline void store(float* p, Float a) { _mm_storeu_ps(p, a.v); }
+inline Float splat(float s) { return {_mm_set1_ps(s)}; }
+inline Float operator+(Float a, Float b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Float operator-(Float a, Float b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Float operator*(Float a, Float b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Float operator-(Float a) { return {_mm_xor_ps(a.v, _mm_set1_ps(-0.0f))}; }
+inline Float mulAdd(Float a, Float b, Float c) { return {_mm_add_ps(_mm_mul_ps(a.v, b.v), c.v)}; }
+inline Mask operator<(Float a, Float b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline Mask operator|(Mask a, Mask b) { return {_mm_or_ps(a.v, b.v)}; }
+inline uint32_t bits(Mask m) { return static_cast<uint32_t>(_mm_movemask_ps(m.v)); }
+
+#elif defined(SIMD_NEON)
+
+constexpr int WIDTH = 4;
+struct Float { float32x4_t v; };
+struct Mask { uint32x4_t v; };
+
+inline const char* backendName() { return "NEON"; }
+inline Float load(const float* p) { return {vld1q_f32(p)}; }
+inline void store(float* p, Float a) { vst1q_f32(p, a.v); }
+inline Float splat(float s) { return {vdupq_n_f32(s)}; }
+inline Float operator+(Float a, Float b) { return {vaddq_f32(a.v, b.v)}; }
+inline Float operator-(Float a, Float b) { return {vsubq_f32(a.v, b.v)}; }
+inline Float operator*(Float a, Float b) { return {vmulq_f32(a.v, b.v)}; }
+inline Float operator-(Float a) { return {vnegq_f32(a.v)}; }
+inline Float mulAdd(Float a, Float b, Float c) { return {vmlaq_f32(c.v, a.v, b.v)}; }
+inline Mask operator<(Float a, Float b) { return {vcltq_f32(a.v, b.v)}; }
+inline Mask operator|(Mask a, Mask b) { return {vorrq_u32(a.v, b.v)}; }
+// NEON has no movemask, so every lane keeps just its own bit and the lanes get summed up
+inline uint32_t bits(Mask m) {
+    const uint32_t weights[4] = {1, 2, 4, 8};
+    uint32x4_t lanes = vandq_u32(m.v, vld1q_u32(weights));
+#if defined(__aarch64__)
+    return vaddvq_u32(lanes);
+#else
+    uint32x2_t pairs = vadd_u32(vget_low_u32(lanes), vget_high_u32(lanes));
+    return vget_lane_u32(vpadd_u32(pairs, pairs), 0);
+#endif
+}
+
+#else
+
+constexpr int WIDTH = 4;
+struct Float { float v[4]; };
+struct Mask { uint32_t v; };
+
+inline const char* backendName() { return "scalar"; }
+inline Float load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+inline void store(float* p, Float a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+inline Float splat(float s) { return {{s, s, s, s}}; }
+inline Float operator+(Float a, Float b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+inline Float operator-(Float a, Float b) { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+inline Float operator*(Float a, Float b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+inline Float operator-(Float a) { for (int i = 0; i < 4; i++) a.v[i] = -a.v[i]; return a; }
+inline Float mulAdd(Float a, Float b, Float c) { return a * b + c; }
+inline Mask operator<(Float a, Float b) {
+    uint32_t m = 0;
+    for (int i = 0; i < 4; i++) m |= uint32_t(a.v[i] < b.v[i]) << i;
+    return {m};
+}
+inline Mask operator|(Mask a, Mask b) { return {a.v | b.v}; }
+inline uint32_t bits(Mask m) { return m.v; }
+
+#endif
+
+// a * b + c on a single float, rounded the way the vector mulAdd above rounds it (fused only where that one is), so
+// scalar code can come up with exactly the same numbers as the vector code
+inline float mulAdd(float a, float b, float c) {
+#if defined(SIMD_AVX2) && defined(__FMA__)
+    return std::fma(a, b, c);
+#else
+    return a * b + c;
+#endif
+}
+
+// index of the lowest set bit, for walking the lanes a mask selected
+inline int lowestBit(uint32_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(bits);
+#else
+    int i = 0;
+    while ((bits & 1) == 0) {
+        bits >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+}
+
+#endif //VULKAN_TUTORIAL_SIMD_H
@@ -0,0 +1,535 @@
+#ifndef VULKAN_TUTORIAL_TEXTURE_STREAMING_H
+#define VULKAN_TUTORIAL_TEXTURE_STREAMING_H
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.h"
+#include "simd.h"
+
+// the CPU half of texture streaming: getting images into memory with a full mip chain, and deciding which mip levels
+// of which textures should be on the GPU. nothing in here touches Vulkan, and everything except TextureResidency is
+// safe to run on worker threads
+
+enum class TextureFormat : uint32_t {
+    // 8 bit sRGB color plus linear alpha
+    Rgba8 = 0,
+    // block compressed (see block_compression.h): 4x4 pixel blocks of 8 bytes, sRGB color only
+    Bc1 = 1,
+    // 4x4 pixel blocks of 16 bytes, sRGB color plus alpha
+    Bc7 = 2,
+};
+
+inline uint64_t textureLevelBytes(TextureFormat format, uint32_t width, uint32_t height) {
+    uint64_t blocks = uint64_t((width + 3) / 4) * ((height + 3) / 4);
+    switch (format) {
+        case TextureFormat::Rgba8:
+            return uint64_t(width) * height * 4;
+        case TextureFormat::Bc1:
+            return blocks * 8;
+        case TextureFormat::Bc7:
+            return blocks * 16;
+    }
+    throw std::runtime_error("unknown texture format");
+}
+
+inline const char* textureFormatName(TextureFormat format) {
+    switch (format) {
+        case TextureFormat::Rgba8:
+            return "RGBA8";
+        case TextureFormat::Bc1:
+            return "BC1";
+        case TextureFormat::Bc7:
+            return "BC7";
+    }
+    return "unknown";
+}
+
+inline uint32_t mipExtent(uint32_t size, uint32_t level) {
+    return std::max(1u, size >> level);
+}
+
+inline uint32_t fullMipCount(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    while ((std::max(width, height) >> levels) > 0) {
+        levels++;
+    }
+    return levels;
+}
+
+// the on-disk texture container (.vtex). a small header, a table of where each mip level is, then the levels
+// themselves, finest first. every level is a separate, 16 byte aligned block, so any one of them can be read (or mapped
+// and copied straight into a staging buffer) without touching the rest
+struct TextureFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+};
+
+struct TextureFileLevel {
+    uint64_t offset;
+    uint64_t size;
+};
+
+constexpr char TEXTURE_FILE_MAGIC[4] = {'V', 'T', 'E', 'X'};
+constexpr uint32_t TEXTURE_FILE_VERSION = 1;
+
+// a binary PPM (P6, 8 bit) turned into RGBA. it's the one image format simple enough not to need a library
+inline std::vector<uint8_t> decodePpm(ByteView file, uint32_t& width, uint32_t& height) {
+    size_t position = 0;
+    // the header is four whitespace separated tokens, with # comments allowed between them
+    auto nextToken = [&] {
+        while (position < file.size) {
+            char c = static_cast<char>(file.data[position]);
+            if (c == '#') {
+                while (position < file.size && file.data[position] != '\n') {
+                    position++;
+                }
+            } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                position++;
+            } else {
+                break;
+            }
+        }
+        std::string token;
+        while (position < file.size && !std::isspace(file.data[position])) {
+            token += static_cast<char>(file.data[position++]);
+        }
+        return token;
+    };
+
+    if (nextToken() != "P6") {
+        throw std::runtime_error("only binary PPMs (P6) are supported");
+    }
+    width = static_cast<uint32_t>(std::stoul(nextToken()));
+    height = static_cast<uint32_t>(std::stoul(nextToken()));
+    if (std::stoul(nextToken()) != 255) {
+        throw std::runtime_error("only 8 bit PPMs are supported");
+    }
+    // exactly one whitespace byte separates the header from the pixels
+    position++;
+    // divided rather than multiplied, so a corrupt header's dimensions can't wrap the size past the check
+    size_t pixelCount = size_t(width) * height;
+    if (width == 0 || height == 0 || position > file.size || pixelCount / height != width
+        || pixelCount > (file.size - position) / 3) {
+        throw std::runtime_error("truncated PPM");
+    }
+
+    std::vector<uint8_t> rgba(pixelCount * 4);
+    const uint8_t* src = file.data + position;
+    for (size_t i = 0; i < pixelCount; i++) {
+        rgba[i * 4 + 0] = src[i * 3 + 0];
+        rgba[i * 4 + 1] = src[i * 3 + 1];
+        rgba[i * 4 + 2] = src[i * 3 + 2];
+        rgba[i * 4 + 3] = 255;
+    }
+    return rgba;
+}
+
+// halves an RGBA8 image with a 2x2 box filter. color is averaged in linear space (averaging sRGB values directly makes
+// every mip level darker than the one before), alpha is already linear. odd sizes round down like Vulkan's mip chain.
+// the conversions are table lookups, one pixel at a time (simd.h has no gathers); the filter in between runs
+// simd::WIDTH pixels of a channel at a time
+inline std::vector<uint8_t> downsampleRgba8(const uint8_t* src, uint32_t width, uint32_t height) {
+    static const auto toLinear = [] {
+        std::array<float, 256> table{};
+        for (int i = 0; i < 256; i++) {
+            float c = i / 255.0f;
+            table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return table;
+    }();
+    // linear back to sRGB through a table fine enough that it never rounds differently from the exact formula
+    static const auto toSrgb = [] {
+        std::array<uint8_t, 4096> table{};
+        for (int i = 0; i < 4096; i++) {
+            float c = (i + 0.5f) / 4096.0f;
+            float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+            table[i] = static_cast<uint8_t>(std::lround(std::clamp(s, 0.0f, 1.0f) * 255.0f));
+        }
+        return table;
+    }();
+
+    uint32_t outWidth = mipExtent(width, 1);
+    uint32_t outHeight = mipExtent(height, 1);
+    // a 1 pixel wide (or tall) image just averages with itself in that direction
+    size_t stepX = width > 1 ? 4 : 0;
+    size_t stepY = height > 1 ? size_t(width) * 4 : 0;
+    const size_t corners[4] = {0, stepX, stepY, stepX + stepY};
+    // an output row's source pixels, one array per corner of the 2x2 and channel, padded to whole simd::Floats. then
+    // the filter is four loads and three adds for every simd::WIDTH pixels
+    size_t paddedWidth = (size_t(outWidth) + simd::WIDTH - 1) / simd::WIDTH * simd::WIDTH;
+    std::vector<float> samples(16 * paddedWidth);
+    std::vector<float> filtered(paddedWidth);
+    auto plane = [&](size_t corner, size_t c) { return samples.data() + (corner * 4 + c) * paddedWidth; };
+
+    std::vector<uint8_t> out(size_t(outWidth) * outHeight * 4);
+    for (uint32_t y = 0; y < outHeight; y++) {
+        const uint8_t* row = src + size_t(y) * 2 * width * 4;
+        uint8_t* dst = out.data() + size_t(y) * outWidth * 4;
+        for (uint32_t x = 0; x < outWidth; x++) {
+            const uint8_t* p = row + size_t(x) * 2 * 4;
+            for (size_t corner = 0; corner < 4; corner++) {
+                const uint8_t* q = p + corners[corner];
+                plane(corner, 0)[x] = toLinear[q[0]];
+                plane(corner, 1)[x] = toLinear[q[1]];
+                plane(corner, 2)[x] = toLinear[q[2]];
+                plane(corner, 3)[x] = q[3];
+            }
+        }
+        for (size_t c = 0; c < 4; c++) {
+            // color becomes an index into toSrgb, alpha the rounded average
+            simd::Float scale = simd::splat(c < 3 ? 4096.0f / 4.0f : 0.25f);
+            simd::Float bias = simd::splat(c < 3 ? 0.0f : 0.5f);
+            for (size_t x = 0; x < paddedWidth; x += simd::WIDTH) {
+                simd::Float sum = simd::load(plane(0, c) + x) + simd::load(plane(1, c) + x);
+                sum = sum + simd::load(plane(2, c) + x);
+                sum = sum + simd::load(plane(3, c) + x);
+                simd::store(filtered.data() + x, simd::mulAdd(sum, scale, bias));
+            }
+            for (uint32_t x = 0; x < outWidth; x++) {
+                int value = static_cast<int>(filtered[x]);
+                dst[x * 4 + c] = c < 3 ? toSrgb[std::min(4095, value)] : static_cast<uint8_t>(value);
+            }
+        }
+    }
+    return out;
+}
+
+// one texture's full mip chain, either mapped straight out of a .vtex file or decoded into memory
+class TextureSource {
+public:
+    // .vtex files are mapped and used as they are, anything else is decoded and gets its mips generated here
+    static TextureSource fromFile(const std::string& path) {
+        MappedFile file(path);
+        if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".vtex") == 0) {
+            return fromContainer(std::move(file), path);
+        }
+        uint32_t width, height;
+        std::vector<uint8_t> pixels = decodePpm(file.view(), width, height);
+        return fromPixels(width, height, std::move(pixels));
+    }
+
+    static TextureSource fromPixels(uint32_t width, uint32_t height, std::vector<uint8_t> rgba) {
+        TextureSource source;
+        source.textureFormat = TextureFormat::Rgba8;
+        source.baseWidth = width;
+        source.baseHeight = height;
+        uint32_t levelCount = fullMipCount(width, height);
+
+        uint64_t total = 0;
+        for (uint32_t level = 0; level < levelCount; level++) {
+            uint64_t size = textureLevelBytes(TextureFormat::Rgba8, mipExtent(width, level), mipExtent(height, level));
+            source.levels.push_back({total, size});
+            total += size;
+        }
+        source.storage.resize(total);
+        memcpy(source.storage.data(), rgba.data(), source.levels[0].size);
+        rgba = {};
+        for (uint32_t level = 1; level < levelCount; level++) {
+            std::vector<uint8_t> smaller = downsampleRgba8(source.storage.data() + source.levels[level - 1].offset,
+                                                           mipExtent(width, level - 1), mipExtent(height, level - 1));
+            memcpy(source.storage.data() + source.levels[level].offset, smaller.data(), smaller.size());
+        }
+        return source;
+    }
+
+    // a mip chain that's already been built (by an encoder, say), finest level first
+    static TextureSource fromLevels(TextureFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& levelData) {
+        TextureSource source;
+        source.textureFormat = format;
+        source.baseWidth = width;
+        source.baseHeight = height;
+        uint64_t total = 0;
+        for (uint32_t level = 0; level < levelData.size(); level++) {
+            if (levelData[level].size() != textureLevelBytes(format, mipExtent(width, level), mipExtent(height, level))) {
+                throw std::runtime_error("mip level has the wrong size for its format");
+            }
+            source.levels.push_back({total, levelData[level].size()});
+            total += levelData[level].size();
+        }
+        source.storage.resize(total);
+        for (uint32_t level = 0; level < levelData.size(); level++) {
+            memcpy(source.storage.data() + source.levels[level].offset, levelData[level].data(), levelData[level].size());
+        }
+        return source;
+    }
+
+    TextureFormat format() const {
+        return textureFormat;
+    }
+
+    uint32_t width(uint32_t level = 0) const {
+        return mipExtent(baseWidth, level);
+    }
+
+    uint32_t height(uint32_t level = 0) const {
+        return mipExtent(baseHeight, level);
+    }
+
+    uint32_t levelCount() const {
+        return static_cast<uint32_t>(levels.size());
+    }
+
+    ByteView level(uint32_t index) const {
+        const uint8_t* base = file ? file->view().data : storage.data();
+        return {base + levels[index].offset, static_cast<size_t>(levels[index].size)};
+    }
+
+private:
+    static TextureSource fromContainer(MappedFile file, const std::string& path) {
+        ByteView bytes = file.view();
+        TextureFileHeader header{};
+        if (bytes.size < sizeof(header)) {
+            throw std::runtime_error("truncated texture file " + path);
+        }
+        memcpy(&header, bytes.data, sizeof(header));
+        if (memcmp(header.magic, TEXTURE_FILE_MAGIC, 4) != 0 || header.version != TEXTURE_FILE_VERSION) {
+            throw std::runtime_error("not a texture file (or an unsupported version): " + path);
+        }
+        if (header.levelCount == 0 || header.levelCount > fullMipCount(header.width, header.height)) {
+            throw std::runtime_error("bad mip count in " + path);
+        }
+
+        TextureSource source;
+        source.textureFormat = static_cast<TextureFormat>(header.format);
+        source.baseWidth = header.width;
+        source.baseHeight = header.height;
+        source.levels.resize(header.levelCount);
+        size_t tableEnd = sizeof(header) + sizeof(TextureFileLevel) * header.levelCount;
+        if (bytes.size < tableEnd) {
+            throw std::runtime_error("truncated texture file " + path);
+        }
+        for (uint32_t level = 0; level < header.levelCount; level++) {
+            TextureFileLevel entry{};
+            memcpy(&entry, bytes.data + sizeof(header) + sizeof(TextureFileLevel) * level, sizeof(entry));
+            uint64_t expected = textureLevelBytes(source.textureFormat, source.width(level), source.height(level));
+            if (entry.size != expected || entry.offset < tableEnd || entry.offset > bytes.size || bytes.size - entry.offset < entry.size) {
+                throw std::runtime_error("bad mip level table in " + path);
+            }
+            source.levels[level] = {entry.offset, entry.size};
+        }
+        source.file = std::move(file);
+        return source;
+    }
+
+    struct Level {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    TextureFormat textureFormat = TextureFormat::Rgba8;
+    uint32_t baseWidth = 0;
+    uint32_t baseHeight = 0;
+    std::vector<Level> levels;
+    std::optional<MappedFile> file;
+    std::vector<uint8_t> storage;
+};
+
+// saves a whole mip chain as a .vtex file, which TextureSource::fromFile() maps back in as it is
+inline void writeTextureFile(const std::string& path, const TextureSource& source) {
+    TextureFileHeader header{};
+    memcpy(header.magic, TEXTURE_FILE_MAGIC, 4);
+    header.version = TEXTURE_FILE_VERSION;
+    header.format = static_cast<uint32_t>(source.format());
+    header.width = source.width();
+    header.height = source.height();
+    header.levelCount = source.levelCount();
+
+    std::vector<TextureFileLevel> table(header.levelCount);
+    uint64_t offset = sizeof(header) + sizeof(TextureFileLevel) * table.size();
+    for (uint32_t level = 0; level < header.levelCount; level++) {
+        offset = (offset + 15) & ~uint64_t(15);
+        table[level] = {offset, source.level(level).size};
+        offset += table[level].size;
+    }
+
+    std::vector<uint8_t> bytes(offset, 0);
+    memcpy(bytes.data(), &header, sizeof(header));
+    memcpy(bytes.data() + sizeof(header), table.data(), sizeof(TextureFileLevel) * table.size());
+    for (uint32_t level = 0; level < header.levelCount; level++) {
+        ByteView data = source.level(level);
+        memcpy(bytes.data() + table[level].offset, data.data, data.size);
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("failed to open " + path + " for writing");
+    }
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        throw std::runtime_error("failed to write " + path);
+    }
+}
+
+// decides which mip levels of which textures live on the GPU, under a fixed memory budget. every texture has a
+// resident range [residentLevel, levelCount): the tail (the small levels) always stays, finer levels get added
+// one at a time for textures that are on screen and want them, and when the budget runs out the finest levels of the
+// least recently used textures get dropped first. the caller tells it what each frame wants with request() and then
+// carries out whatever plan() hands back. render thread only
+class TextureResidency {
+public:
+    // a texture going from resident range [fromLevel, ...) to [toLevel, ...). fromLevel == level count means nothing
+    // was resident before
+    struct Change {
+        uint32_t texture;
+        uint32_t fromLevel;
+        uint32_t toLevel;
+    };
+
+    explicit TextureResidency(uint64_t budgetBytes = 0) : budgetBytes(budgetBytes) {}
+
+    // levelBytes is the size of every mip level, finest first. every level from tailLevel on is loaded as one piece
+    uint32_t add(std::vector<uint64_t> levelBytes, uint32_t tailLevel) {
+        Entry entry;
+        entry.tailLevel = std::min(tailLevel, static_cast<uint32_t>(levelBytes.size()) - 1);
+        entry.resident = static_cast<uint32_t>(levelBytes.size());
+        entry.wanted = entry.tailLevel;
+        entry.levelBytes = std::move(levelBytes);
+        entries.push_back(std::move(entry));
+        return static_cast<uint32_t>(entries.size() - 1);
+    }
+
+    // the texture is used this frame and would like levels down to finestLevel
+    void request(uint32_t texture, uint32_t finestLevel, uint64_t frame) {
+        Entry& entry = entries[texture];
+        entry.wanted = std::min(finestLevel, entry.tailLevel);
+        entry.lastUsed = frame;
+    }
+
+    // works out this frame's changes. new levels go in coarsest first across all textures, so everything on screen
+    // gets a usable picture before anything gets sharp. uploadBudget caps how many bytes of new levels one frame may
+    // ask for (one step always goes through, however big, so huge levels still make progress). the changes get appended
+    // to whatever vector the caller passes in (a frame arena's, usually), the scratch space is kept between calls
+    template<typename Allocator>
+    void plan(uint64_t frame, uint64_t uploadBudget, std::vector<Change, Allocator>& changes) {
+        before.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); i++) {
+            before[i] = entries[i].resident;
+        }
+
+        // a min heap, cheapest step on top
+        steps.clear();
+        for (uint32_t i = 0; i < entries.size(); i++) {
+            if (entries[i].resident > target(entries[i], frame)) {
+                steps.push_back({stepBytes(entries[i]), i});
+            }
+        }
+        std::make_heap(steps.begin(), steps.end(), std::greater<Step>());
+
+        uint64_t uploaded = 0;
+        while (!steps.empty()) {
+            std::pop_heap(steps.begin(), steps.end(), std::greater<Step>());
+            auto [cost, index] = steps.back();
+            steps.pop_back();
+            if (uploaded > 0 && uploaded + cost > uploadBudget) {
+                break;
+            }
+            if (!makeRoom(cost, index, frame)) {
+                // everything left costs at least as much, so none of it would fit either
+                break;
+            }
+            Entry& entry = entries[index];
+            entry.resident = entry.resident == entry.levelBytes.size() ? entry.tailLevel : entry.resident - 1;
+            residentTotal += cost;
+            uploaded += cost;
+            if (entry.resident > target(entry, frame)) {
+                steps.push_back({stepBytes(entry), index});
+                std::push_heap(steps.begin(), steps.end(), std::greater<Step>());
+            }
+        }
+
+        for (uint32_t i = 0; i < entries.size(); i++) {
+            if (entries[i].resident != before[i]) {
+                changes.push_back({i, before[i], entries[i].resident});
+            }
+        }
+    }
+
+    uint32_t residentLevel(uint32_t texture) const {
+        return entries[texture].resident;
+    }
+
+    uint64_t residentBytes() const {
+        return residentTotal;
+    }
+
+    uint64_t budget() const {
+        return budgetBytes;
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+private:
+    struct Entry {
+        std::vector<uint64_t> levelBytes;
+        uint32_t tailLevel = 0;
+        uint32_t resident = 0;
+        uint32_t wanted = 0;
+        uint64_t lastUsed = 0;
+    };
+
+    // what a texture should have: what it asked for this frame, or just its tail if it's not on screen
+    static uint32_t target(const Entry& entry, uint64_t frame) {
+        return entry.lastUsed == frame ? entry.wanted : entry.tailLevel;
+    }
+
+    // the bytes the texture's next step down the chain adds (the whole tail for the first one)
+    static uint64_t stepBytes(const Entry& entry) {
+        if (entry.resident == entry.levelBytes.size()) {
+            uint64_t bytes = 0;
+            for (size_t level = entry.tailLevel; level < entry.levelBytes.size(); level++) {
+                bytes += entry.levelBytes[level];
+            }
+            return bytes;
+        }
+        return entry.levelBytes[entry.resident - 1];
+    }
+
+    // drops levels nobody needs right now, least recently used textures first, until cost more bytes fit
+    bool makeRoom(uint64_t cost, uint32_t skip, uint64_t frame) {
+        while (residentTotal + cost > budgetBytes) {
+            Entry* victim = nullptr;
+            for (uint32_t i = 0; i < entries.size(); i++) {
+                Entry& entry = entries[i];
+                if (i != skip && entry.resident < target(entry, frame) && (victim == nullptr || entry.lastUsed < victim->lastUsed)) {
+                    victim = &entry;
+                }
+            }
+            if (victim == nullptr) {
+                return false;
+            }
+            residentTotal -= victim->levelBytes[victim->resident];
+            victim->resident++;
+        }
+        return true;
+    }
+
+    std::vector<Entry> entries;
+    uint64_t budgetBytes;
+    uint64_t residentTotal = 0;
+
+    // plan()'s scratch space: every texture's resident level going in, and the heap of (bytes, texture) steps
+    using Step = std::pair<uint64_t, uint32_t>;
+    std::vector<uint32_t> before;
+    std::vector<Step> steps;
+};
+
+#endif //VULKAN_TUTORIAL_TEXTURE_STREAMING_H
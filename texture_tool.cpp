@@ -0,0 +1,112 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "block_compression.h"
+
+// converts an image (a .ppm, or a .vtex that's still RGBA8) into a .vtex mip chain the texture streaming path maps
+// straight in, block compressed on every core.
+// usage: texture_tool <input> <output.vtex> [--format rgba8|bc1|bc7] [--quality fast|normal|high] [--threads n]
+
+using Clock = std::chrono::steady_clock;
+
+static void usage() {
+    printf("usage: texture_tool <input> <output.vtex> [--format rgba8|bc1|bc7] [--quality fast|normal|high] [--threads n]\n");
+}
+
+// peak signal to noise ratio over the color channels (and alpha, when the format keeps it), in dB
+static double psnr(const uint8_t* a, const uint8_t* b, size_t pixelCount, int channelCount) {
+    double squaredError = 0.0;
+    for (size_t i = 0; i < pixelCount; i++) {
+        for (int c = 0; c < channelCount; c++) {
+            double d = double(a[i * 4 + c]) - double(b[i * 4 + c]);
+            squaredError += d * d;
+        }
+    }
+    if (squaredError == 0.0) {
+        return INFINITY;
+    }
+    double meanError = squaredError / double(pixelCount * channelCount);
+    return 10.0 * std::log10(255.0 * 255.0 / meanError);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    std::string inputPath = argv[1];
+    std::string outputPath = argv[2];
+    TextureFormat format = TextureFormat::Bc7;
+    BcQuality quality = BcQuality::Normal;
+    size_t threadCount = ThreadPool::defaultThreadCount() + 1;
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value = i + 1 < argc ? argv[i + 1] : "";
+        if (arg == "--format" && (value == "rgba8" || value == "bc1" || value == "bc7")) {
+            format = value == "rgba8" ? TextureFormat::Rgba8 : value == "bc1" ? TextureFormat::Bc1 : TextureFormat::Bc7;
+        } else if (arg == "--quality" && (value == "fast" || value == "normal" || value == "high")) {
+            quality = value == "fast" ? BcQuality::Fast : value == "normal" ? BcQuality::Normal : BcQuality::High;
+        } else if (arg == "--threads" && !value.empty()) {
+            threadCount = std::max<size_t>(1, std::stoul(value));
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+        i++;
+    }
+
+    try {
+        auto start = Clock::now();
+        TextureSource source = TextureSource::fromFile(inputPath);
+        double loadMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (source.format() != TextureFormat::Rgba8) {
+            printf("%s is already %s\n", inputPath.c_str(), textureFormatName(source.format()));
+            return EXIT_FAILURE;
+        }
+        uint64_t inputBytes = 0;
+        for (uint32_t level = 0; level < source.levelCount(); level++) {
+            inputBytes += source.level(level).size;
+        }
+        printf("%s: %ux%u, %u mips, %.1f MiB as RGBA8 (decoded and mipped in %.1f ms)\n", inputPath.c_str(), source.width(),
+               source.height(), source.levelCount(), double(inputBytes) / (1024.0 * 1024.0), loadMs);
+
+        if (format == TextureFormat::Rgba8) {
+            writeTextureFile(outputPath, source);
+        } else {
+            // the calling thread encodes too, so the pool only needs the rest
+            std::unique_ptr<ThreadPool> pool;
+            if (threadCount > 1) {
+                pool = std::make_unique<ThreadPool>(threadCount - 1);
+            }
+            start = Clock::now();
+            TextureSource output = compressTexture(source, format, quality, pool.get());
+            double encodeSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            uint64_t texels = 0;
+            uint64_t outputBytes = 0;
+            for (uint32_t level = 0; level < source.levelCount(); level++) {
+                texels += uint64_t(source.width(level)) * source.height(level);
+                outputBytes += output.level(level).size;
+            }
+            printf("%s on %zu threads (SIMD backend: %s): %.1f ms, %.1f Mtexels/s, %.1f MiB (%.1f:1)\n",
+                   textureFormatName(format), threadCount, simd::backendName(), encodeSeconds * 1000.0,
+                   double(texels) / encodeSeconds / 1e6, double(outputBytes) / (1024.0 * 1024.0),
+                   double(inputBytes) / double(outputBytes));
+
+            // BC1 as the renderer uses it has no alpha, so only color counts against it
+            std::vector<uint8_t> decoded = decompressLevel(output.level(0).data, output.width(), output.height(), format);
+            printf("level 0 PSNR: %.2f dB\n", psnr(source.level(0).data, decoded.data(), size_t(source.width()) * source.height(),
+                                                   format == TextureFormat::Bc1 ? 3 : 4));
+            writeTextureFile(outputPath, output);
+        }
+        printf("wrote %s\n", outputPath.c_str());
+    } catch (const std::exception& e) {
+        printf("%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+#ifndef VULKAN_TUTORIAL_THREAD_POOL_H
+#define VULKAN_TUTORIAL_THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// a small fixed-size pool of worker threads. anything slow that doesn't need to happen on the render thread (pipeline
+// compiles, file loading, etc.) gets pushed in here so the main loop never has to wait on it
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threadCount = defaultThreadCount()) {
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // queues up a job and hands back a future for its result (exceptions thrown by the job end up in the future too)
+    template<typename F>
+    auto submit(F&& job) -> std::future<std::invoke_result_t<F>> {
+        using Result = std::invoke_result_t<F>;
+        // packaged_task isn't copyable, but std::function needs copyable things, so we hold it through a shared_ptr
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.emplace([task] { (*task)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    // leave one core for the render thread
+    static size_t defaultThreadCount() {
+        size_t cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 1;
+    }
+
+private:
+    void workerLoop() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this] { return stopping || !jobs.empty(); });
+                // we still drain whatever is left in the queue before exiting so no future is left hanging
+                if (stopping && jobs.empty()) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+            job();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+};
+
+#endif //VULKAN_TUTORIAL_THREAD_POOL_H